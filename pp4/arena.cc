@@ -0,0 +1,92 @@
+/* File: arena.cc
+ * --------------
+ * Implementation of the Arena bump-pointer allocator.
+ */
+
+#include "arena.h"
+#include "utility.h"
+#include <stdlib.h>
+#include <string.h>
+
+static constexpr size_t RoundUp(size_t n, size_t align) {
+    return (n + align - 1) & ~(align - 1);
+}
+
+// block header is padded so the data following it stays aligned
+char *Arena::Block::Data() {
+    return reinterpret_cast<char*>(this) + RoundUp(sizeof(Block), Alignment);
+}
+
+thread_local Arena *Arena::current = NULL;
+
+Arena::Arena(size_t size)
+    : blocks(NULL), blockSize(size), bytesUsed(0), cleanups(NULL) {}
+
+/* Method: NewBlock
+ * ----------------
+ * Grabs a new block from the heap big enough to hold minSize bytes and
+ * pushes it on the front of the block list. Requests larger than the
+ * normal block size get a block of their own.
+ */
+Arena::Block *Arena::NewBlock(size_t minSize) {
+    size_t size = minSize > blockSize ? minSize : blockSize;
+    Block *b = (Block *)malloc(RoundUp(sizeof(Block), Alignment) + size);
+    if (b == NULL)
+        Failure("Arena out of memory (requested %lu bytes)", (unsigned long)size);
+    b->next = blocks;
+    b->size = size;
+    b->used = 0;
+    blocks = b;
+    return b;
+}
+
+void *Arena::Allocate(size_t bytes) {
+    bytes = RoundUp(bytes ? bytes : 1, Alignment);
+    Block *b = blocks;
+    if (b == NULL || b->size - b->used < bytes)
+        b = NewBlock(bytes);
+    void *result = b->Data() + b->used;
+    b->used += bytes;
+    bytesUsed += bytes;
+    return result;
+}
+
+char *Arena::Strdup(const char *str) {
+    size_t len = strlen(str) + 1;
+    char *copy = (char *)Allocate(len);
+    memcpy(copy, str, len);
+    return copy;
+}
+
+bool Arena::Owns(const void *p) const {
+    const char *c = (const char *)p;
+    for (Block *b = blocks; b != NULL; b = b->next)
+        if (c >= b->Data() && c < b->Data() + b->used)
+            return true;
+    return false;
+}
+
+void Arena::Free() {
+    for (; cleanups != NULL; cleanups = cleanups->next)
+        cleanups->destroy(cleanups->object);
+    while (blocks != NULL) {
+        Block *next = blocks->next;
+        free(blocks);
+        blocks = next;
+    }
+    bytesUsed = 0;
+}
+
+size_t Arena::BytesReserved() const {
+    size_t total = 0;
+    for (Block *b = blocks; b != NULL; b = b->next)
+        total += b->size;
+    return total;
+}
+
+int Arena::NumBlocks() const {
+    int n = 0;
+    for (Block *b = blocks; b != NULL; b = b->next)
+        n++;
+    return n;
+}
@@ -0,0 +1,97 @@
+/* File: asmwriter.cc
+ * ------------------
+ * Implementation of the AsmWriter class.
+ */
+
+#include "asmwriter.h"
+#include "utility.h"
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+
+static const size_t MinCapacity = 4096;  // doubled as needed
+
+AsmWriter::AsmWriter(FILE *o)
+    : buf(NULL), length(0), capacity(0), out(o), bytesFlushed(0) {}
+
+AsmWriter::~AsmWriter() {
+    free(buf);
+}
+
+char *AsmWriter::Reserve(size_t len) {
+    if (capacity - length < len) {
+        size_t wanted = capacity < MinCapacity ? MinCapacity : 2 * capacity;
+        if (wanted < length + len)
+            wanted = length + len;
+        char *grown = (char *)realloc(buf, wanted);
+        if (grown == NULL)
+            Failure("Out of memory for generated code");
+        buf = grown;
+        capacity = wanted;
+    }
+    return buf + length;
+}
+
+void AsmWriter::ShrinkToFit() {
+    if (length == 0 || length == capacity)
+        return;
+    char *shrunk = (char *)realloc(buf, length);
+    if (shrunk != NULL) {
+        buf = shrunk;
+        capacity = length;
+    }
+}
+
+void AsmWriter::Write(const char *bytes, size_t len) {
+    if (len == 0)
+        return;
+    memcpy(Reserve(len), bytes, len);
+    length += len;
+}
+
+void AsmWriter::Flush() {
+    if (out != NULL && length > 0)
+        WriteAll(vector<AsmWriter*>(1, this), out);
+    bytesFlushed += length;
+    length = 0;
+}
+
+/* Method: WriteAll
+ * ----------------
+ * Anything out has buffered goes first, then the writers' buffers are
+ * passed to writev as they are, IOV_MAX at a time, picking up where a
+ * short write left off. A failed write stops the output, as it would
+ * with fwrite.
+ */
+size_t AsmWriter::WriteAll(const vector<AsmWriter*> &writers, FILE *out) {
+    size_t written = 0;
+    int fd = fileno(out);
+    if (fd < 0 || fflush(out) != 0) {
+        for (size_t i = 0; i < writers.size(); i++)
+            written += fwrite(writers[i]->buf, 1, writers[i]->length, out);
+        return written;
+    }
+
+    vector<struct iovec> iov;
+    for (size_t i = 0; i < writers.size(); i++)
+        if (writers[i]->length > 0)
+            iov.push_back((struct iovec){writers[i]->buf, writers[i]->length});
+    for (size_t i = 0; i < iov.size(); ) {
+        int count = (iov.size() - i < IOV_MAX ? iov.size() - i : IOV_MAX);
+        ssize_t n = writev(fd, &iov[i], count);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        written += n;
+        for (; i < iov.size() && (size_t)n >= iov[i].iov_len; i++)
+            n -= iov[i].iov_len;
+        if (n > 0) {
+            iov[i].iov_base = (char *)iov[i].iov_base + n;
+            iov[i].iov_len -= n;
+        }
+    }
+    return written;
+}
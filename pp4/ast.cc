@@ -5,26 +5,54 @@
 #include "ast.h"
 #include "ast_type.h"
 #include "ast_decl.h"
+#include "compilation.h"
+#include "astfile.h"
 #include <string.h> // strdup
 #include <stdio.h>  // printf
 
-Node::Node(yyltype loc) {
-    location = new yyltype(loc);
+void *Node::operator new(size_t size) {
+    Compilation *c = Compilation::Current();
+    if (c == NULL)
+        return ::operator new(size);
+    c->stats.nodes++;
+    return c->NodeArena().Allocate(size);
+}
+
+// nodes in the arena are released all together by Arena::Free
+void Node::operator delete(void *p) {
+    Compilation *c = Compilation::Current();
+    if (p && !(c && c->Owns(p)))
+        ::operator delete(p);
+}
+
+Node::Node(NodeKind k, SourceRange loc) : location(loc), kind(k) {
     parent = nullptr;
     scope = nullptr;
-
 }
 
-Node::Node() {
-    location = nullptr;
+Node::Node(NodeKind k) : kind(k) {
     parent = nullptr;
     scope = nullptr;
 }
 
-Identifier::Identifier(yyltype loc, const char *n) : Node(loc) {
-    name = strdup(n);
+Identifier::Identifier(SourceRange loc, const char *n) : Node(IdentifierNode, loc) {
+    Assert(n != NULL);
+    name = n;
+    decl = NULL;
 }
 
-bool Identifier::operator==(const Identifier &rhs) {
-    return strcmp(name, rhs.name) == 0 ? true : false;
-}
\ No newline at end of file
+/* Writing the tree to an AST file
+ * -------------------------------
+ * Each node adds its children and then itself (see astfile.h), passing
+ * its location only if its constructor takes one, so that the loader can
+ * make it with the same constructor.
+ */
+int Identifier::Write(AstWriter *out) {
+    return out->AddNode(IdentifierNode, &location, NULL, 0, out->Symbol(name));
+}
+
+// The parser discards an Error before the tree is complete
+int Error::Write(AstWriter *out) {
+    Failure("Error nodes are not written to AST files");
+    return -1;
+}
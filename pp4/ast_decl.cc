@@ -5,12 +5,19 @@
 #include "include/ast_decl.h"
 #include "include/ast_type.h"
 #include "include/ast_stmt.h"
+#include "include/symbols.h"
+#include "include/compilation.h"
+#include "include/source.h"
+#include "include/astfile.h"
+#include <unordered_map>
         
          
-Decl::Decl(Identifier *n) : Node(*n->GetLocation()) {
+Decl::Decl(NodeKind k, Identifier *n) : Node(k, n->GetLocation()) {
     Assert(n != NULL);
     (id=n)->SetParent(this);
     scope = new Scope;
+    if (Compilation *c = Compilation::Current())
+        c->stats.decls++;
 }
 
 bool Decl::IsEquivalentTo(Decl *other) {
@@ -21,18 +28,23 @@ void Decl::BuildScope() {
 
 }
 
-VarDecl::VarDecl(Identifier *n, Type *t) : Decl(n) {
+VarDecl::VarDecl(Identifier *n, Type *t)
+    : Decl(VarDeclNode, n), memLoc(NULL), memOffset(0) {
     Assert(n != NULL && t != NULL);
     (type=t)->SetParent(this);
 }
 
 bool VarDecl::IsEquivalentTo(Decl *other) {
-    VarDecl *varDecl = dynamic_cast<VarDecl*>(other);
+    VarDecl *varDecl = dyn_cast<VarDecl>(other);
     if(varDecl==NULL)
         return false;
     return type->IsEquivalentTo(varDecl->type);
 }
 
+void VarDecl::Resolve(Resolver *r) {
+    type->Resolve(r);
+}
+
 void VarDecl::Check() {
     CheckType();
 }
@@ -40,21 +52,10 @@ void VarDecl::Check() {
 void VarDecl::CheckType() {
     if(type->IsPrimitive()) return;
 
-    Scope *s = scope;
-    Node* temp = this;
-    while((temp)!=NULL) {
-        s = temp->GetScope();
-        Decl *d;
-        if((d=s->table->Lookup(type->Name()))!=NULL) {
-            if(dynamic_cast<ClassDecl*>(d)==NULL&&
-                    dynamic_cast<InterfaceDecl*>(d)==NULL)
-                type->ReportNotDeclaredIdentifier(LookingForType);
-
-            return;
-        }
-        temp = temp->GetParent();
-    }
-    type->ReportNotDeclaredIdentifier(LookingForType);
+    Decl *d = type->GetDecl();
+    if(!isa<ClassDecl>(d)&&
+            !isa<InterfaceDecl>(d))
+        type->ReportNotDeclaredIdentifier(LookingForType);
 }
 
 
@@ -65,13 +66,15 @@ int VarDecl::GetMemBytes() {
 
 
 
-ClassDecl::ClassDecl(Identifier *n, NamedType *ex, List<NamedType*> *imp, List<Decl*> *m) : Decl(n) {
+ClassDecl::ClassDecl(Identifier *n, NamedType *ex, List<NamedType*> *imp, List<Decl*> *m) : Decl(ClassDeclNode, n) {
     // extends can be NULL, impl & mem may be empty lists but cannot be NULL
     Assert(n != NULL && imp != NULL && m != NULL);     
     extends = ex;
     if (extends) extends->SetParent(this);
     (implements=imp)->SetParentAll(this);
     (members=m)->SetParentAll(this);
+    layout = NULL;
+    type = Compilation::Current()->types->Named(id);
 }
 
 
@@ -82,51 +85,52 @@ void ClassDecl::BuildScope() {
     scope->AddDecl(this);
 
 
-    for (int i = 0, n = members->NumElements(); i < n; ++i)
-        scope->AddDecl(members->Nth(i));
+    for (Decl *d : *members)
+        scope->AddDecl(d);
 
-    for (int i = 0, n = members->NumElements(); i < n; ++i)
-        members->Nth(i)->BuildScope();
+    for (Decl *d : *members)
+        d->BuildScope();
+}
+
+void ClassDecl::Resolve(Resolver *r) {
+    ClassDecl *outer = r->classDecl;
+    r->classDecl = this;
+    r->PushScope(scope);
+    for (Decl *d : *members)
+        d->Resolve(r);
+    r->PopScope();
+    r->classDecl = outer;
 }
 
 void ClassDecl::CheckExtends() {
     if (extends == NULL)
         return;
-    Node* tempNode = this->GetParent();
-    Scope* s = tempNode->GetScope();
-    Decl *lookup = s->table->Lookup(extends->Name());
-    if (dynamic_cast<ClassDecl*>(lookup) == NULL)
+    if (!isa<ClassDecl>(extends->GetTypeDecl()))
         extends->ReportNotDeclaredIdentifier(LookingForClass);
 }
 
 void ClassDecl::CheckImplements() {
-    Scope *s = scope->GetParent();
-
-    for (int i = 0, n = implements->NumElements(); i < n; ++i) {
-        NamedType *nth = implements->Nth(i);
-        Decl *lookup = s->table->Lookup(implements->Nth(i)->Name());
-
-        if (dynamic_cast<InterfaceDecl*>(lookup) == NULL)
+    for (NamedType *nth : *implements) {
+        if (!isa<InterfaceDecl>(nth->GetTypeDecl()))
             nth->ReportNotDeclaredIdentifier(LookingForInterface);
     }
 }
 
+// Checks against extType and the classes above it, the topmost first
 void ClassDecl::CheckExtendedMembers(NamedType *extType) {
     if (extType == NULL)
         return;
 
-    Decl *lookup = this->GetParent()->GetScope()->table->Lookup(extType->Name());
-    ClassDecl *extDecl = dynamic_cast<ClassDecl*>(lookup);
-    if (extDecl == NULL)
-        return;
-
-    CheckExtendedMembers(extDecl->extends);
-    CheckAgainstScope(extDecl->scope);
+    const vector<NamedType*> &supers = extType->GetDisplay();
+    size_t first = supers.size();
+    while (first > 0 && isa<ClassDecl>(supers[first - 1]->GetTypeDecl()))
+        --first;
+    for (size_t i = first; i < supers.size(); ++i)
+        CheckAgainstScope(cast<ClassDecl>(supers[i]->GetTypeDecl())->scope);
 }
 
 void ClassDecl::CheckImplementedMembers(NamedType *impType) {
-    Decl *lookup = scope->GetParent()->table->Lookup(impType->Name());
-    InterfaceDecl *intDecl = dynamic_cast<InterfaceDecl*>(lookup);
+    InterfaceDecl *intDecl = dyn_cast<InterfaceDecl>(impType->GetTypeDecl());
     if (intDecl == NULL)
         return;
 
@@ -134,12 +138,8 @@ void ClassDecl::CheckImplementedMembers(NamedType *impType) {
 }
 
 void ClassDecl::CheckImplementsInterfaces() {
-    Scope *s = scope->GetParent();
-
-    for (int i = 0, n = implements->NumElements(); i < n; ++i) {
-        NamedType *nth = implements->Nth(i);
-        Decl *lookup = s->table->Lookup(implements->Nth(i)->Name());
-        InterfaceDecl *intDecl = dynamic_cast<InterfaceDecl*>(lookup);
+    for (NamedType *nth : *implements) {
+        InterfaceDecl *intDecl = dyn_cast<InterfaceDecl>(nth->GetTypeDecl());
 
         if (intDecl == NULL)
             continue;
@@ -149,20 +149,17 @@ void ClassDecl::CheckImplementsInterfaces() {
         for (int i = 0, n = intMembers->NumElements(); i < n; ++i) {
             Decl *d = intMembers->Nth(i);
 
-            ClassDecl *classDecl = this;
-            Decl *classLookup;
-            while (classDecl != NULL) {
-                classLookup = classDecl->GetScope()->table->Lookup(d->GetName());
-
-                if (classLookup != NULL)
-                    break;
-
-                if (classDecl->GetExtends() == NULL) {
-                    classDecl = NULL;
-                } else {
-                    const char *extName = classDecl->GetExtends()->GetName();
-                    Decl *ext = Program::gScope->table->Lookup(extName);
-                    classDecl = dynamic_cast<ClassDecl*>(ext);
+            Decl *classLookup = scope->table->Lookup(d->GetName());
+            if (classLookup == NULL && extends != NULL) {
+                // the superclasses, from the nearest up
+                const vector<NamedType*> &supers = extends->GetDisplay();
+                for (auto it = supers.rbegin(); it != supers.rend(); ++it) {
+                    ClassDecl *c = dyn_cast<ClassDecl>((*it)->GetTypeDecl());
+                    if (c == NULL)
+                        break;
+                    classLookup = c->GetScope()->table->Lookup(d->GetName());
+                    if (classLookup != NULL)
+                        break;
                 }
             }
 
@@ -174,8 +171,8 @@ void ClassDecl::CheckImplementsInterfaces() {
     }
 }
 void ClassDecl::Check() {
-    for (int i = 0, n = members->NumElements(); i < n; ++i)
-        members->Nth(i)->Check();
+    for (Decl *d : *members)
+        d->Check();
 
     CheckExtends();
     CheckImplements();
@@ -196,162 +193,149 @@ void ClassDecl::CheckAgainstScope(Scope *other) {
         if (lookup == NULL)
             continue;
         //parents class define the same var with that in sub class
-        if (dynamic_cast<VarDecl*>(lookup) != NULL)
+        if (isa<VarDecl>(lookup))
             ReportError::DeclConflict(d, lookup);
 
         //declaration same name function but different signature in sub class
-        if (dynamic_cast<FnDecl*>(lookup) != NULL &&
+        if (isa<FnDecl>(lookup) &&
             !d->IsEquivalentTo(lookup))
             ReportError::OverrideMismatch(d);
     }
 }
 
-void ClassDecl::PreEmit() {
-    int memOffset = CodeGenerator::OffsetToFirstField;
-    int vtblOffset = CodeGenerator::OffsetToFirstMethod;
-
-    if(extends!= nullptr) {
-        Decl *d = Program::gScope->table->Lookup(extends->GetName());
-        Assert(d!=NULL);
-        memOffset+=d->GetMemBytes();
-        vtblOffset+=d->GetVTblBytes();
+/* Method: GetLayout
+ * -----------------
+ * Builds the layout on first use, starting from a copy of the
+ * superclass's layout (which is built first if need be). New fields go
+ * after the inherited ones. A method that overrides an inherited one
+ * takes over every slot holding a method of that name, and each of the
+ * class's own methods is then also given a fresh slot at the end, which
+ * is the vtable offset it records.
+ */
+ClassLayout *ClassDecl::GetLayout() {
+    if (layout != NULL)
+        return layout;
+
+    layout = new ClassLayout;
+    if (extends != NULL) {
+        ClassDecl *c = dyn_cast<ClassDecl>(extends->GetTypeDecl());
+        Assert(c != NULL);
+        *layout = *c->GetLayout();
     }
 
-    for(int i=0,n=members->NumElements();i<n;++i) {
-        VarDecl *d = dynamic_cast<VarDecl*>(members->Nth(i));
-        if(d== nullptr)
+    int memOffset = CodeGenerator::OffsetToFirstField + layout->memBytes;
+    for (Decl *m : *members) {
+        VarDecl *d = dyn_cast<VarDecl>(m);
+        if (d == NULL)
             continue;
         d->SetMemOffset(memOffset);
-        memOffset+=d->GetMemBytes();
+        memOffset += d->GetMemBytes();
+        layout->fields.push_back(d);
     }
+    layout->memBytes = memOffset - CodeGenerator::OffsetToFirstField;
+
+    vector<FnDecl*> &vtable = layout->vtable;
+    unordered_map<const char*, vector<int> > slots; // inherited, by name
+    for (int i = 0, n = vtable.size(); i < n; ++i)
+        slots[vtable[i]->GetName()].push_back(i);
 
-    for(int i=0,n=members->NumElements();i<n;++i) {
-        FnDecl *d = dynamic_cast<FnDecl*>(members->Nth(i));
-        if(d==NULL)
+    for (Decl *m : *members) {
+        FnDecl *d = dyn_cast<FnDecl>(m);
+        if (d == NULL)
             continue;
-        d->SetIsMethod(true);
-        d->SetVTblOffset(vtblOffset);
-        vtblOffset += CodeGenerator::VarSize;
+        auto found = slots.find(d->GetName());
+        if (found != slots.end())
+            for (size_t j = 0; j < found->second.size(); ++j)
+                vtable[found->second[j]] = d;
     }
 
-    for(int i=0,n=members->NumElements();i<n;++i) {
-        std::string prefix;
-        prefix +=GetName();
-        prefix +=".";
-        members->Nth(i)->AddLabelPrefix(prefix.c_str());
+    for (Decl *m : *members) {
+        FnDecl *d = dyn_cast<FnDecl>(m);
+        if (d == NULL)
+            continue;
+        d->SetIsMethod(true);
+        d->SetVTblOffset(CodeGenerator::OffsetToFirstMethod +
+                         vtable.size() * CodeGenerator::VarSize);
+        vtable.push_back(d);
     }
+    return layout;
+}
+
+void ClassDecl::PreEmit() {
+    GetLayout();
+
+    std::string prefix;
+    prefix +=GetName();
+    prefix +=".";
+    for (Decl *m : *members)
+        m->AddLabelPrefix(prefix.c_str());
 }
 
+// the methods are generated as parts of their own (see Program::Emit),
+// which leaves just the vtable
 Location *ClassDecl::Emit(CodeGenerator *cg) {
-    for (int i=0,n=members->NumElements();i<n;++i) {
-       // FnDecl* fnDecl = dynamic_cast<FnDecl*>(members->Nth(i));
-       // if(fnDecl!= nullptr) continue;
-        members->Nth(i)->Emit(cg);
-    }
-    List<FnDecl*> *decls = GetMethodDecls();
+    vector<FnDecl*> &vtable = GetLayout()->vtable;
     List<const char*> *labels = new List<const char*>;
-    for (int i=0,n=decls->NumElements();i<n;++i) {
-        labels->Append(decls->Nth(i)->GetLabel());
+    labels->Reserve(vtable.size());
+    for (size_t i = 0; i < vtable.size(); ++i) {
+        labels->Append(vtable[i]->GetLabel());
     }
 
     cg->GenVTable(GetName(),labels);
     return nullptr;
 }
 
-List<FnDecl *> *ClassDecl::GetMethodDecls() {
-    List<FnDecl*> *decls = new List<FnDecl*>;
-    if(extends!=NULL) {
-        Decl *d = Program::gScope->table->Lookup(extends->GetName());
-        ClassDecl *c = dynamic_cast<ClassDecl*>(d);
-        Assert(c!= nullptr);
-        List<FnDecl*> *exDecls = c->GetMethodDecls();
-        for (int i=0,n=exDecls->NumElements();i<n;++i)
-            decls->Append(exDecls->Nth(i));
-    }
-
-    for(int i=0,n=members->NumElements();i<n;++i) {
-        FnDecl* d = dynamic_cast<FnDecl*>(members->Nth(i));
-        if(d==nullptr)
-            continue;
-
-        for(int j=0,m=decls->NumElements();j<m;++j) {
-            if(strcmp(decls->Nth(j)->GetName(),d->GetName())==0) {
-                decls->RemoveAt(j);
-                decls->InsertAt(d,j);
-            }
-        }
-    }
-
-    for(int i=0,n=members->NumElements();i<n;++i) {
-        FnDecl *d = dynamic_cast<FnDecl*>(members->Nth(i));
-        if(d== nullptr)
-            continue;
-        //some same funcs are put into decls, need to revise and improve it.
-        decls->Append(d);
-    }
-    return decls;
-}
-
 int ClassDecl::GetMemBytes() {
-    int memBytes = 0;
-
-    if (extends != NULL) {
-        Decl *d = Program::gScope->table->Lookup(extends->GetName());
-        Assert(d != NULL);
-        memBytes += d->GetMemBytes();
-    }
-
-    for (int i = 0, n = members->NumElements(); i < n; ++i)
-        memBytes += members->Nth(i)->GetMemBytes();
-
-    return memBytes;
-}
-
-int ClassDecl::GetVTblBytes() {
-    int vtblBytes = 0;
-    if(extends!= nullptr) {
-        Decl *d = Program::gScope->table->Lookup(extends->GetName());
-        Assert(d!= nullptr);
-        vtblBytes +=d->GetVTblBytes();
-    }
-    for(int i=0,n=members->NumElements();i<n;++i) {
-        vtblBytes+=members->Nth(i)->GetVTblBytes();
-    }
-
-    return vtblBytes;
+    return GetLayout()->memBytes;
 }
 
 
-InterfaceDecl::InterfaceDecl(Identifier *n, List<Decl*> *m) : Decl(n) {
+InterfaceDecl::InterfaceDecl(Identifier *n, List<Decl*> *m) : Decl(InterfaceDeclNode, n) {
     Assert(n != NULL && m != NULL);
     (members=m)->SetParentAll(this);
+    type = Compilation::Current()->types->Named(id);
 }
 
 void InterfaceDecl::BuildScope() {
 
 
-    for (int i = 0, n = members->NumElements(); i < n; ++i)
-        scope->AddDecl(members->Nth(i));
+    for (Decl *d : *members)
+        scope->AddDecl(d);
+
+    for (Decl *d : *members)
+        d->BuildScope();
+}
 
-    for (int i = 0, n = members->NumElements(); i < n; ++i)
-        members->Nth(i)->BuildScope();
+void InterfaceDecl::Resolve(Resolver *r) {
+    r->PushScope(scope);
+    for (Decl *d : *members)
+        d->Resolve(r);
+    r->PopScope();
 }
 
 void InterfaceDecl::Check() {
-    for (int i = 0, n = members->NumElements(); i < n; ++i)
-        members->Nth(i)->Check();
+    for (Decl *d : *members)
+        d->Check();
 }
 
 
-FnDecl::FnDecl(Identifier *n, Type *r, List<VarDecl*> *d) : Decl(n) {
+FnDecl::FnDecl(Identifier *n, Type *r, List<VarDecl*> *d) : Decl(FnDeclNode, n) {
     Assert(n != NULL && r!= NULL && d != NULL);
     (returnType=r)->SetParent(this);
     (formals=d)->SetParentAll(this);
     body = NULL;
-    label = new std::string(GetName());
-    if (*label != "main")
-        label->insert(0, "____"); // Prefix function labels to avoid conflicts
+    label = GetName();
+    if (strcmp(label, "main") != 0) { // Prefix function labels to avoid conflicts
+        std::string prefixed("____");
+        label = Symbols::Intern((prefixed += label).c_str());
+    }
     isMethod = false;
+    vtlOffset = 0;
+    uses = new List<Decl*>;
+}
+
+const char *FnDecl::GetSourceText() {
+    return Compilation::Current()->source->Text() + id->GetLocation().begin;
 }
 
 void FnDecl::SetFunctionBody(Stmt *b) { 
@@ -359,7 +343,7 @@ void FnDecl::SetFunctionBody(Stmt *b) {
 }
 
 bool FnDecl::IsEquivalentTo(Decl *other) {
-    FnDecl *fnDecl = dynamic_cast<FnDecl*>(other);
+    FnDecl *fnDecl = dyn_cast<FnDecl>(other);
 
     if (fnDecl == NULL)
         return false;
@@ -381,30 +365,40 @@ void FnDecl::BuildScope() {
 
     scope->SetFnDecl(this);
 
-    for (int i = 0, n = formals->NumElements(); i < n; ++i)
-        scope->AddDecl(formals->Nth(i));
+    for (VarDecl *d : *formals)
+        scope->AddDecl(d);
 
-    for (int i = 0, n = formals->NumElements(); i < n; ++i)
-        formals->Nth(i)->BuildScope();
+    for (VarDecl *d : *formals)
+        d->BuildScope();
 
     if (body)
         body->BuildScope();
 }
 
+void FnDecl::Resolve(Resolver *r) {
+    FnDecl *outer = r->fnDecl;
+    r->fnDecl = this;
+    r->used.clear();
+    r->PushScope(scope);
+    for (VarDecl *d : *formals)
+        d->Resolve(r);
+    if (body)
+        body->Resolve(r);
+    r->PopScope();
+    r->fnDecl = outer;
+}
+
 void FnDecl::Check() {
-    for (int i = 0, n = formals->NumElements(); i < n; ++i)
-        formals->Nth(i)->Check();
+    for (VarDecl *d : *formals)
+        d->Check();
 
     if (body)
         body->Check();
 }
 
-int FnDecl::GetVTblBytes() {
-    return CodeGenerator::VarSize;
-}
-
 void FnDecl::AddLabelPrefix(const char *prefix) {
-    label->insert(0,prefix);
+    std::string prefixed(prefix);
+    label = Symbols::Intern((prefixed += label).c_str());
 }
 
 Location *FnDecl::Emit(CodeGenerator *cg) {
@@ -413,8 +407,7 @@ Location *FnDecl::Emit(CodeGenerator *cg) {
     if(isMethod)
         offset +=CodeGenerator::VarSize;
 
-    for (int i=0,n=formals->NumElements();i<n;++i){
-        VarDecl *d = formals->Nth(i);
+    for (VarDecl *d : *formals) {
         Location *loc = new Location(fpRelative,offset,d->GetName());
         d->SetMemLoc(loc);
         offset +=d->GetMemBytes();
@@ -422,7 +415,7 @@ Location *FnDecl::Emit(CodeGenerator *cg) {
 
     if(body!= nullptr) {
         cg->GenLabel(GetLabel());
-        cg->GenBeginFunc()->SetFrameSize(body->GetMemBytes()+1024*CodeGenerator::VarSize);
+        cg->GenBeginFunc();
         body->Emit(cg);
         cg->GenEndFunc();
     }
@@ -430,7 +423,7 @@ Location *FnDecl::Emit(CodeGenerator *cg) {
 }
 
 const char *FnDecl::GetLabel() {
-    return label->c_str();
+    return label;
 }
 
 bool FnDecl::HasReturnVal() {
@@ -441,5 +434,25 @@ void FnDecl::PreEmit() {
 
 }
 
+int VarDecl::Write(AstWriter *out) {
+    int kids[] = { out->Add(id), out->Add(type) };
+    return out->AddNode(VarDeclNode, NULL, kids, 2);
+}
+
+int ClassDecl::Write(AstWriter *out) {
+    int kids[] = { out->Add(id), out->Add(extends), out->AddList(implements),
+                   out->AddList(members) };
+    return out->AddNode(ClassDeclNode, NULL, kids, 4);
+}
 
+int InterfaceDecl::Write(AstWriter *out) {
+    int kids[] = { out->Add(id), out->AddList(members) };
+    return out->AddNode(InterfaceDeclNode, NULL, kids, 2);
+}
 
+// A prototype has no body
+int FnDecl::Write(AstWriter *out) {
+    int kids[] = { out->Add(id), out->Add(returnType), out->AddList(formals),
+                   out->Add(body) };
+    return out->AddNode(FnDeclNode, NULL, kids, 4);
+}
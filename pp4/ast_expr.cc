@@ -4,9 +4,12 @@
  */
 
 #include <string.h>
+#include <vector>
 #include "include/ast_expr.h"
 #include "include/ast_type.h"
 #include "include/ast_decl.h"
+#include "include/compilation.h"
+#include "include/astfile.h"
 
 
 
@@ -15,7 +18,7 @@ Decl* Expr::GetFieldDecl(Identifier *field, Expr *b) {
     if (b != NULL)
         return GetFieldDecl(field, b->GetType());
 
-    Decl *d = GetFieldDecl(field, static_cast<Node*>(this));
+    Decl *d = field->GetDecl();
 
     if (d == NULL) {
         ClassDecl *classDecl = GetClassDecl();
@@ -30,21 +33,21 @@ Decl* Expr::GetFieldDecl(Identifier *field, Expr *b) {
 
 
 Decl* Expr::GetFieldDecl(Identifier *f, Type *b) {
-    NamedType *t = dynamic_cast<NamedType*>(b);
+    NamedType *t = dyn_cast<NamedType>(b);
 
     while (t != NULL) {
-        Decl *d = Program::gScope->table->Lookup(t->Name());
-        ClassDecl *c = dynamic_cast<ClassDecl*>(d);
-        InterfaceDecl *i = dynamic_cast<InterfaceDecl*>(d);
+        Decl *d = t->GetTypeDecl();
+        ClassDecl *c = dyn_cast<ClassDecl>(d);
+        InterfaceDecl *i = dyn_cast<InterfaceDecl>(d);
 
         Decl *fieldDecl;
         if (c != NULL) {
-            if ((fieldDecl = GetFieldDecl(f, c->GetNode())) != NULL)
+            if ((fieldDecl = GetFieldDecl(f, c)) != NULL)
                 return fieldDecl;
             else
                 t = c->GetExtends();
         } else if (i != NULL) {
-            if ((fieldDecl = GetFieldDecl(f, i->GetNode())) != NULL)
+            if ((fieldDecl = GetFieldDecl(f, i)) != NULL)
                 return fieldDecl;
             else
                 t = NULL;
@@ -53,7 +56,7 @@ Decl* Expr::GetFieldDecl(Identifier *f, Type *b) {
         }
     }
 
-    return GetFieldDecl(f, this->GetNode());
+    return f->GetDecl();
 }
 
 
@@ -62,33 +65,22 @@ Location *Expr::GetThisLoc() {
     return new Location(fpRelative, CodeGenerator::OffsetToFirstParam, "this");
 }
 
-Decl *Expr::GetFieldDecl(Identifier *field, Node *n) {
-    while (n != NULL) {
-        Decl *d = n->GetScope()->table->Lookup(field->GetName());
-        if (d != NULL)
-            return d;
-        n = n->GetParent();
-    }
-    return NULL;
-}
-
-ClassDecl *Expr::GetClassDecl() {
-    Node *n = this;
-    while (n != nullptr) {
-        if (dynamic_cast<ClassDecl*>(n))
-            return static_cast<ClassDecl*>(n);
-        n = n->GetParent();
-    }
-    return nullptr;
+// classes and interfaces are declared at the top level, so the global
+// scope is the only one enclosing their own
+Decl *Expr::GetFieldDecl(Identifier *field, Decl *d) {
+    Decl *fieldDecl = d->GetScope()->table->Lookup(field->GetName());
+    if (fieldDecl != NULL)
+        return fieldDecl;
+    return Program::GlobalScope()->table->Lookup(field->GetName());
 }
 
 Decl *Expr::GetFieldDeclInOneNode(Identifier *f, Type *b) {
-    NamedType *t = dynamic_cast<NamedType*>(b);
+    NamedType *t = dyn_cast<NamedType>(b);
 
     while (t != NULL) {
-        Decl *d = Program::gScope->table->Lookup(t->Name());
-        ClassDecl *c = dynamic_cast<ClassDecl*>(d);
-        InterfaceDecl *i = dynamic_cast<InterfaceDecl*>(d);
+        Decl *d = t->GetTypeDecl();
+        ClassDecl *c = dyn_cast<ClassDecl>(d);
+        InterfaceDecl *i = dyn_cast<InterfaceDecl>(d);
 
         Decl *fieldDecl;
         if (c != NULL) {
@@ -110,10 +102,35 @@ Decl *Expr::GetFieldDeclInOneNode(Identifier *f, Type *b) {
 }
 
 
-IntConstant::IntConstant(yyltype loc, int val) : Expr(loc) {
+/* Method: CacheType
+ * -----------------
+ * The type of an operation is worked out from its operands' types, so
+ * for a chain of operations down the left operands, ComputeType would
+ * recurse down the whole chain. Instead the operations below whose
+ * types are not yet known are gathered on an explicit stack and their
+ * types computed from the bottom up, each finding its left operand's
+ * already cached.
+ */
+void Expr::CacheType() {
+    vector<Expr*> above;
+    Expr *e = this;
+    for (CompoundExpr *c; (c = dyn_cast<CompoundExpr>(e)) != NULL &&
+                          c->GetLeft() != NULL && c->GetLeft()->type == NULL;
+         e = c->GetLeft())
+        above.push_back(c);
+
+    e->type = e->ComputeType();
+    while (!above.empty()) {
+        above.back()->type = above.back()->ComputeType();
+        above.pop_back();
+    }
+}
+
+
+IntConstant::IntConstant(SourceRange loc, int val) : Expr(IntConstantNode, loc) {
     value = val;
 }
-Type* IntConstant::GetType() {
+Type* IntConstant::ComputeType() {
     return Type::intType;
 }
 
@@ -121,15 +138,11 @@ Location *IntConstant::Emit(CodeGenerator *cg) {
     return cg->GenLoadConstant(value);
 }
 
-int IntConstant::GetMemBytes() {
-    return 4;
-}
-
-DoubleConstant::DoubleConstant(yyltype loc, double val) : Expr(loc) {
+DoubleConstant::DoubleConstant(SourceRange loc, double val) : Expr(DoubleConstantNode, loc) {
     value = val;
 }
 
-Type* DoubleConstant::GetType() {
+Type* DoubleConstant::ComputeType() {
     return Type::doubleType;
 }
 
@@ -138,15 +151,11 @@ Location *DoubleConstant::Emit(CodeGenerator *cg) {
     return nullptr;
 }
 
-int DoubleConstant::GetMemBytes() {
-    return 4;
-}
-
-BoolConstant::BoolConstant(yyltype loc, bool val) : Expr(loc) {
+BoolConstant::BoolConstant(SourceRange loc, bool val) : Expr(BoolConstantNode, loc) {
     value = val;
 }
 
-Type* BoolConstant::GetType() {
+Type* BoolConstant::ComputeType() {
     return Type::boolType;
 }
 
@@ -154,17 +163,12 @@ Location *BoolConstant::Emit(CodeGenerator *cg) {
     return cg->GenLoadConstant(value?1:0);
 }
 
-int BoolConstant::GetMemBytes() {
-    return 4;
-}
-
-
-StringConstant::StringConstant(yyltype loc, const char *val) : Expr(loc) {
+StringConstant::StringConstant(SourceRange loc, const char *val) : Expr(StringConstantNode, loc) {
     Assert(val != NULL);
-    value = strdup(val);
+    value = Compilation::Current()->NodeArena().Strdup(val);
 }
 
-Type* StringConstant::GetType() {
+Type* StringConstant::ComputeType() {
     return Type::stringType;
 }
 
@@ -172,11 +176,7 @@ Location *StringConstant::Emit(CodeGenerator *cg) {
     return cg->GenLoadConstant(value);
 }
 
-int StringConstant::GetMemBytes() {
-    return 4;
-}
-
-Type* NullConstant::GetType() {
+Type* NullConstant::ComputeType() {
     return Type::nullType;
 }
 
@@ -184,24 +184,20 @@ Location *NullConstant::Emit(CodeGenerator *cg) {
     return cg->GenLoadConstant(0);
 }
 
-int NullConstant::GetMemBytes() {
-    return 4;
-}
-
-Operator::Operator(yyltype loc, const char *tok) : Node(loc) {
+Operator::Operator(SourceRange loc, const char *tok) : Node(OperatorNode, loc) {
     Assert(tok != NULL);
     strncpy(tokenString, tok, sizeof(tokenString));
 }
-CompoundExpr::CompoundExpr(Expr *l, Operator *o, Expr *r) 
-  : Expr(Join(l->GetLocation(), r->GetLocation())) {
+CompoundExpr::CompoundExpr(NodeKind k, Expr *l, Operator *o, Expr *r) 
+  : Expr(k, Join(l->GetLocation(), r->GetLocation())) {
     Assert(l != NULL && o != NULL && r != NULL);
     (op=o)->SetParent(this);
     (left=l)->SetParent(this); 
     (right=r)->SetParent(this);
 }
 
-CompoundExpr::CompoundExpr(Operator *o, Expr *r) 
-  : Expr(Join(o->GetLocation(), r->GetLocation())) {
+CompoundExpr::CompoundExpr(NodeKind k, Operator *o, Expr *r) 
+  : Expr(k, Join(o->GetLocation(), r->GetLocation())) {
     Assert(o != NULL && r != NULL);
     left = NULL; 
     (op=o)->SetParent(this);
@@ -210,21 +206,82 @@ CompoundExpr::CompoundExpr(Operator *o, Expr *r)
 
 
 
-void CompoundExpr::BuildScope() {
-
-
-    if(left!=NULL)
-        left->BuildScope();
-    right->BuildScope();
+/* Method: Resolve
+ * ---------------
+ * Nothing here depends on the order the operands are resolved in, so a
+ * chain of operations down the left operands is resolved in a loop.
+ */
+void CompoundExpr::Resolve(Resolver *r) {
+    CompoundExpr *c = this;
+    for (;;) {
+        c->Expr::Resolve(r);
+        c->right->Resolve(r);
+        CompoundExpr *l = dyn_cast<CompoundExpr>(c->left);
+        if (l == NULL)
+            break;
+        c = l;
+    }
+    if (c->left != NULL)
+        c->left->Resolve(r);
 }
 
+/* Method: Check
+ * -------------
+ * Checks the left operand, then the right one and the operator. The
+ * operations down a chain of left operands are gathered on an explicit
+ * stack and then checked from the bottom up, in the order recursing
+ * would have taken. A relational operation checks only its operator,
+ * so it has its own Check and ends the chain.
+ */
 void CompoundExpr::Check() {
-    if(left!=NULL)
-        left->Check();
-    right->Check();
+    vector<CompoundExpr*> above;
+    CompoundExpr *c = this;
+    for (CompoundExpr *l; (l = dyn_cast<CompoundExpr>(c->left)) != NULL &&
+                          !isa<RelationalExpr>(l); c = l)
+        above.push_back(c);
+
+    if (c->left != NULL)
+        c->left->Check();
+    c->CheckOperation();
+    while (!above.empty()) {
+        above.back()->CheckOperation();
+        above.pop_back();
+    }
 }
 
-Type* ArithmeticExpr::GetType() {
+/* Method: Emit
+ * ------------
+ * Emits each operation down the chain of left operands up to its left
+ * operand, top down, then the left operand at the bottom, and then the
+ * rest of each operation, bottom up, given the value of the one below,
+ * which is the order recursing would have taken.
+ */
+Location *CompoundExpr::Emit(CodeGenerator *cg) {
+    struct Pending {
+        CompoundExpr *op;
+        Emitted emitted;
+    };
+    vector<Pending> above;
+    CompoundExpr *c = this;
+    Emitted e = Emitted();
+    c->EmitBeforeLeft(cg, &e);
+    for (CompoundExpr *l; (l = dyn_cast<CompoundExpr>(c->left)) != NULL; c = l) {
+        above.push_back({c, e});
+        e = Emitted();
+        l->EmitBeforeLeft(cg, &e);
+    }
+
+    Location *ltemp = c->left == NULL ? NULL : c->EmitLeft(cg);
+    ltemp = c->EmitAfterLeft(cg, ltemp, &e);
+    while (!above.empty()) {
+        Pending &p = above.back();
+        ltemp = p.op->EmitAfterLeft(cg, ltemp, &p.emitted);
+        above.pop_back();
+    }
+    return ltemp;
+}
+
+Type* ArithmeticExpr::ComputeType() {
     Type* rtype = right->GetType();
     if(left==NULL) {
             if(rtype->IsEquivalentTo(Type::intType)||
@@ -246,9 +303,7 @@ Type* ArithmeticExpr::GetType() {
 
 }
 
-void ArithmeticExpr::Check() {
-    if(left!=NULL)
-        left->Check();
+void ArithmeticExpr::CheckOperation() {
     right->Check();
     Type* rtype = right->GetType();
     if(left==NULL) {
@@ -271,18 +326,12 @@ void ArithmeticExpr::Check() {
     ReportError::IncompatibleOperands(op,ltype,rtype);
 }
 
-Location *ArithmeticExpr::Emit(CodeGenerator *cg) {
+Location *ArithmeticExpr::EmitAfterLeft(CodeGenerator *cg, Location *ltemp,
+                                        Emitted *e) {
     if(left==nullptr)
         return EmitUnary(cg);
     else
-        return EmitBinary(cg);
-}
-
-int ArithmeticExpr::GetMemBytes() {
-    if(left== nullptr)
-        return GetMemBytesUnary();
-    else
-        return GetMemBytesBinary();
+        return EmitBinary(cg, ltemp);
 }
 
 Location *ArithmeticExpr::EmitUnary(CodeGenerator *cg) {
@@ -292,22 +341,13 @@ Location *ArithmeticExpr::EmitUnary(CodeGenerator *cg) {
     return cg->GenBinaryOp(op->GetTokenString(),zero,rtemp);
 }
 
-int ArithmeticExpr::GetMemBytesUnary() {
-    return right->GetMemBytes()+2*CodeGenerator::VarSize;
-}
-
-Location *ArithmeticExpr::EmitBinary(CodeGenerator *cg) {
-    Location *ltemp = left->Emit(cg);
+Location *ArithmeticExpr::EmitBinary(CodeGenerator *cg, Location *ltemp) {
     Location *rtemp = right->Emit(cg);
 
     return cg->GenBinaryOp(op->GetTokenString(),ltemp,rtemp);
 }
 
-int ArithmeticExpr::GetMemBytesBinary() {
-   return right->GetMemBytes()+left->GetMemBytes()+2*CodeGenerator::VarSize;
-}
-
-Type* RelationalExpr::GetType() {
+Type* RelationalExpr::ComputeType() {
     Type *rtype= right->GetType();
     Type *ltype = left->GetType();
 
@@ -321,6 +361,10 @@ Type* RelationalExpr::GetType() {
 }
 
 void RelationalExpr::Check() {
+    CheckOperation();
+}
+
+void RelationalExpr::CheckOperation() {
     Type *rtype = right->GetType();
     Type *ltype = left->GetType();
     if(ltype->IsEquivalentTo(Type::intType)&&
@@ -333,64 +377,49 @@ void RelationalExpr::Check() {
     ReportError::IncompatibleOperands(op,ltype,rtype);
 }
 
-Location *RelationalExpr::Emit(CodeGenerator *cg) {
+// > and >= are emitted as < and <= with the operands swapped, so the
+// right operand comes first
+bool RelationalExpr::IsReversed() {
     const char *tok = op->GetTokenString();
+    return strcmp(">",tok)==0 || strcmp(">=",tok)==0;
+}
 
-    if(strcmp("<",tok)==0)
-        return EmitLess(cg,left,right);
-    else if(strcmp("<=",tok)==0)
-        return EmitLessEqual(cg,left,right);
-    else if(strcmp(">",tok)==0)
-        return EmitLess(cg,right,left);
-    else if(strcmp(">=",tok)==0)
-        return EmitLessEqual(cg,right,left);
-    else
-        Assert(0);
-    return nullptr;
+void RelationalExpr::EmitBeforeLeft(CodeGenerator *cg, Emitted *e) {
+    if (IsReversed())
+        e->temp = right->Emit(cg);
 }
 
-int RelationalExpr::GetMemBytes() {
+Location *RelationalExpr::EmitAfterLeft(CodeGenerator *cg, Location *ltemp,
+                                        Emitted *e) {
     const char *tok = op->GetTokenString();
 
     if(strcmp("<",tok)==0)
-        return GetMemBytesLess(left,right);
+        return EmitLess(cg,ltemp,right->Emit(cg));
     else if(strcmp("<=",tok)==0)
-        return GetMemBytesLessEqual(left,right);
+        return EmitLessEqual(cg,ltemp,right->Emit(cg));
     else if(strcmp(">",tok)==0)
-        return GetMemBytesLess(right,left);
+        return EmitLess(cg,e->temp,ltemp);
     else if(strcmp(">=",tok)==0)
-        return GetMemBytesLessEqual(right,left);
+        return EmitLessEqual(cg,e->temp,ltemp);
     else
         Assert(0);
-    return 0;
+    return nullptr;
 }
 
-Location *RelationalExpr::EmitLess(CodeGenerator *cg, Expr *l, Expr *r) {
-    Location *ltmp = l->Emit(cg);
-    Location *rtmp = r->Emit(cg);
-
+Location *RelationalExpr::EmitLess(CodeGenerator *cg, Location *ltmp,
+                                   Location *rtmp) {
     return cg->GenBinaryOp("<",ltmp,rtmp);
 }
 
-int RelationalExpr::GetMemBytesLess(Expr *l, Expr *r) {
-    return l->GetMemBytes() + r->GetMemBytes() + 2*CodeGenerator::VarSize;
-}
-
-Location *RelationalExpr::EmitLessEqual(CodeGenerator *cg, Expr *l, Expr *r) {
-    Location *ltmp = l->Emit(cg);
-    Location *rtmp = r->Emit(cg);
-
+Location *RelationalExpr::EmitLessEqual(CodeGenerator *cg, Location *ltmp,
+                                        Location *rtmp) {
     Location *less = cg->GenBinaryOp("<", ltmp, rtmp);
     Location *equal = cg->GenBinaryOp("==", ltmp, rtmp);
 
     return cg->GenBinaryOp("||", less, equal);
 }
 
-int RelationalExpr::GetMemBytesLessEqual(Expr *l, Expr *r) {
-    return l->GetMemBytes() + r->GetMemBytes() + 3 * CodeGenerator::VarSize;
-}
-
-Type* EqualityExpr::GetType() {
+Type* EqualityExpr::ComputeType() {
     Type *rtype = right->GetType();
     Type *ltype = left->GetType();
 
@@ -401,8 +430,7 @@ Type* EqualityExpr::GetType() {
     return Type::boolType;
 }
 
-void EqualityExpr::Check() {
-    left->Check();
+void EqualityExpr::CheckOperation() {
     right->Check();
 
     Type *rtype = right->GetType();
@@ -414,31 +442,27 @@ void EqualityExpr::Check() {
 
 }
 
-Location *EqualityExpr::Emit(CodeGenerator *cg) {
-    const char *tok = op->GetTokenString();
-    if(strcmp("==",tok)==0)
-        return EmitEqual(cg);
-    else if (strcmp("!=",tok)==0)
-        return EmitNotEqual(cg);
-    else
-        Assert(0);
-    return nullptr;
+void EqualityExpr::EmitBeforeLeft(CodeGenerator *cg, Emitted *e) {
+    if(strcmp("!=",op->GetTokenString())==0) {
+        e->labels[0] = cg->NewLabel();
+        e->labels[1] = cg->NewLabel();
+        e->temp = cg->GenTempVar();
+    }
 }
 
-int EqualityExpr::GetMemBytes() {
+Location *EqualityExpr::EmitAfterLeft(CodeGenerator *cg, Location *ltemp,
+                                      Emitted *e) {
     const char *tok = op->GetTokenString();
-
     if(strcmp("==",tok)==0)
-        return GetMemBytesEqual();
-    else if(strcmp("!=",tok)==0)
-        return GetMemBytesNotEqual();
+        return EmitEqual(cg, ltemp);
+    else if (strcmp("!=",tok)==0)
+        return EmitNotEqual(cg, ltemp, e);
     else
         Assert(0);
-    return 0;
+    return nullptr;
 }
 
-Location *EqualityExpr::EmitEqual(CodeGenerator *cg) {
-    Location *ltmp = left->Emit(cg);
+Location *EqualityExpr::EmitEqual(CodeGenerator *cg, Location *ltmp) {
     Location *rtmp = right->Emit(cg);
 
     if(left->GetType()->IsEquivalentTo(Type::stringType))
@@ -447,16 +471,12 @@ Location *EqualityExpr::EmitEqual(CodeGenerator *cg) {
         return cg->GenBinaryOp("==",ltmp,rtmp);
 }
 
-int EqualityExpr::GetMemBytesEqual() {
-    return left->GetMemBytes()+right->GetMemBytes()+2*CodeGenerator::VarSize;
-}
-
-Location *EqualityExpr::EmitNotEqual(CodeGenerator *cg) {
-    const char* ret_zro = cg->NewLabel();
-    const char* ret_one = cg->NewLabel();
-    Location *ret = cg->GenTempVar();
+Location *EqualityExpr::EmitNotEqual(CodeGenerator *cg, Location *ltmp,
+                                     Emitted *e) {
+    const char* ret_zro = e->labels[0];
+    const char* ret_one = e->labels[1];
+    Location *ret = e->temp;
 
-    Location *ltmp = left->Emit(cg);
     Location *rtmp = right->Emit(cg);
 
     Location *equal;
@@ -474,11 +494,7 @@ Location *EqualityExpr::EmitNotEqual(CodeGenerator *cg) {
     return ret;
 }
 
-int EqualityExpr::GetMemBytesNotEqual() {
-   return left->GetMemBytes()+right->GetMemBytes()+4*CodeGenerator::VarSize;
-}
-
-Type* LogicalExpr::GetType() {
+Type* LogicalExpr::ComputeType() {
     Type* rtype= right->GetType();
     if(left==NULL) {
         if(rtype->IsEquivalentTo(Type::boolType))
@@ -495,9 +511,7 @@ Type* LogicalExpr::GetType() {
     return Type::errorType;
 }
 
-void LogicalExpr::Check() {
-    if(left!=NULL)
-        left->Check();
+void LogicalExpr::CheckOperation() {
     right->Check();
     Type *rtype = right->GetType();
     if(left==NULL) {
@@ -515,62 +529,46 @@ void LogicalExpr::Check() {
     ReportError::IncompatibleOperands(op,ltype,rtype);
 }
 
-Location *LogicalExpr::Emit(CodeGenerator *cg) {
-    const char *tok = op->GetTokenString();
-
-    if (strcmp("&&", tok) == 0)
-        return EmitAnd(cg);
-    else if (strcmp("||", tok) == 0)
-        return EmitOr(cg);
-    else if (strcmp("!", tok) == 0)
-        return EmitNot(cg);
-    else
-        Assert(0); // Should never reach this point!
-
-    return 0;
+void LogicalExpr::EmitBeforeLeft(CodeGenerator *cg, Emitted *e) {
+    if (strcmp("!", op->GetTokenString()) == 0) {
+        e->labels[0] = cg->NewLabel();
+        e->labels[1] = cg->NewLabel();
+        e->temp = cg->GenTempVar();
+    }
 }
 
-int LogicalExpr::GetMemBytes() {
+Location *LogicalExpr::EmitAfterLeft(CodeGenerator *cg, Location *ltemp,
+                                     Emitted *e) {
     const char *tok = op->GetTokenString();
 
     if (strcmp("&&", tok) == 0)
-        return GetMemBytesAnd();
+        return EmitAnd(cg, ltemp);
     else if (strcmp("||", tok) == 0)
-        return GetMemBytesOr();
+        return EmitOr(cg, ltemp);
     else if (strcmp("!", tok) == 0)
-        return GetMemBytesNot();
+        return EmitNot(cg, e);
     else
         Assert(0); // Should never reach this point!
 
     return 0;
 }
 
-Location *LogicalExpr::EmitAnd(CodeGenerator *cg) {
-    Location *ltmp = left->Emit(cg);
+Location *LogicalExpr::EmitAnd(CodeGenerator *cg, Location *ltmp) {
     Location *rtmp = right->Emit(cg);
 
     return cg->GenBinaryOp("&&", ltmp, rtmp);
 }
 
-int LogicalExpr::GetMemBytesAnd() {
-    return left->GetMemBytes() + right->GetMemBytes() + CodeGenerator::VarSize;
-}
-
-Location *LogicalExpr::EmitOr(CodeGenerator *cg) {
-    Location *ltmp = left->Emit(cg);
+Location *LogicalExpr::EmitOr(CodeGenerator *cg, Location *ltmp) {
     Location *rtmp = right->Emit(cg);
 
     return cg->GenBinaryOp("||", ltmp, rtmp);
 }
 
-int LogicalExpr::GetMemBytesOr() {
-    return left->GetMemBytes() + right->GetMemBytes() + CodeGenerator::VarSize;
-}
-
-Location *LogicalExpr::EmitNot(CodeGenerator *cg) {
-    const char* ret_zro = cg->NewLabel();
-    const char* ret_one = cg->NewLabel();
-    Location *ret = cg->GenTempVar();
+Location *LogicalExpr::EmitNot(CodeGenerator *cg, Emitted *e) {
+    const char* ret_zro = e->labels[0];
+    const char* ret_one = e->labels[1];
+    Location *ret = e->temp;
 
     Location *rtmp = right->Emit(cg);
 
@@ -584,11 +582,7 @@ Location *LogicalExpr::EmitNot(CodeGenerator *cg) {
     return ret;
 }
 
-int LogicalExpr::GetMemBytesNot() {
-    return right->GetMemBytes() + 3 * CodeGenerator::VarSize;
-}
-
-Type* AssignExpr::GetType() {
+Type* AssignExpr::ComputeType() {
     Type *ltype = left->GetType();
     Type *rtype = right->GetType();
     if(!rtype->IsEquivalentTo(ltype))
@@ -597,8 +591,7 @@ Type* AssignExpr::GetType() {
     return ltype;
 }
 
-void AssignExpr::Check() {
-    left->Check();
+void AssignExpr::CheckOperation() {
     right->Check();
 
     Type *ltype = left->GetType();
@@ -609,28 +602,31 @@ void AssignExpr::Check() {
 
 }
 
-Location *AssignExpr::Emit(CodeGenerator *cg) {
-    Location *rtemp = right->Emit(cg);
-    LValue *lval = dynamic_cast<LValue*>(left);
+void AssignExpr::EmitBeforeLeft(CodeGenerator *cg, Emitted *e) {
+    e->temp = right->Emit(cg);
+}
+
+// An LValue is stored to rather than emitted
+Location *AssignExpr::EmitLeft(CodeGenerator *cg) {
+    if (isa<LValue>(left))
+        return NULL;
+    return left->Emit(cg);
+}
+
+Location *AssignExpr::EmitAfterLeft(CodeGenerator *cg, Location *ltemp,
+                                    Emitted *e) {
+    Location *rtemp = e->temp;
+    LValue *lval = dyn_cast<LValue>(left);
 
     if (lval != NULL)
         return lval->EmitStore(cg, rtemp);
 
-    Location *ltemp = left->Emit(cg);
     cg->GenAssign(ltemp, rtemp);
     return ltemp;
 
 }
 
-int AssignExpr::GetMemBytes() {
-    LValue *lval = dynamic_cast<LValue*>(left);
-    if (lval != NULL)
-        return right->GetMemBytes() + lval->GetMemBytesStore();
-
-    return right->GetMemBytes() + left->GetMemBytes();
-}
-
-Type* This::GetType() {
+Type* This::ComputeType() {
     ClassDecl *d = GetClassDecl();
     Assert(d != NULL);
     return d->GetType();
@@ -645,37 +641,30 @@ Location *This::Emit(CodeGenerator *cg) {
     return GetThisLoc();
 }
 
-int This::GetMemBytes() {
-    return CodeGenerator::VarSize;
-}
-
-void This::BuildScope() {
-
-}
-
 
-ArrayAccess::ArrayAccess(yyltype loc, Expr *b, Expr *s) : LValue(loc) {
+ArrayAccess::ArrayAccess(SourceRange loc, Expr *b, Expr *s) : LValue(ArrayAccessNode, loc) {
     (base=b)->SetParent(this); 
     (subscript=s)->SetParent(this);
 }
 
-Type* ArrayAccess::GetType() {
-    ArrayType *t = dynamic_cast<ArrayType*>(base->GetType());
+Type* ArrayAccess::ComputeType() {
+    ArrayType *t = dyn_cast<ArrayType>(base->GetType());
     if(t==NULL)
         return Type::errorType;
     return t->GetElemType();
 }
 
-void ArrayAccess::BuildScope() {
-    base->BuildScope();
-    subscript->BuildScope();
+void ArrayAccess::Resolve(Resolver *r) {
+    Expr::Resolve(r);
+    base->Resolve(r);
+    subscript->Resolve(r);
 }
 
 void ArrayAccess::Check() {
     base->Check();
     subscript->Check();
 
-    ArrayType *t = dynamic_cast<ArrayType*>(base->GetType());
+    ArrayType *t = dyn_cast<ArrayType>(base->GetType());
     if(t==NULL)
         ReportError::BracketsOnNonArray(base);
     if(!subscript->GetType()->IsEqualTo(Type::intType))
@@ -685,20 +674,12 @@ Location* ArrayAccess::Emit(CodeGenerator *cg) {
     return cg->GenLoad(EmitAddr(cg),CodeGenerator::VarSize);
 }
 
-int ArrayAccess::GetMemBytes() {
-    return GetMemBytesAddr() + CodeGenerator::VarSize;
-}
-
 Location* ArrayAccess::EmitStore(CodeGenerator *cg, Location *val) {
     Location *addr = EmitAddr(cg);
     cg->GenStore(addr, val, CodeGenerator::VarSize);
     return cg->GenLoad(addr, CodeGenerator::VarSize);
 }
 
-int ArrayAccess::GetMemBytesStore() {
-    return GetMemBytesAddr() + CodeGenerator::VarSize;
-}
-
 Location* ArrayAccess::EmitAddr(CodeGenerator *cg) {
     Location *b = base->Emit(cg);
     Location *s = subscript->Emit(cg);
@@ -716,11 +697,6 @@ Location* ArrayAccess::EmitAddr(CodeGenerator *cg) {
     return cg->GenBinaryOp("+", b, off);
 }
 
-int ArrayAccess::GetMemBytesAddr() {
-    return base->GetMemBytes() + subscript->GetMemBytes() +
-           4 * CodeGenerator::VarSize + GetMemBytesRuntimeSubscriptCheck();
-}
-
 Location* ArrayAccess::EmitRuntimeSubscriptCheck(CodeGenerator *cg,
                                                  Location *arr,
                                                  Location *sub) {
@@ -744,27 +720,27 @@ Location* ArrayAccess::EmitRuntimeSubscriptCheck(CodeGenerator *cg,
     return NULL;
 }
 
-int ArrayAccess::GetMemBytesRuntimeSubscriptCheck() {
-    return 8 * CodeGenerator::VarSize;
-}
 FieldAccess::FieldAccess(Expr *b, Identifier *f) 
-  : LValue(b? Join(b->GetLocation(), f->GetLocation()) : *f->GetLocation()) {
+  : LValue(FieldAccessNode, b? Join(b->GetLocation(), f->GetLocation()) : f->GetLocation()) {
     Assert(f != NULL); // b can be be NULL (just means no explicit base)
     base = b; 
     if (base) base->SetParent(this); 
     (field=f)->SetParent(this);
+    decl = NULL;
+    declResolved = false;
 }
 
-Type* FieldAccess::GetType() {
+Type* FieldAccess::ComputeType() {
     VarDecl *d = GetDecl();
     Assert(d != NULL);
     return d->GetType();
 }
 
-void FieldAccess::BuildScope() {
-
+void FieldAccess::Resolve(Resolver *r) {
+    Expr::Resolve(r);
     if(base!=NULL)
-        base->BuildScope();
+        base->Resolve(r);
+    field->SetDecl(r->Lookup(field));
 }
 
 void FieldAccess::Check() {
@@ -805,13 +781,13 @@ void FieldAccess::Check() {
         }
     }
 
-    if(dynamic_cast<VarDecl*>(d)==NULL) {
+    if(!isa<VarDecl>(d)) {
         ReportError::IdentifierNotDeclared(field,LookingForVariable);
     }
 }
 
 Location *FieldAccess::Emit(CodeGenerator *cg) {
-    FieldAccess *baseAccess = dynamic_cast<FieldAccess*>(base);
+    FieldAccess *baseAccess = dyn_cast<FieldAccess>(base);
     VarDecl *fieldDecl = GetDecl();
     Assert(fieldDecl != NULL);
 
@@ -825,7 +801,7 @@ Location *FieldAccess::Emit(CodeGenerator *cg) {
 }
 
 Location *FieldAccess::EmitStore(CodeGenerator *cg, Location *val) {
-    FieldAccess *baseAccess = dynamic_cast<FieldAccess*>(base);
+    FieldAccess *baseAccess = dyn_cast<FieldAccess>(base);
     VarDecl *fieldDecl = GetDecl();
     Assert(fieldDecl != NULL);
 
@@ -841,38 +817,12 @@ Location *FieldAccess::EmitStore(CodeGenerator *cg, Location *val) {
     return ltemp;
 }
 
-int FieldAccess::GetMemBytes() {
-    FieldAccess *baseAccess = dynamic_cast<FieldAccess*>(base);
-    VarDecl *fieldDecl = GetDecl();
-    Assert(fieldDecl != NULL);
-
-    if (baseAccess == NULL)
-        return GetMemBytesMemLoc(fieldDecl);
-
-    return CodeGenerator::VarSize;
-}
-
-int FieldAccess::GetMemBytesStore() {
-    FieldAccess *baseAccess = dynamic_cast<FieldAccess*>(base);
-    VarDecl *fieldDecl = GetDecl();
-    Assert(fieldDecl != NULL);
-
-    if (baseAccess == NULL)
-        return GetMemBytesMemLocStore(fieldDecl);
-
-    return 0;
-}
-
 VarDecl *FieldAccess::GetDecl() {
-    Decl *d = GetFieldDecl(field, base);
-    return dynamic_cast<VarDecl*>(d);
-}
-
-int FieldAccess::GetMemBytesMemLoc(VarDecl *fieldDecl) {
-    Location *loc = fieldDecl->GetMemLoc();
-    if (loc != NULL)
-        return 0;
-    return CodeGenerator::VarSize;
+    if (!declResolved) {
+        decl = GetFieldDecl(field, base);
+        declResolved = true;
+    }
+    return dyn_cast<VarDecl>(decl);
 }
 
 Location *FieldAccess::EmitMemLocStore(CodeGenerator *cg, Location *val, VarDecl *fieldDecl) {
@@ -890,10 +840,6 @@ Location *FieldAccess::EmitMemLocStore(CodeGenerator *cg, Location *val, VarDecl
     return This;
 }
 
-int FieldAccess::GetMemBytesMemLocStore(VarDecl *fieldDecl) {
-    return 0;
-}
-
 Location *FieldAccess::EmitMemLoc(CodeGenerator *cg, VarDecl *fieldDecl) {
     Location *loc = fieldDecl->GetMemLoc();
     if (loc != nullptr)
@@ -908,15 +854,17 @@ Location *FieldAccess::EmitMemLoc(CodeGenerator *cg, VarDecl *fieldDecl) {
 }
 
 
-Call::Call(yyltype loc, Expr *b, Identifier *f, List<Expr*> *a) : Expr(loc)  {
+Call::Call(SourceRange loc, Expr *b, Identifier *f, List<Expr*> *a) : Expr(CallNode, loc)  {
     Assert(f != NULL && a != NULL); // b can be be NULL (just means no explicit base)
     base = b;
     if (base) base->SetParent(this);
     (field=f)->SetParent(this);
     (actuals=a)->SetParentAll(this);
+    decl = NULL;
+    declResolved = false;
 }
  
-Type* Call::GetType() {
+Type* Call::ComputeType() {
     if (IsArrayLengthCall())
         return Type::intType;
 
@@ -951,17 +899,17 @@ void Call::Check() {
         }
     } else {
         FieldAccess* fd;
-        if((fd=dynamic_cast<FieldAccess*>(base))!= nullptr) {
-            Decl* tempDecl = GetFieldDecl(fd->GetIdentifier(),this->GetNode());
-            VarDecl* cd = dynamic_cast<VarDecl*>(tempDecl);
+        if((fd=dyn_cast<FieldAccess>(base))!= nullptr) {
+            Decl* tempDecl = fd->GetIdentifier()->GetDecl();
+            VarDecl* cd = dyn_cast<VarDecl>(tempDecl);
             if(tempDecl!= nullptr) return;
         }
 
         t = base->GetType();
         if((d=GetFieldDecl(field,t))==NULL) {
             CheckActuals(d);
-            if(dynamic_cast<ArrayType*>(t)==NULL||
-            strcmp("length",field->Name())!=0)
+            if(!isa<ArrayType>(t)||
+            strcmp(field->Name(), "length") != 0)
                 ReportError::FieldNotFoundInBase(field,t);
             return;
         }
@@ -974,7 +922,7 @@ void Call::CheckActuals(Decl *d)
     for (int i=0,n=actuals->NumElements();i<n;++i)
             actuals->Nth(i)->Check();
 
-    FnDecl* fnDecl = dynamic_cast<FnDecl*>(d);
+    FnDecl* fnDecl = dyn_cast<FnDecl>(d);
     if(fnDecl==NULL) return;
     int expectNumVars = fnDecl->GetFormals()->NumElements();
     int acutalNumVars = actuals->NumElements();
@@ -991,14 +939,15 @@ void Call::CheckActuals(Decl *d)
     }
 }
 
-void Call::BuildScope() {
-
-
+void Call::Resolve(Resolver *r) {
+    Expr::Resolve(r);
     if (base != NULL)
-        base->BuildScope();
+        base->Resolve(r);
 
-    for (int i = 0, n = actuals->NumElements(); i < n; ++i)
-        actuals->Nth(i)->BuildScope();
+    for (Expr *e : *actuals)
+        e->Resolve(r);
+
+    field->SetDecl(r->Lookup(field));
 }
 
 Location* Call::Emit(CodeGenerator *cg) {
@@ -1008,21 +957,15 @@ Location* Call::Emit(CodeGenerator *cg) {
     return EmitLabel(cg);
 }
 
-int Call::GetMemBytes() {
-    if (IsArrayLengthCall())
-        return GetMemBytesArrayLength();
-
-    return GetMemBytesLabel();
-}
-
 Location* Call::EmitLabel(CodeGenerator *cg) {
-    List<Location*> *params = new List<Location*>;
-    for (int i = 0, n = actuals->NumElements(); i < n; ++i)
-        params->Append(actuals->Nth(i)->Emit(cg));
+    List<Location*> params;
+    params.Reserve(actuals->NumElements());
+    for (Expr *e : *actuals)
+        params.Append(e->Emit(cg));
 
-    int n = params->NumElements();
+    int n = params.NumElements();
     for (int i = n-1; i >= 0; --i)
-        cg->GenPushParam(params->Nth(i));
+        cg->GenPushParam(params.Nth(i));
 
     Location *ret;
     if (!IsMethodCall()) {
@@ -1046,32 +989,10 @@ Location* Call::EmitLabel(CodeGenerator *cg) {
     return ret;
 }
 
-int Call::GetMemBytesLabel() {
-    int memBytes = 0;
-    for (int i = 0, n = actuals->NumElements(); i < n; ++i)
-        memBytes += actuals->Nth(i)->GetMemBytes();
-
-    if (IsMethodCall()) {
-        if (base != NULL)
-            memBytes += base->GetMemBytes();
-
-        memBytes += GetMemBytesDynamicDispatch();
-    }
-
-    if (GetDecl()->HasReturnVal())
-        memBytes += CodeGenerator::VarSize;
-
-    return memBytes;
-}
-
 Location* Call::EmitArrayLength(CodeGenerator *cg) {
     return cg->GenLoad(base->Emit(cg));
 }
 
-int Call::GetMemBytesArrayLength() {
-    return base->GetMemBytes() + CodeGenerator::VarSize;
-}
-
 Location* Call::EmitDynamicDispatch(CodeGenerator *cg, Location *b) {
     Location *vtable = cg->GenLoad(b);
     int methodOffset = GetDecl()->GetVTblOffset();
@@ -1079,23 +1000,22 @@ Location* Call::EmitDynamicDispatch(CodeGenerator *cg, Location *b) {
     return cg->GenACall(faddr, GetDecl()->HasReturnVal());
 }
 
-int Call::GetMemBytesDynamicDispatch() {
-    return 2 * CodeGenerator::VarSize;
-}
-
 FnDecl* Call::GetDecl() {
-    Decl *d = GetFieldDecl(field, base);
-    return dynamic_cast<FnDecl*>(d);
+    if (!declResolved) {
+        decl = GetFieldDecl(field, base);
+        declResolved = true;
+    }
+    return dyn_cast<FnDecl>(decl);
 }
 
 bool Call::IsArrayLengthCall() {
     if (base == NULL)
         return false;
 
-    if (dynamic_cast<ArrayType*>(base->GetType()) == NULL)
+    if (!isa<ArrayType>(base->GetType()))
         return false;
 
-    if (strcmp("length", field->GetName()) != 0)
+    if (strcmp(field->GetName(), "length") != 0)
         return false;
 
     return true;
@@ -1109,29 +1029,26 @@ bool Call::IsMethodCall() {
     if (c == NULL)
         return false;
 
-    FnDecl *f = dynamic_cast<FnDecl*>(GetFieldDeclInOneNode(field, c->GetType()));
+    FnDecl *f = dyn_cast<FnDecl>(GetFieldDeclInOneNode(field, c->GetType()));
     if (f == NULL)
         return false;
 
     return true;
 }
 
-int Call::GetMemBytesActuals() {
-    int memBytes = 0;
-    for(int i = 0, n = actuals->NumElements(); i < n; i++)
-        memBytes += actuals->Nth(i)->GetMemBytes();
-    return memBytes;
-}
-
-
-NewExpr::NewExpr(yyltype loc, NamedType *c) : Expr(loc) {
+NewExpr::NewExpr(SourceRange loc, NamedType *c) : Expr(NewExprNode, loc) {
   Assert(c != NULL);
   (cType=c)->SetParent(this);
 }
 
-Type *NewExpr::GetType() {
-    Decl *d = Program::gScope->table->Lookup(cType->Name());
-    ClassDecl *c = dynamic_cast<ClassDecl*>(d);
+void NewExpr::Resolve(Resolver *r) {
+    Expr::Resolve(r);
+    r->Use(cType->GetTypeDecl());  // its code needs the class's size and vtable
+}
+
+Type *NewExpr::ComputeType() {
+    Decl *d = cType->GetTypeDecl();
+    ClassDecl *c = dyn_cast<ClassDecl>(d);
 
     if (c == NULL)
         return Type::errorType;
@@ -1141,28 +1058,28 @@ Type *NewExpr::GetType() {
 
 void NewExpr::Check() {
     //class definition must be in gscope
-    Decl *d = Program::gScope->table->Lookup(cType->Name());
-    ClassDecl *c = dynamic_cast<ClassDecl*>(d);
+    Decl *d = cType->GetTypeDecl();
+    ClassDecl *c = dyn_cast<ClassDecl>(d);
 
     if (c == NULL)
         ReportError::IdentifierNotDeclared(cType->GetId(), LookingForClass);
 }
 
 
-NewArrayExpr::NewArrayExpr(yyltype loc, Expr *sz, Type *et) : Expr(loc) {
+NewArrayExpr::NewArrayExpr(SourceRange loc, Expr *sz, Type *et) : Expr(NewArrayExprNode, loc) {
     Assert(sz != NULL && et != NULL);
     (size=sz)->SetParent(this); 
     (elemType=et)->SetParent(this);
+    arrayType = Compilation::Current()->types->ArrayOf(et);
 }
 
-Type *NewArrayExpr::GetType() {
-    return new ArrayType(elemType);
+Type *NewArrayExpr::ComputeType() {
+    return arrayType;
 }
 
-void NewArrayExpr::BuildScope() {
-
-
-    size->BuildScope();
+void NewArrayExpr::Resolve(Resolver *r) {
+    Expr::Resolve(r);
+    size->Resolve(r);
 }
 
 void NewArrayExpr::Check() {
@@ -1174,15 +1091,15 @@ void NewArrayExpr::Check() {
     if (elemType->IsPrimitive() && !elemType->IsEquivalentTo(Type::voidType))
         return;
 
-    Decl *d = Program::gScope->table->Lookup(elemType->Name());
-    if (dynamic_cast<ClassDecl*>(d) == NULL)
+    Decl *d = Program::GlobalScope()->table->Lookup(elemType->Name());
+    if (!isa<ClassDecl>(d))
         elemType->ReportNotDeclaredIdentifier(LookingForType);
 }
 
 Location* NewExpr::Emit(CodeGenerator *cg) {
     const char *name = cType->GetName();
     
-    Decl *d = Program::gScope->table->Lookup(name);
+    Decl *d = cType->GetTypeDecl();
     Assert(d != NULL);
 
     Location *s = cg->GenLoadConstant(d->GetMemBytes());
@@ -1194,11 +1111,6 @@ Location* NewExpr::Emit(CodeGenerator *cg) {
     return mem;
 }
 
-int NewExpr::GetMemBytes() {
-    return 5 * CodeGenerator::VarSize;
-}
-
-
 Location* NewArrayExpr::Emit(CodeGenerator *cg) {
     Location *s = size->Emit(cg);
     Location *c = cg->GenLoadConstant(CodeGenerator::VarSize);
@@ -1212,11 +1124,6 @@ Location* NewArrayExpr::Emit(CodeGenerator *cg) {
     return mem;
 }
 
-int NewArrayExpr::GetMemBytes() {
-    return size->GetMemBytes() + 4 * CodeGenerator::VarSize +
-           GetMemBytesRuntimeSizeCheck();
-}
-
 Location* NewArrayExpr::EmitRuntimeSizeCheck(CodeGenerator *cg, Location *siz) {
     Location *zro = cg->GenLoadConstant(0);
 
@@ -1233,32 +1140,108 @@ Location* NewArrayExpr::EmitRuntimeSizeCheck(CodeGenerator *cg, Location *siz) {
     return NULL;
 }
 
-int NewArrayExpr::GetMemBytesRuntimeSizeCheck() {
-    return 5 * CodeGenerator::VarSize;
-}
-
-
-Type *ReadIntegerExpr::GetType() {
+Type *ReadIntegerExpr::ComputeType() {
     return Type::intType;
 }
 Location* ReadIntegerExpr::Emit(CodeGenerator *cg) {
     return cg->GenBuiltInCall(ReadInteger);
 }
 
-int ReadIntegerExpr::GetMemBytes() {
-    return CodeGenerator::VarSize;
-}
-
 Location* ReadLineExpr::Emit(CodeGenerator *cg) {
     return cg->GenBuiltInCall(ReadLine);
 }
 
-int ReadLineExpr::GetMemBytes() {
-    return CodeGenerator::VarSize;
+Type *ReadLineExpr::ComputeType() {
+    return Type::stringType;
 }
 
+int EmptyExpr::Write(AstWriter *out) {
+    return out->AddNode(EmptyExprNode, NULL, NULL, 0);
+}
 
+int IntConstant::Write(AstWriter *out) {
+    return out->AddNode(IntConstantNode, &location, NULL, 0, (uint32_t)value);
+}
 
-Type *ReadLineExpr::GetType() {
-    return Type::stringType;
+int DoubleConstant::Write(AstWriter *out) {
+    return out->AddNode(DoubleConstantNode, &location, NULL, 0,
+                        AstWriter::Bits(value));
+}
+
+int BoolConstant::Write(AstWriter *out) {
+    return out->AddNode(BoolConstantNode, &location, NULL, 0, value);
+}
+
+int StringConstant::Write(AstWriter *out) {
+    return out->AddNode(StringConstantNode, &location, NULL, 0,
+                        out->Symbol(value));
+}
+
+int NullConstant::Write(AstWriter *out) {
+    return out->AddNode(NullConstantNode, &location, NULL, 0);
+}
+
+int Operator::Write(AstWriter *out) {
+    return out->AddNode(OperatorNode, &location, NULL, 0,
+                        out->Symbol(tokenString));
+}
+
+/* Method: Write
+ * -------------
+ * Writes a chain of operations down the left operands from the bottom
+ * up, like Check, so the nodes come out in the order recursing would
+ * have written them.
+ */
+int CompoundExpr::Write(AstWriter *out) {
+    vector<CompoundExpr*> above;
+    CompoundExpr *c = this;
+    for (CompoundExpr *l; (l = dyn_cast<CompoundExpr>(c->left)) != NULL; c = l)
+        above.push_back(c);
+
+    int index = out->Add(c->left);
+    for (;;) {
+        int kids[] = { index, out->Add(c->op), out->Add(c->right) };
+        index = out->AddNode(c->GetKind(), NULL, kids, 3);
+        if (above.empty())
+            return index;
+        c = above.back();
+        above.pop_back();
+    }
+}
+
+int This::Write(AstWriter *out) {
+    return out->AddNode(ThisNode, &location, NULL, 0);
+}
+
+int ArrayAccess::Write(AstWriter *out) {
+    int kids[] = { out->Add(base), out->Add(subscript) };
+    return out->AddNode(ArrayAccessNode, &location, kids, 2);
+}
+
+int FieldAccess::Write(AstWriter *out) {
+    int kids[] = { out->Add(base), out->Add(field) };
+    return out->AddNode(FieldAccessNode, NULL, kids, 2);
+}
+
+int Call::Write(AstWriter *out) {
+    int kids[] = { out->Add(base), out->Add(field), out->AddList(actuals) };
+    return out->AddNode(CallNode, &location, kids, 3);
+}
+
+int NewExpr::Write(AstWriter *out) {
+    int kids[] = { out->Add(cType) };
+    return out->AddNode(NewExprNode, &location, kids, 1);
+}
+
+int NewArrayExpr::Write(AstWriter *out) {
+    int kids[] = { out->Add(size), out->Add(elemType) };
+    return out->AddNode(NewArrayExprNode, &location, kids, 2);
+}
+
+int ReadIntegerExpr::Write(AstWriter *out) {
+    return out->AddNode(ReadIntegerExprNode, &location, NULL, 0);
+}
+
+int ReadLineExpr::Write(AstWriter *out) {
+    return out->AddNode(ReadLineExprNode, &location, NULL, 0);
 }
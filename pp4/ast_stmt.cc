@@ -7,8 +7,18 @@
 #include "ast_decl.h"
 #include "ast_expr.h"
 #include "errors.h"
-Scope *Program::gScope = new Scope;
-stack<const char*> *Program::gBreakLabels = new stack<const char*>;
+#include "compilation.h"
+#include "astfile.h"
+#include "ast_visitor.h"
+#include "utility.h"
+#include "workstack.h"
+#include <sstream>
+
+Scope::Scope() : table(new Hashtable<Decl*>), classDecl(NULL), loopStmt(NULL),
+                 fnDecl(NULL) {
+    if (Compilation *c = Compilation::Current())
+        c->stats.scopes++;
+}
 
 int Scope::AddDecl(Decl *d) {
     Decl* lookup = table->Lookup(d->GetName());
@@ -29,10 +39,54 @@ ostream& operator<<(ostream& out,Scope* s) {
     return out;
 }
 
-Program::Program(List<Decl*> *d):codeGenerator(new CodeGenerator) {
+void Resolver::PushScope(Scope *s) {
+    scopeStarts.push_back(pushed.size());
+    Iterator<Decl*> iter = s->table->GetIterator();
+    for (Decl *d; (d = iter.GetNextValue()) != NULL; ) {
+        vector<Decl*> *stack = &bindings[d->GetName()];
+        stack->push_back(d);
+        pushed.push_back(stack);
+    }
+}
+
+void Resolver::PopScope() {
+    for (size_t start = scopeStarts.back(); pushed.size() > start; ) {
+        pushed.back()->pop_back();
+        pushed.pop_back();
+    }
+    scopeStarts.pop_back();
+}
+
+Decl *Resolver::Lookup(Identifier *id) {
+    auto found = bindings.find(id->GetName());
+    if (found == bindings.end() || found->second.empty())
+        return NULL;
+    Decl *d = found->second.back();
+    Use(d);
+    return d;
+}
+
+void Resolver::Use(Decl *d) {
+    if (!recordUses || fnDecl == NULL || d == NULL)
+        return;
+    Node *parent = d->GetParent();
+    if (isa<ClassDecl>(parent) || isa<InterfaceDecl>(parent))
+        d = cast<Decl>(parent);
+    else if (!isa<Program>(parent))
+        return;              // a formal or local variable
+    if (used.insert(d).second)
+        fnDecl->GetUses()->Append(d);
+}
+
+Program::Program(List<Decl*> *d) : Node(ProgramNode) {
     Assert(d != NULL);
     (decls=d)->SetParentAll(this);
-    scope = gScope;
+    scope = GlobalScope();
+    Compilation::Current()->EndParse(); // the tree is complete
+}
+
+Scope *Program::GlobalScope() {
+    return Compilation::Current()->globalScope;
 }
 
 void Program::Check() {
@@ -43,284 +97,499 @@ void Program::Check() {
      *      checking itself, which makes for a great use of inheritance
      *      and polymorphism in the node classes.
      */
+    PhaseTimer timer(CheckPhase);
     BuildScope();
-    for (int i=0,n=decls->NumElements();i<n;++i)
-    {
+    Resolve();
+    /* The checks of the top-level declarations only read the global
+     * scope and the other declarations, so they can run side by side.
+     */
+    Compilation::Current()->RunInParallel(decls->NumElements(), [this](int i) {
         decls->Nth(i)->Check();
-    }
+    });
 }
 
 void Program::BuildScope() {
-    for(int i=0, n=decls->NumElements();i<n;++i) {
-        gScope->AddDecl(decls->Nth(i));
+    for (Decl *d : *decls)
+        scope->AddDecl(d);
+    Compilation::Current()->types->BindNames(scope);
+    for (Decl *d : *decls)
+        d->BuildScope();
+}
+
+/* Method: Resolve
+ * ---------------
+ * Walks the tree once, keeping the bindings of the enclosing scopes in
+ * the Resolver, and binds every identifier use to the declaration it
+ * names. Each statement also records its enclosing class, function and
+ * loop, so the later passes never have to search up through the parent
+ * links. Nothing is reported here; the checks that follow interpret the
+ * bindings (including missing ones) and report errors in tree order.
+ */
+void Program::Resolve() {
+    Resolver r(Compilation::Current()->cache != NULL);
+    r.PushScope(scope);
+    for (Decl *d : *decls)
+        d->Resolve(&r);
+}
+
+static void DescribeSignature(FnDecl *fn, ostream &out) {
+    out << fn->GetLabel() << ' ' << fn->GetReturnType() << '(';
+    List<VarDecl*> *formals = fn->GetFormals();
+    for (VarDecl *v : *formals)
+        out << v->GetType() << ',';
+    out << ")\n";
+}
+
+/* Class: DependencyDescriber
+ * ---------------------------
+ * Describes what the code for a function can depend on besides its own
+ * text: its class, if it is a method, and what it names outside itself
+ * (see FnDecl::GetUses), then the classes of the types those mention,
+ * and so on. A global is described with its type and offset, a function
+ * with its signature, and a class with its fields and vtable. A function
+ * whose text is unchanged but whose description has changed is not taken
+ * from the code cache; declarations it doesn't reach may come and go.
+ */
+class DependencyDescriber : public Visitor<DependencyDescriber> {
+  private:
+    ostream &out;
+    vector<Decl*> pending;
+    unordered_set<Decl*> seen;
+
+    void Add(Decl *d) {
+        if (d != NULL && seen.insert(d).second)
+            pending.push_back(d);
     }
-    for(int i=0, n=decls->NumElements();i<n;++i) {
-        decls->Nth(i)->BuildScope();
+
+    void AddClassOf(Type *t) {
+        while (ArrayType *a = dyn_cast<ArrayType>(t))
+            t = a->GetElemType();
+        if (NamedType *n = dyn_cast<NamedType>(t))
+            Add(n->GetTypeDecl());
+    }
+
+  public:
+    DependencyDescriber(ostream &o) : out(o) {}
+
+    void Describe(FnDecl *fn) {
+        if (ClassDecl *c = dyn_cast<ClassDecl>(fn->GetParent()))
+            Add(c);
+        for (Decl *d : *fn->GetUses())
+            Add(d);
+        for (size_t i = 0; i < pending.size(); ++i)
+            Visit(pending[i]);
+    }
+
+    void VisitVarDecl(VarDecl *v) {
+        out << "var " << v->GetName() << ' ' << v->GetType() << ' '
+            << v->GetMemLoc()->GetOffset() << '\n';
+        AddClassOf(v->GetType());
+    }
+
+    void VisitFnDecl(FnDecl *fn) {
+        out << "fn ";
+        DescribeSignature(fn, out);
+        AddClassOf(fn->GetReturnType());
+    }
+
+    void VisitClassDecl(ClassDecl *c) {
+        out << "class " << c->GetName();
+        if (c->GetExtends() != NULL)
+            out << " extends " << c->GetExtends();
+        List<NamedType*> *implements = c->GetImplements();
+        for (int j = 0, m = implements->NumElements(); j < m; ++j)
+            out << (j == 0 ? " implements " : ",") << implements->Nth(j);
+        out << '\n';
+        ClassLayout *layout = c->GetLayout();
+        for (size_t j = 0; j < layout->fields.size(); ++j) {
+            out << "field " << layout->fields[j]->GetName() << ' '
+                << layout->fields[j]->GetType() << ' '
+                << layout->fields[j]->GetMemOffset() << '\n';
+            AddClassOf(layout->fields[j]->GetType());
+        }
+        for (size_t j = 0; j < layout->vtable.size(); ++j) {
+            out << "method ";
+            DescribeSignature(layout->vtable[j], out);
+            AddClassOf(layout->vtable[j]->GetReturnType());
+        }
     }
-}
 
+    void VisitInterfaceDecl(InterfaceDecl *in) {
+        out << "interface " << in->GetName() << '\n';
+        for (Decl *m : *in->GetMembers()) {
+            FnDecl *fn = cast<FnDecl>(m);
+            out << "prototype ";
+            DescribeSignature(fn, out);
+            AddClassOf(fn->GetReturnType());
+        }
+    }
+};
+
+/* Method: Emit
+ * ------------
+ * After laying out the globals and classes, the code is generated in
+ * parts: the built-in functions, then each function and method and each
+ * class's vtable, in declaration order. Labels and temps are numbered
+ * through the whole program, but each part is generated numbering its
+ * own from 0, so the parts can be generated side by side; once all are
+ * done, each is renumbered on from the parts before it.
+ * With a code cache, the functions found there are not generated at
+ * all: the entry says how many labels and temps they use.
+ */
 void Program::Emit() {
+    PhaseTimer timer(EmitPhase);
     int offset = CodeGenerator::OffsetToFirstGlobal;
 
-    for(int i=0,n=decls->NumElements();i<n;++i) {
-        VarDecl *d = dynamic_cast<VarDecl*>(decls->Nth(i));
+    for (Decl *decl : *decls) {
+        VarDecl *d = dyn_cast<VarDecl>(decl);
         if(d== nullptr)
             continue;
         Location *loc = new Location(gpRelative,offset,d->GetName());
         d->SetMemLoc(loc);
         offset+=d->GetMemBytes();
     }
-    for (int i = 0, n = decls->NumElements(); i < n; ++i)
-        decls->Nth(i)->PreEmit();
+    for (Decl *d : *decls)
+        d->PreEmit();
+
+    vector<Decl*> units; // functions, and classes for their vtables
+    for (Decl *d : *decls) {
+        ClassDecl *c = dyn_cast<ClassDecl>(d);
+        if (c != NULL) {
+            for (Decl *m : *c->GetMembers())
+                if (isa<FnDecl>(m))
+                    units.push_back(m);
+        }
+        if (c != NULL || isa<FnDecl>(d))
+            units.push_back(d);
+    }
 
-    for (int i = 0, n = decls->NumElements(); i < n; ++i)
-        decls->Nth(i)->Emit(codeGenerator);
+    int n = units.size();
+    Compilation *c = Compilation::Current();
+    vector<string> keys(n);          // for the functions, with a cache
+    vector<CachedCode*> cached(n);
+    if (c->cache != NULL && !IsDebugOn("tac")) { // the cache holds assembly
+        c->RunInParallel(n, [&](int i) {
+            FnDecl *fn = dyn_cast<FnDecl>(units[i]);
+            if (fn == NULL)
+                return;
+            ostringstream deps;
+            DependencyDescriber(deps).Describe(fn);
+            Hasher h;
+            h.Add(deps.str());
+            keys[i] = c->cache->KeyFor(h.Digest(), fn->GetLabel(),
+                                       fn->GetSourceText(), c->tacComments);
+            cached[i] = c->cache->Lookup(keys[i]);
+        });
+    }
 
-    codeGenerator->DoFinalCodeGen();
+    vector<CodeGenerator*> parts(n + 1);
+    parts[0] = new CodeGenerator;
+    parts[0]->GenBuiltIns();
+    c->RunInParallel(n, [&](int i) {
+        parts[i + 1] = new CodeGenerator;
+        if (cached[i] != NULL) {
+            parts[i + 1]->UseCachedCode(cached[i]);
+            return;
+        }
+        if (!keys[i].empty())
+            parts[i + 1]->StoreInCache(keys[i]);
+        units[i]->Emit(parts[i + 1]);
+    });
+
+    vector<int> labelNum(n + 1), tempNum(n + 1);
+    for (int i = 0; i < n; i++) {
+        labelNum[i + 1] = labelNum[i] + parts[i + 1]->NumLabels();
+        tempNum[i + 1] = tempNum[i] + parts[i + 1]->NumTemps();
+    }
+    c->RunInParallel(n, [&](int i) {
+        parts[i + 1]->NumberFrom(labelNum[i], tempNum[i]);
+    });
+
+    timer.Stop();
+    CodeGenerator::DoFinalCodeGen(parts);
+
+    if (c->cache != NULL) {
+        int hits = 0, misses = 0;
+        for (int i = 0; i < n; i++) {
+            hits += (cached[i] != NULL);
+            misses += (cached[i] == NULL && !keys[i].empty());
+        }
+        PrintDebug("stats", "cache: %d hits, %d misses", hits, misses);
+    }
+    for (CachedCode *entry : cached)
+        delete entry;
 }
 
 void Stmt::BuildScope() {
 
 }
 
-StmtBlock::StmtBlock(List<VarDecl*> *d, List<Stmt*> *s) {
+void Stmt::Resolve(Resolver *r) {
+    classDecl = r->classDecl;
+    fnDecl = r->fnDecl;
+    loopStmt = r->loopStmt;
+}
+
+StmtBlock::StmtBlock(List<VarDecl*> *d, List<Stmt*> *s) : Stmt(StmtBlockNode) {
     Assert(d != NULL && s != NULL);
     (decls=d)->SetParentAll(this);
     (stmts=s)->SetParentAll(this);
 }
 
+/* A block or a conditional statement is where a pass over a function
+ * body would recurse into nested statements, so it does the pass as a
+ * walk, with itself as the first step (see Stmt::CheckStep).
+ */
 void StmtBlock::BuildScope() {
+    WorkStack w;
+    w.Run([&] { BuildScopeStep(&w); });
+}
 
-    for (int i = 0, n = decls->NumElements(); i < n; ++i)
-        scope->AddDecl(decls->Nth(i));
-
-    for (int i=0,n=decls->NumElements();i<n;++i) {
-        decls->Nth(i)->BuildScope();
-    }
-    for (int i=0,n=stmts->NumElements();i<n;++i) {
-        stmts->Nth(i)->BuildScope();
-    }
+void StmtBlock::Resolve(Resolver *r) {
+    WorkStack w;
+    w.Run([&] { ResolveStep(r, &w); });
 }
 
 void StmtBlock::Check() {
-    for (int i=0,n=decls->NumElements();i<n;++i) {
-        decls->Nth(i)->Check();
-    }
-    for (int i=0,n=stmts->NumElements();i<n;++i) {
-        stmts->Nth(i)->Check();
-    }
+    WorkStack w;
+    w.Run([&] { CheckStep(&w); });
 }
 
 Location *StmtBlock::Emit(CodeGenerator *cg) {
-    for (int i = 0, n = decls->NumElements(); i < n; ++i) {
-        VarDecl *d = dynamic_cast<VarDecl*>(decls->Nth(i));
-        if (d == NULL)
-            continue;
-        Location *loc = cg->GenLocalVar(d->GetName(), d->GetMemBytes());
-        d->SetMemLoc(loc);
-    }
+    WorkStack w;
+    w.Run([&] { EmitStep(cg, &w); });
+    return NULL;
+}
 
-    for (int i = 0, n = stmts->NumElements(); i < n; ++i)
-        stmts->Nth(i)->Emit(cg);
+void StmtBlock::BuildScopeStep(WorkStack *w) {
 
-    return NULL;
+    for (VarDecl *d : *decls)
+        scope->AddDecl(d);
+
+    for (VarDecl *d : *decls)
+        d->BuildScope();
+    for (Stmt *s : *stmts)
+        w->Then([=] { s->BuildScopeStep(w); });
+}
+
+void StmtBlock::ResolveStep(Resolver *r, WorkStack *w) {
+    Stmt::Resolve(r);
+    r->PushScope(scope);
+    for (VarDecl *d : *decls)
+        d->Resolve(r);
+    for (Stmt *s : *stmts)
+        w->Then([=] { s->ResolveStep(r, w); });
+    w->Then([=] { r->PopScope(); });
 }
 
-int StmtBlock::GetMemBytes() {
-    int memBytes = 0;
-    for (int i=0,n=decls->NumElements();i<n;++i)
-        memBytes +=decls->Nth(i)->GetMemBytes();
-    for (int i=0,n=stmts->NumElements();i<n;++i)
-        memBytes +=stmts->Nth(i)->GetMemBytes();
-    return memBytes;
+void StmtBlock::CheckStep(WorkStack *w) {
+    for (VarDecl *d : *decls)
+        d->Check();
+    for (Stmt *s : *stmts)
+        w->Then([=] { s->CheckStep(w); });
 }
 
-ConditionalStmt::ConditionalStmt(Expr *t, Stmt *b) { 
+void StmtBlock::EmitStep(CodeGenerator *cg, WorkStack *w) {
+    for (VarDecl *d : *decls) {
+        Location *loc = cg->GenLocalVar(d->GetName(), d->GetMemBytes());
+        d->SetMemLoc(loc);
+    }
+
+    for (Stmt *s : *stmts)
+        w->Then([=] { s->EmitStep(cg, w); });
+}
+
+ConditionalStmt::ConditionalStmt(NodeKind k, Expr *t, Stmt *b) : Stmt(k) { 
     Assert(t != NULL && b != NULL);
     (test=t)->SetParent(this); 
     (body=b)->SetParent(this);
 }
 
 void ConditionalStmt::BuildScope() {
+    WorkStack w;
+    w.Run([&] { BuildScopeStep(&w); });
+}
 
-
-    test->BuildScope();
-    body->BuildScope();
+void ConditionalStmt::Resolve(Resolver *r) {
+    WorkStack w;
+    w.Run([&] { ResolveStep(r, &w); });
 }
 
 void ConditionalStmt::Check() {
+    WorkStack w;
+    w.Run([&] { CheckStep(&w); });
+}
+
+Location *ConditionalStmt::Emit(CodeGenerator *cg) {
+    WorkStack w;
+    w.Run([&] { EmitStep(cg, &w); });
+    return NULL;
+}
+
+void ConditionalStmt::BuildScopeStep(WorkStack *w) {
+    w->Then([=] { body->BuildScopeStep(w); });
+}
+
+void ConditionalStmt::ResolveStep(Resolver *r, WorkStack *w) {
+    Stmt::Resolve(r);
+    test->Resolve(r);
+    w->Then([=] { body->ResolveStep(r, w); });
+}
+
+void ConditionalStmt::CheckStep(WorkStack *w) {
     test->Check();
-    body->Check();
-    if(!test->GetType()->IsEquivalentTo(Type::boolType)) {
-        ReportError::TestNotBoolean(test);
-    }
+    w->Then([=] { body->CheckStep(w); });
+    w->Then([=] {
+        if(!test->GetType()->IsEquivalentTo(Type::boolType)) {
+            ReportError::TestNotBoolean(test);
+        }
+    });
 }
 
-void LoopStmt::BuildScope() {
+void LoopStmt::BuildScopeStep(WorkStack *w) {
 
-    ConditionalStmt::BuildScope();
+    ConditionalStmt::BuildScopeStep(w);
     scope->SetLoopStmt((this));
 }
 
-ForStmt::ForStmt(Expr *i, Expr *t, Expr *s, Stmt *b): LoopStmt(t, b) { 
+void LoopStmt::ResolveStep(Resolver *r, WorkStack *w) {
+    Stmt::Resolve(r);
+
+    LoopStmt *outer = r->loopStmt;
+    r->loopStmt = this;
+    test->Resolve(r);
+    w->Then([=] { body->ResolveStep(r, w); });
+    w->Then([=] { r->loopStmt = outer; });
+}
+
+ForStmt::ForStmt(Expr *i, Expr *t, Expr *s, Stmt *b): LoopStmt(ForStmtNode, t, b) { 
     Assert(i != NULL && t != NULL && s != NULL && b != NULL);
     (init=i)->SetParent(this);
     (step=s)->SetParent(this);
 }
 
-void ForStmt::BuildScope() {
-
-    LoopStmt::BuildScope();
+void ForStmt::ResolveStep(Resolver *r, WorkStack *w) {
+    LoopStmt::ResolveStep(r, w);
 
-    init->BuildScope();
-    step->BuildScope();
+    w->Then([=] {
+        LoopStmt *outer = r->loopStmt;
+        r->loopStmt = this;
+        init->Resolve(r);
+        step->Resolve(r);
+        r->loopStmt = outer;
+    });
 }
 
-Location *ForStmt::Emit(CodeGenerator *cg) {
+void ForStmt::EmitStep(CodeGenerator *cg, WorkStack *w) {
     const char* top = cg->NewLabel();
     const char* bot = cg->NewLabel();
 
-    Program::gBreakLabels->push(bot);
+    cg->PushBreakLabel(bot);
     init->Emit(cg);
     cg->GenLabel(top);
     Location *t = test->Emit(cg);
     cg->GenIfZ(t,bot);
-    body->Emit(cg);
-    step->Emit(cg);
-    cg->GenGoto(top);
-    cg->GenLabel(bot);
-    Program::gBreakLabels->pop();
-    return NULL;
-}
-
-int ForStmt::GetMemBytes() {
-    return init->GetMemBytes()+test->GetMemBytes()
-    +body->GetMemBytes()+step->GetMemBytes();
-}
-
-void WhileStmt::BuildScope() {
-    LoopStmt::BuildScope();
+    w->Then([=] { body->EmitStep(cg, w); });
+    w->Then([=] {
+        step->Emit(cg);
+        cg->GenGoto(top);
+        cg->GenLabel(bot);
+        cg->PopBreakLabel();
+    });
 }
 
-Location *WhileStmt::Emit(CodeGenerator *cg) {
+void WhileStmt::EmitStep(CodeGenerator *cg, WorkStack *w) {
     const char* top = cg->NewLabel();
     const char* bot = cg->NewLabel();
 
-    Program::gBreakLabels->push(bot);
+    cg->PushBreakLabel(bot);
 
     cg->GenLabel(top);
     Location *t = test->Emit(cg);
     cg->GenIfZ(t, bot);
-    body->Emit(cg);
-    cg->GenGoto(top);
-    cg->GenLabel(bot);
-
-    Program::gBreakLabels->pop();
-
-    return nullptr;
-}
+    w->Then([=] { body->EmitStep(cg, w); });
+    w->Then([=] {
+        cg->GenGoto(top);
+        cg->GenLabel(bot);
 
-int WhileStmt::GetMemBytes() {
-    return test->GetMemBytes() + body->GetMemBytes();
+        cg->PopBreakLabel();
+    });
 }
 
+void IfStmt::BuildScopeStep(WorkStack *w) {
+    ConditionalStmt::BuildScopeStep(w);
 
-void IfStmt::BuildScope() {
-
-
-    test->BuildScope();
-    body->BuildScope();
+    if(elseBody!=NULL)
+        w->Then([=] { elseBody->BuildScopeStep(w); });
+}
 
+void IfStmt::ResolveStep(Resolver *r, WorkStack *w) {
+    ConditionalStmt::ResolveStep(r, w);
     if(elseBody!=NULL)
-        elseBody->BuildScope();
+        w->Then([=] { elseBody->ResolveStep(r, w); });
 }
 
-void IfStmt::Check() {
-    test->Check();
-    body->Check();
-    if(!test->GetType()->IsEquivalentTo(Type::boolType))
-        ReportError::TestNotBoolean(test);
+void IfStmt::CheckStep(WorkStack *w) {
+    ConditionalStmt::CheckStep(w);
     if(elseBody!=NULL)
-        elseBody->Check();
+        w->Then([=] { elseBody->CheckStep(w); });
 }
 
 
-IfStmt::IfStmt(Expr *t, Stmt *tb, Stmt *eb): ConditionalStmt(t, tb) { 
+IfStmt::IfStmt(Expr *t, Stmt *tb, Stmt *eb): ConditionalStmt(IfStmtNode, t, tb) { 
     Assert(t != NULL && tb != NULL); // else can be NULL
     elseBody = eb;
     if (elseBody) elseBody->SetParent(this);
 }
 
-Location *IfStmt::Emit(CodeGenerator *cg) {
+void IfStmt::EmitStep(CodeGenerator *cg, WorkStack *w) {
     const char* els = cg->NewLabel();
     const char* bot = cg->NewLabel();
 
     Location *t = test->Emit(cg);
     cg->GenIfZ(t,els);
-    body->Emit(cg);
-    cg->GenGoto(bot);
-    cg->GenLabel(els);
-    if (elseBody) elseBody->Emit(cg);
-    cg->GenLabel(bot);
-    return nullptr;
-
-}
-
-int IfStmt::GetMemBytes() {
-    int memBytes = test->GetMemBytes()+body->GetMemBytes();
-    if(elseBody) memBytes+=elseBody->GetMemBytes();
-    return memBytes;
+    w->Then([=] { body->EmitStep(cg, w); });
+    w->Then([=] {
+        cg->GenGoto(bot);
+        cg->GenLabel(els);
+    });
+    if (elseBody) w->Then([=] { elseBody->EmitStep(cg, w); });
+    w->Then([=] { cg->GenLabel(bot); });
 }
 
 void BreakStmt::Check() {
-    Node* n = this;
-    while(n!=NULL) {
-        if(n->GetScope()->GetLoopStmt()!=NULL) {
-            return;
-        }
-        n = n->GetParent();
-    }
-    ReportError::BreakOutsideLoop(this);
+    if(loopStmt==NULL)
+        ReportError::BreakOutsideLoop(this);
 }
 
 
 
 Location *BreakStmt::Emit(CodeGenerator *cg) {
-    cg->GenGoto(Program::gBreakLabels->top());
+    cg->GenGoto(cg->GetBreakLabel());
     return nullptr;
 }
 
-int BreakStmt::GetMemBytes() {
-    return 0;
-}
-
-ReturnStmt::ReturnStmt(yyltype loc, Expr *e) : Stmt(loc) { 
+ReturnStmt::ReturnStmt(SourceRange loc, Expr *e) : Stmt(ReturnStmtNode, loc) { 
     Assert(e != NULL);
     (expr=e)->SetParent(this);
 }
 
-void ReturnStmt::BuildScope() {
-    expr->BuildScope();
+void ReturnStmt::Resolve(Resolver *r) {
+    Stmt::Resolve(r);
+    expr->Resolve(r);
 }
 
 void ReturnStmt::Check() {
     expr->Check();
 
-    FnDecl *d = NULL;
-    Node* n = this;
-    while(n !=NULL) {
-        if((d=n->GetScope()->GetFnDecl())!=NULL) {
-            break;
-        }
-        n=n->GetParent();
-    }
+    FnDecl *d = fnDecl;
     if(d==NULL) {
         ReportError::Formatted(location,"return is only allowed inside a function");
         return;
     }
     Type *expected = d->GetReturnType();
     Type *given = expr->GetType();
-    if(given== nullptr && strcmp(expected->GetName(),"void")==0) return;
+    if(given== nullptr && expected->GetName()==Type::voidType->GetName()) return;
     if(!given->IsEquivalentTo(expected)) {
         ReportError::ReturnMismatch(this,given,expected);
     }
@@ -335,24 +604,16 @@ Location *ReturnStmt::Emit(CodeGenerator *cg) {
     return nullptr;
 }
 
-int ReturnStmt::GetMemBytes() {
-    if (expr== nullptr)
-        return 0;
-    else
-        return expr->GetMemBytes();
-}
-
-PrintStmt::PrintStmt(List<Expr*> *a) {    
+PrintStmt::PrintStmt(List<Expr*> *a) : Stmt(PrintStmtNode) {    
     Assert(a != NULL);
     (args=a)->SetParentAll(this);
 }
 
 
-void PrintStmt::BuildScope() {
-
-    for(int i=0,n=args->NumElements();i<n;++i) {
-        args->Nth(i)->BuildScope();
-    }
+void PrintStmt::Resolve(Resolver *r) {
+    Stmt::Resolve(r);
+    for (Expr *e : *args)
+        e->Resolve(r);
 }
 
 void PrintStmt::Check() {
@@ -365,21 +626,12 @@ void PrintStmt::Check() {
         }
     }
 
-    for(int i=0,n=args->NumElements();i<n;++i) {
-        args->Nth(i)->Check();
-    }
-}
-
-int PrintStmt::GetMemBytes() {
-    int memBytes = 0;
-    for (int i = 0, n = args->NumElements(); i < n; ++i)
-        memBytes += args->Nth(i)->GetMemBytes();
-    return memBytes;
+    for (Expr *e : *args)
+        e->Check();
 }
 
 Location *PrintStmt::Emit(CodeGenerator *cg) {
-    for (int i=0,n=args->NumElements();i<n;++i) {
-        Expr *e = args->Nth(i);
+    for (Expr *e : *args) {
         BuiltIn b = e->GetType()->GetPrint();
 
         Assert(b != NumBuiltIns);
@@ -388,4 +640,78 @@ Location *PrintStmt::Emit(CodeGenerator *cg) {
     return nullptr;
 }
 
+int Program::Write(AstWriter *out) {
+    int kids[] = { out->AddList(decls) };
+    return out->AddNode(ProgramNode, NULL, kids, 1);
+}
+
+void Stmt::WriteStep(AstWriter *out, WorkStack *w, int *index) {
+    *index = Write(out);
+}
+
+int StmtBlock::Write(AstWriter *out) {
+    int index;
+    WorkStack w;
+    w.Run([&] { WriteStep(out, &w, &index); });
+    return index;
+}
+
+void StmtBlock::WriteStep(AstWriter *out, WorkStack *w, int *index) {
+    int n = stmts->NumElements();
+    int *kids = out->Slots(2 + n);   // the two lists, then the statements
+    kids[0] = out->AddList(decls);
+    for (int i = 0; i < n; i++) {
+        Stmt *s = stmts->Nth(i);
+        w->Then([=] { s->WriteStep(out, w, &kids[2 + i]); });
+    }
+    w->Then([=] {
+        kids[1] = out->AddNode(ListNode, NULL, kids + 2, n);
+        *index = out->AddNode(StmtBlockNode, NULL, kids, 2);
+    });
+}
+
+int ConditionalStmt::Write(AstWriter *out) {
+    int index;
+    WorkStack w;
+    w.Run([&] { WriteStep(out, &w, &index); });
+    return index;
+}
+
+void ForStmt::WriteStep(AstWriter *out, WorkStack *w, int *index) {
+    int *kids = out->Slots(4);
+    kids[0] = out->Add(init);
+    kids[1] = out->Add(test);
+    kids[2] = out->Add(step);
+    w->Then([=] { body->WriteStep(out, w, &kids[3]); });
+    w->Then([=] { *index = out->AddNode(ForStmtNode, NULL, kids, 4); });
+}
+
+void WhileStmt::WriteStep(AstWriter *out, WorkStack *w, int *index) {
+    int *kids = out->Slots(2);
+    kids[0] = out->Add(test);
+    w->Then([=] { body->WriteStep(out, w, &kids[1]); });
+    w->Then([=] { *index = out->AddNode(WhileStmtNode, NULL, kids, 2); });
+}
 
+void IfStmt::WriteStep(AstWriter *out, WorkStack *w, int *index) {
+    int *kids = out->Slots(3);   // no else part is left as -1
+    kids[0] = out->Add(test);
+    w->Then([=] { body->WriteStep(out, w, &kids[1]); });
+    if (elseBody)
+        w->Then([=] { elseBody->WriteStep(out, w, &kids[2]); });
+    w->Then([=] { *index = out->AddNode(IfStmtNode, NULL, kids, 3); });
+}
+
+int BreakStmt::Write(AstWriter *out) {
+    return out->AddNode(BreakStmtNode, &location, NULL, 0);
+}
+
+int ReturnStmt::Write(AstWriter *out) {
+    int kids[] = { out->Add(expr) };
+    return out->AddNode(ReturnStmtNode, &location, kids, 1);
+}
+
+int PrintStmt::Write(AstWriter *out) {
+    int kids[] = { out->AddList(args) };
+    return out->AddNode(PrintStmtNode, NULL, kids, 1);
+}
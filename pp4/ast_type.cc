@@ -4,8 +4,12 @@
  */
 
 #include <string.h>
+#include <algorithm>
+#include <unordered_set>
 #include "include/ast_type.h"
 #include "include/ast_decl.h"
+#include "include/astfile.h"
+#include "include/compilation.h"
 
 
 /* Class constants
@@ -24,16 +28,17 @@ Type *Type::nullType   = new Type("null");
 Type *Type::stringType = new Type("string");
 Type *Type::errorType  = new Type("error"); 
 
-Type::Type(const char *n) {
+Type::Type(const char *n) : Node(BuiltInTypeNode) {
     Assert(n);
-    typeName = strdup(n);
+    typeName = n;
+    canonical = this;
 }
 
 bool Type::IsEquivalentTo(Type *other) {
     if(IsEqualTo(Type::errorType))
         return true;
 
-    if(IsEqualTo(Type::nullType)&& dynamic_cast<NamedType*>(other))
+    if(IsEqualTo(Type::nullType)&& isa<NamedType>(other))
         return true;
 
     return IsEqualTo(other);
@@ -50,74 +55,83 @@ BuiltIn Type::GetPrint() {
 }
 
 
-NamedType::NamedType(Identifier *i) : Type(*i->GetLocation()) {
+NamedType::NamedType(Identifier *i) : Type(NamedTypeNode, i->GetLocation()) {
     Assert(i != NULL);
     (id=i)->SetParent(this);
+    typeDecl = NULL;
+    interfaceNum = -1;
+    canonical = Compilation::Current()->types->Named(i);
 } 
 
-void NamedType::ReportNotDeclaredIdentifier(reasonT reason) {
-    ReportError::IdentifierNotDeclared(id,reason);
+NamedType::NamedType(TypeContext *owner, Identifier *i)
+    : Type(NamedTypeNode, i->GetLocation()) {
+    (id=i)->SetParent(this);
+    typeDecl = NULL;
+    interfaceNum = -1;
+    canonical = this;
 }
 
-bool NamedType::IsEqualTo(Type *other) {
-    NamedType * nameOther = dynamic_cast<NamedType*>(other);
-    if(nameOther==NULL) {
-        return false;
-    }
-    return (*id) == (*nameOther->id);
+void NamedType::ReportNotDeclaredIdentifier(reasonT reason) {
+    ReportError::IdentifierNotDeclared(id,reason);
 }
 
+/* Method: IsEquivalentTo
+ * -----------------------
+ * A class is a subtype of the other type if that is one of its
+ * superclasses, which then sits at the same depth in both displays, or
+ * an interface that it or a superclass implements.
+ */
 bool NamedType::IsEquivalentTo(Type *other) {
     if(IsEqualTo(other))
         return true;
 
-    NamedType* nType = this;
-    Decl* lookup;
-    while((lookup=Program::gScope->table->Lookup(nType->Name()))!=NULL) {
-        ClassDecl *c = dynamic_cast<ClassDecl*>(lookup);
-        if(c==NULL) return false;
-        List<NamedType*> *imps = c->GetImplements();
-        for(int i=0,n=imps->NumElements();i<n;++i) {
-            if(imps->Nth(i)->IsEqualTo(other)) {
-                return true;
-            }
-        }
-        nType = c->GetExtends();
-        if(nType==NULL)
-            break;
-        if(nType->IsEqualTo(other)) {
-            return true;
-        }
-    }
-    return false;
+    NamedType *nOther = dyn_cast<NamedType>(other);
+    if (nOther == NULL)
+        return false;
+
+    NamedType *self = static_cast<NamedType*>(canonical);
+    nOther = static_cast<NamedType*>(nOther->canonical);
+    size_t depth = nOther->display.size() - 1;
+    if (depth < self->display.size() && self->display[depth] == nOther)
+        return true;
+
+    int i = nOther->interfaceNum;
+    return i >= 0 && self->implemented[i];
 }
 
 BuiltIn NamedType::GetPrint() {
     return NumBuiltIns;
 }
 
-ArrayType::ArrayType(yyltype loc, Type *et) : Type(loc) {
+void NamedType::Resolve(Resolver *r) {
+    id->SetDecl(r->Lookup(id));
+}
+
+ArrayType::ArrayType(SourceRange loc, Type *et) : Type(ArrayTypeNode, loc) {
     Assert(et != NULL);
     (elemType=et)->SetParent(this);
+    canonical = Compilation::Current()->types->ArrayOf(et);
 }
 
-ArrayType::ArrayType(Type *et):Type() {
+ArrayType::ArrayType(Type *et):Type(ArrayTypeNode) {
     Assert(et!=NULL);
     (elemType=et)->SetParent(this);
+    canonical = Compilation::Current()->types->ArrayOf(et);
+}
+
+ArrayType::ArrayType(TypeContext *owner, Type *et) : Type(ArrayTypeNode) {
+    elemType = et;
+    canonical = this;
 }
 
 void ArrayType::ReportNotDeclaredIdentifier(reasonT reason) {
     elemType->ReportNotDeclaredIdentifier(reason);
 }
-bool ArrayType::IsEqualTo(Type *other) {
-    ArrayType * arrayOther = dynamic_cast<ArrayType*>(other);
-    if(arrayOther==NULL)
-        return false;
-    return elemType->IsEqualTo(arrayOther->elemType);
-}
-
 bool ArrayType::IsEquivalentTo(Type *other) {
-    ArrayType *arrayOther = dynamic_cast<ArrayType*>(other);
+    if (IsEqualTo(other))
+        return true;
+
+    ArrayType *arrayOther = dyn_cast<ArrayType>(other);
 
     if (arrayOther == NULL)
         return false;
@@ -128,3 +142,112 @@ bool ArrayType::IsEquivalentTo(Type *other) {
 BuiltIn ArrayType::GetPrint() {
     return elemType->GetPrint();
 }
+
+/* Canonical types
+ * ---------------
+ * A canonical named type gets an identifier of its own, so that it is
+ * not part of the tree, placed where the name was first used. The
+ * canonical array type of an element type is an array of the element
+ * type's canonical type. Unlike other nodes, a canonical named type
+ * owns memory on the heap, so it is destroyed with the arena.
+ */
+NamedType *TypeContext::Named(Identifier *id) {
+    NamedType *&t = named[id->GetName()];
+    if (t == NULL) {
+        t = new NamedType(this, new Identifier(id->GetLocation(), id->GetName()));
+        Arena::Current()->DestroyOnFree(t); // for its display and interfaces
+    }
+    return t;
+}
+
+ArrayType *TypeContext::ArrayOf(Type *elemType) {
+    Type *elem = elemType->Canonical();
+    ArrayType *&t = arrays[elem];
+    if (t == NULL)
+        t = new ArrayType(this, elem);
+    return t;
+}
+
+void TypeContext::BindNames(Scope *global) {
+    for (auto &entry : named)
+        entry.second->typeDecl = global->table->Lookup(entry.first);
+    EncodeHierarchy();
+}
+
+NamedType *TypeContext::Superclass(NamedType *t) {
+    ClassDecl *c = dyn_cast<ClassDecl>(t->typeDecl);
+    if (c == NULL || c->GetExtends() == NULL)
+        return NULL;
+    return static_cast<NamedType*>(c->GetExtends()->Canonical());
+}
+
+/* Method: EncodeHierarchy
+ * -----------------------
+ * Numbers the types named in implements lists, then gives each named
+ * type its display and the set of interfaces it implements, copying
+ * both from its superclass (which is done first) before adding its own.
+ * The classes on a cycle of superclasses are each treated as having no
+ * superclass.
+ */
+void TypeContext::EncodeHierarchy() {
+    int numInterfaces = 0;
+    for (auto &entry : named) {
+        ClassDecl *c = dyn_cast<ClassDecl>(entry.second->typeDecl);
+        if (c == NULL)
+            continue;
+        for (NamedType *imp : *c->GetImplements()) {
+            NamedType *t = static_cast<NamedType*>(imp->Canonical());
+            if (t->interfaceNum < 0)
+                t->interfaceNum = numInterfaces++;
+        }
+    }
+
+    for (auto &entry : named) {
+        vector<NamedType*> chain;  // superclasses still to do, t first
+        unordered_set<NamedType*> onChain;
+        NamedType *t = entry.second;
+        for (; t != NULL && t->display.empty(); t = Superclass(t)) {
+            if (!onChain.insert(t).second)
+                break;
+            chain.push_back(t);
+        }
+        // if the chain ran back into itself, t is where the cycle starts
+        size_t cycleStart = chain.size();
+        if (t != NULL && t->display.empty())
+            cycleStart = find(chain.begin(), chain.end(), t) - chain.begin();
+
+        for (size_t j = chain.size(); j-- > 0; ) {
+            NamedType *sub = chain[j];
+            NamedType *super = j < cycleStart ? Superclass(sub) : NULL;
+            if (super != NULL) {
+                sub->display = super->display;
+                sub->implemented = super->implemented;
+            } else {
+                sub->implemented.assign(numInterfaces, false);
+            }
+            sub->display.push_back(sub);
+
+            ClassDecl *c = dyn_cast<ClassDecl>(sub->typeDecl);
+            if (c == NULL)
+                continue;
+            for (NamedType *imp : *c->GetImplements()) {
+                NamedType *i = static_cast<NamedType*>(imp->Canonical());
+                sub->implemented[i->interfaceNum] = true;
+            }
+        }
+    }
+}
+
+int Type::Write(AstWriter *out) {
+    return out->AddBuiltInType(this);
+}
+
+int NamedType::Write(AstWriter *out) {
+    int kids[] = { out->Add(id) };
+    return out->AddNode(NamedTypeNode, NULL, kids, 1);
+}
+
+int ArrayType::Write(AstWriter *out) {
+    int kids[] = { out->Add(elemType) };
+    return out->AddNode(ArrayTypeNode, &location, kids, 1);
+}
@@ -0,0 +1,481 @@
+/* File: astfile.cc
+ * ----------------
+ * Implementation of the AstWriter and AstFile classes.
+ */
+
+#include "astfile.h"
+#include "ast_decl.h"
+#include "ast_expr.h"
+#include "ast_stmt.h"
+#include "ast_type.h"
+#include "compilation.h"
+#include "symbols.h"
+#include "utility.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char Magic[8] = "dcc-ast";
+static const uint32_t ByteOrder = 0x01020304;
+static const int NumPadding = 2; // the NULs after the source, as flex wants
+
+// The built-in types, by the value of a BuiltInTypeNode
+static Type **const builtInTypes[] = {
+    &Type::intType, &Type::doubleType, &Type::boolType, &Type::voidType,
+    &Type::nullType, &Type::stringType, &Type::errorType
+};
+static const int NumBuiltInTypes = sizeof(builtInTypes) / sizeof(builtInTypes[0]);
+
+static size_t Align(size_t n) { return (n + 7) & ~(size_t)7; }
+
+int AstWriter::AddNode(NodeKind kind, const SourceRange *loc, const int *kids,
+                       int numKids, uint64_t value) {
+    AstNode node;
+    node.kind = kind;
+    node.numChildren = numKids;
+    node.firstChild = children.size();
+    node.location = NoIndex;
+    node.value = value;
+    children.insert(children.end(), kids, kids + numKids);
+
+    if (loc != NULL) {
+        node.location = locations.size();
+        locations.push_back(*loc);
+    }
+    nodes.push_back(node);
+    return nodes.size() - 1;
+}
+
+int AstWriter::AddBuiltInType(Type *type) {
+    for (int i = 0; i < NumBuiltInTypes; i++)
+        if (type == *builtInTypes[i])
+            return AddNode(BuiltInTypeNode, NULL, NULL, 0, i);
+    Failure("Type '%s' is not a built-in type", type->Name());
+    return -1;
+}
+
+uint32_t AstWriter::Symbol(const char *str) {
+    auto found = symbolIndex.emplace(str, symbols.size());
+    if (found.second) {
+        symbols.push_back(text.size());
+        text.append(str, strlen(str) + 1);
+    }
+    return found.first->second;
+}
+
+uint64_t AstWriter::Bits(double d) {
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    return bits;
+}
+
+// Writes len bytes and then the NULs up to the next 8-byte boundary
+static bool WriteSection(FILE *out, const void *data, size_t len) {
+    static const char zeros[8] = {0};
+    if (len > 0 && fwrite(data, 1, len, out) != len)
+        return false;
+    size_t pad = Align(len) - len;
+    return pad == 0 || fwrite(zeros, 1, pad, out) == pad;
+}
+
+bool AstWriter::WriteTo(FILE *out) {
+    if (nodes.size() >= NoIndex || children.size() >= NoIndex ||
+        text.size() >= NoIndex)
+        return false;
+
+    AstHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, Magic, sizeof(h.magic));
+    h.byteOrder = ByteOrder;
+    h.version = AstFile::FormatVersion;
+    h.numNodes = nodes.size();
+    h.numChildren = children.size();
+    h.numLocations = locations.size();
+    h.numSymbols = symbols.size();
+    h.textBytes = text.size();
+    h.sourceBytes = source->Length();
+
+    vector<uint32_t> offsets(symbols);
+    offsets.push_back(text.size());
+    static const char nuls[NumPadding] = {0};
+    return WriteSection(out, &h, sizeof(h)) &&
+           WriteSection(out, nodes.data(), nodes.size() * sizeof(AstNode)) &&
+           WriteSection(out, children.data(), children.size() * sizeof(uint32_t)) &&
+           WriteSection(out, locations.data(),
+                        locations.size() * sizeof(SourceRange)) &&
+           WriteSection(out, offsets.data(), offsets.size() * sizeof(uint32_t)) &&
+           WriteSection(out, text.data(), text.size()) &&
+           fwrite(source->Text(), 1, h.sourceBytes, out) == h.sourceBytes &&
+           fwrite(nuls, 1, NumPadding, out) == NumPadding &&
+           fflush(out) == 0;
+}
+
+bool AstFile::Write(Program *program, SourceBuffer *source, FILE *out) {
+    AstWriter writer(source);
+    writer.Add(program);
+    return writer.WriteTo(out);
+}
+
+AstFile::~AstFile() {
+    if (mem != NULL)
+        munmap(mem, length);
+}
+
+// Describes why path can't be read, from errno, and closes fd if it
+// is open. Returns false, for Map to return.
+static bool CannotRead(const char *path, int fd, string *problem) {
+    *problem = string("Cannot read AST file '") + path + "': " +
+               strerror(errno);
+    if (fd >= 0)
+        close(fd);
+    return false;
+}
+
+// Describes why the AST file at path can't be loaded. Returns false,
+// for Map to return.
+static bool CannotLoad(const string &path, const char *why, string *problem) {
+    *problem = "Cannot load AST file '" + path + "': " + why;
+    return false;
+}
+
+// Reports the first problem Load finds as an error of the current
+// compilation. Load goes on to its end without making any more nodes
+// and returns NULL, so a damaged file fails just the one compilation.
+void AstFile::Corrupt(const char *problem) {
+    if (damaged)
+        return;
+    damaged = true;
+    Compilation *c = Compilation::Current();
+    c->ErrorStream() << "\n*** Cannot load AST file '" << path << "': "
+                     << problem << "\n\n";
+    c->numErrors++;
+}
+
+// Makes a node from args, which have already been made, unless a
+// problem has been found along the way (one of them may be missing)
+template <class N, class... Args>
+N *AstFile::Build(Args... args) {
+    if (damaged)
+        return NULL;
+    return new N(args...);
+}
+
+/* Method: Map
+ * -----------
+ * The mapping is private and writable, as the source text in it is
+ * where the scanner would work (see SourceBuffer). Beyond the header,
+ * nothing is checked until Load, which checks each node as it makes
+ * it, so a damaged file is reported rather than trusted.
+ */
+bool AstFile::Map(const char *p, string *problem) {
+    path = p;
+    int fd = open(p, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0)
+        return CannotRead(p, fd, problem);
+    if ((size_t)st.st_size < sizeof(AstHeader)) {
+        close(fd);
+        return CannotLoad(path, "not an AST file", problem);
+    }
+    void *m = mmap(NULL, st.st_size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (m == MAP_FAILED)
+        return CannotRead(p, fd, problem);
+    close(fd);
+    mem = (char *)m;   // unmapped by the destructor, whatever happens below
+    length = st.st_size;
+
+    header = (const AstHeader *)mem;
+    if (memcmp(header->magic, Magic, sizeof(Magic)) != 0)
+        return CannotLoad(path, "not an AST file", problem);
+    if (header->byteOrder != ByteOrder)
+        return CannotLoad(path, "written on a machine with another byte order",
+                          problem);
+    if (header->version != FormatVersion)
+        return CannotLoad(path, "written by another version of dcc", problem);
+
+    size_t offset = Align(sizeof(AstHeader));
+    nodes = (const AstNode *)(mem + offset);
+    offset += Align((size_t)header->numNodes * sizeof(AstNode));
+    children = (const uint32_t *)(mem + offset);
+    offset += Align((size_t)header->numChildren * sizeof(uint32_t));
+    locations = (const SourceRange *)(mem + offset);
+    offset += Align((size_t)header->numLocations * sizeof(SourceRange));
+    symbols = (const uint32_t *)(mem + offset);
+    offset += Align(((size_t)header->numSymbols + 1) * sizeof(uint32_t));
+    text = mem + offset;
+    offset += Align(header->textBytes);
+    sourceText = mem + offset;
+    offset += (size_t)header->sourceBytes + NumPadding;
+    if (offset != length || sourceText[header->sourceBytes] != '\0' ||
+        sourceText[header->sourceBytes + 1] != '\0')
+        return CannotLoad(path, "the file is truncated or damaged", problem);
+    source.Borrow(sourceText, header->sourceBytes);
+    return true;
+}
+
+/* Method: Load
+ * ------------
+ * Makes each node in file order. Every child a node names must already
+ * have been made (so comes earlier in the file), be of the kind its
+ * constructor takes, and not have been given to another parent. Once a
+ * problem is found, no more nodes are made; those already made belong
+ * to the compilation's arena like any others.
+ */
+Program *AstFile::Load() {
+    uint32_t n = header->numNodes;
+    damaged = false;
+    if (n == 0)
+        Corrupt("the file has no nodes");
+    built.assign(n, NULL);
+    used.assign(n, false);
+    interned.assign(header->numSymbols, NULL);
+    for (uint32_t i = 0; i < n && !damaged; i++)
+        built[i] = Make(i);
+
+    Program *program = damaged ? NULL : dyn_cast<Program>(built[n - 1]);
+    if (program == NULL)
+        Corrupt("the last node is not a program");
+    for (uint32_t i = 0; i + 1 < n && !damaged; i++)
+        if (!used[i])
+            Corrupt("a node has no parent");
+    if (damaged)
+        program = NULL;
+    vector<Node*>().swap(built);
+    vector<bool>().swap(used);
+    vector<const char*>().swap(interned);
+    return program;
+}
+
+// Returns the index of child i of node n, which is being made as node
+// index, or NoIndex if it is absent
+uint32_t AstFile::ChildIndex(const AstNode &n, int i, uint32_t index) {
+    uint32_t child = children[n.firstChild + i];
+    if (child == NoIndex)
+        return NoIndex;
+    if (child >= index || used[child]) {
+        Corrupt("a node is not a tree");
+        return NoIndex;
+    }
+    used[child] = true;
+    return child;
+}
+
+template <class T>
+T *AstFile::Child(const AstNode &n, int i, uint32_t index, bool optional) {
+    uint32_t child = ChildIndex(n, i, index);
+    if (child == NoIndex) {
+        if (!optional)
+            Corrupt("a node is missing a child");
+        return NULL;
+    }
+    T *node = dyn_cast<T>(built[child]);
+    if (node == NULL)
+        Corrupt("a node has a child of the wrong kind");
+    return node;
+}
+
+template <class T>
+List<T*> *AstFile::ChildList(const AstNode &n, int i, uint32_t index) {
+    uint32_t child = ChildIndex(n, i, index);
+    if (child == NoIndex || nodes[child].kind != ListNode) {
+        Corrupt("a node is missing a list");
+        return NULL;
+    }
+    const AstNode &l = nodes[child];
+    List<T*> *list = new List<T*>;
+    list->Reserve(l.numChildren);
+    for (uint32_t j = 0; j < l.numChildren; j++)
+        list->Append(Child<T>(l, j, child));
+    return list;
+}
+
+const char *AstFile::Text(uint64_t symbol) {
+    if (symbol >= header->numSymbols) {
+        Corrupt("a symbol is out of range");
+        return "";
+    }
+    uint32_t start = symbols[symbol], end = symbols[symbol + 1];
+    if (start >= end || end > header->textBytes || text[end - 1] != '\0') {
+        Corrupt("a symbol is damaged");
+        return "";
+    }
+    return text + start;
+}
+
+const char *AstFile::Symbol(uint64_t symbol) {
+    const char *str = Text(symbol);
+    if (damaged)
+        return str;
+    if (interned[symbol] == NULL)
+        interned[symbol] = Symbols::Intern(str, symbols[symbol + 1] - symbols[symbol] - 1);
+    return interned[symbol];
+}
+
+SourceRange AstFile::Location(const AstNode &n) {
+    if (n.location >= header->numLocations) {
+        Corrupt("a node is missing its location");
+        return SourceRange();
+    }
+    SourceRange loc = locations[n.location];
+    if (loc.IsValid() &&
+        (loc.begin > loc.end || loc.end > header->sourceBytes))
+        Corrupt("a location is out of range");
+    return loc;
+}
+
+// The number of children of each kind of node, -1 for any number
+static const int numChildren[NumNodeKinds] = {
+    -1, 1, 0, 0,                // List, Program, Identifier, Operator
+    0, 1, 1,                    // the types
+    2, 4, 2, 4,                 // the decls
+    2, 4, 2, 3, 0, 1, 1,        // the stmts
+    0, 0, 0, 0, 0, 0,           // EmptyExpr and the constants
+    3, 3, 3, 3, 3,              // the compound exprs
+    0, 2, 2, 3, 1, 2, 0, 0,     // the rest
+    0                           // Error, which is never written
+};
+
+/* Method: Make
+ * ------------
+ * Makes node index with the constructor the parser would have used, so
+ * it ends up just as it would have from the source. A child that is a
+ * list of nodes is made here, with room reserved for all its elements.
+ */
+Node *AstFile::Make(uint32_t index) {
+    const AstNode &n = nodes[index];
+    if (n.kind >= NumNodeKinds ||
+        (numChildren[n.kind] >= 0 && n.numChildren != (uint32_t)numChildren[n.kind]) ||
+        (uint64_t)n.firstChild + n.numChildren > header->numChildren) {
+        Corrupt("a node is damaged");
+        return NULL;
+    }
+
+    switch (n.kind) {
+      case ListNode:
+        return NULL;
+      case ProgramNode:
+        return Build<Program>(ChildList<Decl>(n, 0, index));
+      case IdentifierNode:
+        return Build<Identifier>(Location(n), Symbol(n.value));
+      case OperatorNode: {
+        const char *tok = Text(n.value);
+        if (strlen(tok) >= 4)
+            Corrupt("an operator is damaged");
+        return Build<Operator>(Location(n), tok);
+      }
+
+      case BuiltInTypeNode:
+        if (n.value >= (uint64_t)NumBuiltInTypes) {
+            Corrupt("a built-in type is out of range");
+            return NULL;
+        }
+        return *builtInTypes[n.value];
+      case NamedTypeNode:
+        return Build<NamedType>(Child<Identifier>(n, 0, index));
+      case ArrayTypeNode:
+        if (n.location == NoIndex)
+            return Build<ArrayType>(Child<Type>(n, 0, index));
+        return Build<ArrayType>(Location(n), Child<Type>(n, 0, index));
+
+      case VarDeclNode:
+        return Build<VarDecl>(Child<Identifier>(n, 0, index), Child<Type>(n, 1, index));
+      case ClassDeclNode:
+        return Build<ClassDecl>(Child<Identifier>(n, 0, index),
+                             Child<NamedType>(n, 1, index, true),
+                             ChildList<NamedType>(n, 2, index),
+                             ChildList<Decl>(n, 3, index));
+      case InterfaceDeclNode:
+        return Build<InterfaceDecl>(Child<Identifier>(n, 0, index),
+                                 ChildList<Decl>(n, 1, index));
+      case FnDeclNode: {
+        FnDecl *fn = Build<FnDecl>(Child<Identifier>(n, 0, index),
+                                Child<Type>(n, 1, index),
+                                ChildList<VarDecl>(n, 2, index));
+        Stmt *body = Child<Stmt>(n, 3, index, true);
+        if (fn != NULL && body != NULL)
+            fn->SetFunctionBody(body);
+        return fn;
+      }
+
+      case StmtBlockNode:
+        return Build<StmtBlock>(ChildList<VarDecl>(n, 0, index),
+                             ChildList<Stmt>(n, 1, index));
+      case ForStmtNode:
+        return Build<ForStmt>(Child<Expr>(n, 0, index), Child<Expr>(n, 1, index),
+                           Child<Expr>(n, 2, index), Child<Stmt>(n, 3, index));
+      case WhileStmtNode:
+        return Build<WhileStmt>(Child<Expr>(n, 0, index), Child<Stmt>(n, 1, index));
+      case IfStmtNode:
+        return Build<IfStmt>(Child<Expr>(n, 0, index), Child<Stmt>(n, 1, index),
+                          Child<Stmt>(n, 2, index, true));
+      case BreakStmtNode:
+        return Build<BreakStmt>(Location(n));
+      case ReturnStmtNode:
+        return Build<ReturnStmt>(Location(n), Child<Expr>(n, 0, index));
+      case PrintStmtNode:
+        return Build<PrintStmt>(ChildList<Expr>(n, 0, index));
+
+      case EmptyExprNode:
+        return Build<EmptyExpr>();
+      case IntConstantNode:
+        return Build<IntConstant>(Location(n), (int32_t)n.value);
+      case DoubleConstantNode: {
+        double d;
+        memcpy(&d, &n.value, sizeof(d));
+        return Build<DoubleConstant>(Location(n), d);
+      }
+      case BoolConstantNode:
+        return Build<BoolConstant>(Location(n), n.value != 0);
+      case StringConstantNode:
+        return Build<StringConstant>(Location(n), Text(n.value));
+      case NullConstantNode:
+        return Build<NullConstant>(Location(n));
+
+      case ArithmeticExprNode:
+      case LogicalExprNode: {
+        Expr *left = Child<Expr>(n, 0, index, true);
+        Operator *op = Child<Operator>(n, 1, index);
+        Expr *right = Child<Expr>(n, 2, index);
+        if (n.kind == ArithmeticExprNode)
+            return left ? Build<ArithmeticExpr>(left, op, right) : Build<ArithmeticExpr>(op, right);
+        return left ? Build<LogicalExpr>(left, op, right) : Build<LogicalExpr>(op, right);
+      }
+      case RelationalExprNode:
+        return Build<RelationalExpr>(Child<Expr>(n, 0, index), Child<Operator>(n, 1, index),
+                                  Child<Expr>(n, 2, index));
+      case EqualityExprNode:
+        return Build<EqualityExpr>(Child<Expr>(n, 0, index), Child<Operator>(n, 1, index),
+                                Child<Expr>(n, 2, index));
+      case AssignExprNode:
+        return Build<AssignExpr>(Child<Expr>(n, 0, index), Child<Operator>(n, 1, index),
+                              Child<Expr>(n, 2, index));
+
+      case ThisNode:
+        return Build<This>(Location(n));
+      case ArrayAccessNode:
+        return Build<ArrayAccess>(Location(n), Child<Expr>(n, 0, index),
+                               Child<Expr>(n, 1, index));
+      case FieldAccessNode:
+        return Build<FieldAccess>(Child<Expr>(n, 0, index, true),
+                               Child<Identifier>(n, 1, index));
+      case CallNode:
+        return Build<Call>(Location(n), Child<Expr>(n, 0, index, true),
+                        Child<Identifier>(n, 1, index), ChildList<Expr>(n, 2, index));
+      case NewExprNode:
+        return Build<NewExpr>(Location(n), Child<NamedType>(n, 0, index));
+      case NewArrayExprNode:
+        return Build<NewArrayExpr>(Location(n), Child<Expr>(n, 0, index),
+                                Child<Type>(n, 1, index));
+      case ReadIntegerExprNode:
+        return Build<ReadIntegerExpr>(Location(n));
+      case ReadLineExprNode:
+        return Build<ReadLineExpr>(Location(n));
+      case ErrorNode:
+        Corrupt("the file has an error node");
+    }
+    return NULL;
+}
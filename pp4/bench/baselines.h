@@ -0,0 +1,106 @@
+/* File: baselines.h
+ * ------------------
+ * The containers the compiler used before its own Hashtable and List,
+ * for hashtable_bench and list_bench to time against and for
+ * container_check to hold the new ones to.
+ */
+
+#ifndef _H_baselines
+#define _H_baselines
+
+#include <stdlib.h>
+#include <string.h>
+#include <deque>
+#include <map>
+#include <vector>
+#include "utility.h"
+using namespace std;
+
+// The std::multimap table that Hashtable replaced. A key's values are
+// kept in the order they were entered, and Lookup walks to the last.
+struct ltstr {
+  bool operator()(const char* s1, const char* s2) const
+  { return strcmp(s1, s2) < 0; }
+};
+
+template<class Value> class MultimapTable {
+  private:
+    multimap<const char*, Value, ltstr> mmap;
+
+  public:
+    void Enter(const char *key, Value val, bool overwrite = true) {
+      Value prev;
+      if (overwrite && (prev = Lookup(key)))
+        Remove(key, prev);
+      mmap.insert(make_pair(strdup(key), val));
+    }
+
+    void Remove(const char *key, Value val) {
+      if (mmap.count(key) == 0)
+        return;
+      typename multimap<const char *, Value, ltstr>::iterator itr;
+      itr = mmap.find(key);
+      while (itr != mmap.upper_bound(key)) {
+        if (itr->second == val) {
+          mmap.erase(itr);
+          break;
+        }
+        ++itr;
+      }
+    }
+
+    Value Lookup(const char *key) {
+      Value found = NULL;
+      if (mmap.count(key) > 0) {
+        typename multimap<const char *, Value, ltstr>::iterator cur, last, prev;
+        cur = mmap.find(key);
+        last = mmap.upper_bound(key);
+        while (cur != last) {
+          prev = cur;
+          if (++cur == mmap.upper_bound(key)) {
+            found = prev->second;
+            break;
+          }
+        }
+      }
+      return found;
+    }
+
+    int NumEntries() const { return mmap.size(); }
+
+    vector<Value> Values() {
+      vector<Value> v;
+      for (typename multimap<const char*, Value, ltstr>::iterator i = mmap.begin();
+           i != mmap.end(); ++i)
+        v.push_back(i->second);
+      return v;
+    }
+};
+
+// The std::deque list that List replaced. It has no begin/end, so it
+// is walked with Nth, as the passes used to walk every list.
+template<class Element> class DequeList {
+  private:
+    deque<Element> elems;
+
+  public:
+    int NumElements() const
+	{ return elems.size(); }
+
+    Element Nth(int index) const
+	{ Assert(index >= 0 && index < NumElements());
+	  return elems[index]; }
+
+    void InsertAt(const Element &elem, int index)
+	{ Assert(index >= 0 && index <= NumElements());
+	  elems.insert(elems.begin() + index, elem); }
+
+    void Append(const Element &elem)
+	{ elems.push_back(elem); }
+
+    void RemoveAt(int index)
+	{ Assert(index >= 0 && index < NumElements());
+	  elems.erase(elems.begin() + index); }
+};
+
+#endif
@@ -0,0 +1,212 @@
+/* File: compile_bench.cc
+ * ----------------------
+ * Compile-throughput benchmark. Each series generates programs of
+ * increasing size with decafgen, turning up one knob at a time, and
+ * compiles them with dcc -d timing, which reports the time taken and
+ * the peak RSS reached by the end of each phase (see
+ * Compilation::ReportStats). Every size is compiled a few times and the
+ * fastest run is kept.
+ *
+ * The time of each phase should grow linearly with the size of the
+ * program (counted in tokens). For every series, the growth exponent
+ * of each phase, and of the peak RSS, is fitted by least squares on a
+ * log-log scale; if any exceeds the limit the benchmark says so and
+ * exits with status 1. Phases too quick to time reliably are skipped.
+ * A bigger program is also a bigger working set, so even linear work
+ * fits at a little over n^1 (up to about n^1.25 on a small machine);
+ * the default limit sits above that and below anything quadratic, which
+ * fits at n^1.5 or more over these ranges.
+ *
+ * The depth series is the exception: it keeps the number of classes and
+ * lengthens the chains they form, so the size in tokens stays put while
+ * what each class inherits (its fields and vtable) grows with the depth.
+ * It is fitted against the depth instead.
+ *
+ * Usage: compile_bench [-dcc path] [-gen path] [-runs n] [-limit x]
+ *        (defaults ./dcc, ./decafgen, 5 runs, limit 1.4)
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <map>
+#include <string>
+#include <vector>
+using namespace std;
+
+static const char *const Phases[] = { "parse", "check", "emit", "final" };
+static const int NumPhases = 4;
+static const double MinTimedSeconds = 0.005; // shorter is mostly noise
+
+struct Series {
+  const char *name;       // the knob turned up
+  const char *fixed;      // the other knobs
+  int start, steps;       // the knob doubles at each step
+  bool byKnob;            // fitted against the knob rather than the tokens
+};
+
+static const Series AllSeries[] = {
+  { "classes", "-methods 4 -depth 4 -nesting 3 -expr 4 -strings 2", 25, 6 },
+  { "depth", "-classes 1024 -methods 2 -nesting 1 -expr 2 -strings 1", 4, 9,
+    true },
+  { "methods", "-classes 20 -depth 4 -nesting 2 -expr 4 -strings 1", 4, 6 },
+  { "nesting", "-classes 20 -methods 2 -depth 2 -expr 2 -strings 1", 32, 8 },
+  { "expr", "-classes 20 -methods 2 -depth 2 -nesting 1 -strings 1", 16, 6 },
+  { "strings", "-classes 20 -methods 2 -depth 2 -nesting 1 -expr 2", 8, 6 },
+};
+
+// One compile's -d timing line, as name -> value
+typedef map<string, double> Timing;
+
+static bool ParseTiming(const char *line, Timing *timing) {
+  const char *p = strstr(line, "+++ (timing):");
+  if (p == NULL)
+    return false;
+  p += strlen("+++ (timing):");
+  char name[64];
+  double value;
+  int used;
+  while (sscanf(p, " %63[^=]=%lf%n", name, &value, &used) == 2) {
+    (*timing)[name] = value;
+    p += used;
+  }
+  return true;
+}
+
+// Runs dcc on path and returns its timing, or exits if it fails
+static Timing Compile(const string &dcc, const string &path) {
+  string command = dcc + " -d timing < " + path + " 2>&1 >/dev/null";
+  FILE *f = popen(command.c_str(), "r");
+  Timing timing;
+  bool found = false;
+  char line[1024];
+  while (f != NULL && fgets(line, sizeof(line), f) != NULL)
+    found = ParseTiming(line, &timing) || found;
+  if (f == NULL || pclose(f) != 0 || !found) {
+    fprintf(stderr, "*** compile_bench: '%s' failed\n", command.c_str());
+    exit(2);
+  }
+  return timing;
+}
+
+// The slope of the least-squares line through (log x, log y)
+static double Exponent(const vector<double> &x, const vector<double> &y) {
+  double n = x.size(), sx = 0, sy = 0, sxx = 0, sxy = 0;
+  for (size_t i = 0; i < x.size(); i++) {
+    double lx = log(x[i]), ly = log(y[i]);
+    sx += lx; sy += ly; sxx += lx*lx; sxy += lx*ly;
+  }
+  return (n*sxy - sx*sy) / (n*sxx - sx*sx);
+}
+
+// Runs one series and returns the number of measures that grew too fast
+static int RunSeries(const Series &s, const string &dcc, const string &gen,
+                     const string &path, int runs, double limit) {
+  printf("series %s (%s)\n", s.name, s.fixed);
+  printf("%10s %9s", s.name, "tokens");
+  for (int p = 0; p < NumPhases; p++)
+    printf(" %9s", Phases[p]);
+  printf(" %9s", "total");
+  for (int p = 0; p < NumPhases; p++)
+    printf(" %8s", (string("kb_") + Phases[p]).c_str());
+  printf("\n");
+
+  vector<double> sizes, peakKB, seconds[NumPhases];
+  for (int step = 0, knob = s.start; step < s.steps; step++, knob *= 2) {
+    char command[512];
+    snprintf(command, sizeof(command), "%s %s -%s %d > %s", gen.c_str(),
+             s.fixed, s.name, knob, path.c_str());
+    if (system(command) != 0) {
+      fprintf(stderr, "*** compile_bench: '%s' failed\n", command);
+      exit(2);
+    }
+
+    Timing best;
+    for (int r = 0; r < runs; r++) {
+      Timing t = Compile(dcc, path);
+      if (r == 0 || t["total"] < best["total"])
+        best = t;
+    }
+    printf("%10d %9.0f", knob, best["tokens"]);
+    for (int p = 0; p < NumPhases; p++)
+      printf(" %9.6f", best[Phases[p]]);
+    printf(" %9.6f", best["total"]);
+    for (int p = 0; p < NumPhases; p++)
+      printf(" %8.0f", best[string("rss_") + Phases[p]]);
+    printf("\n");
+
+    sizes.push_back(s.byKnob ? knob : best["tokens"]);
+    peakKB.push_back(best["rss_final"]);
+    for (int p = 0; p < NumPhases; p++)
+      seconds[p].push_back(best[Phases[p]]);
+  }
+
+  int failures = 0;
+  printf("  growth:");
+  for (int p = 0; p <= NumPhases; p++) {
+    vector<double> x, y;  // the points timed reliably
+    for (size_t i = 0; i < sizes.size(); i++) {
+      double t = (p < NumPhases ? seconds[p][i] : peakKB[i]);
+      if (p == NumPhases || t >= MinTimedSeconds) {
+        x.push_back(sizes[i]);
+        y.push_back(t);
+      }
+    }
+    const char *name = (p < NumPhases ? Phases[p] : "rss");
+    if (x.size() < 3) {
+      printf(" %s -", name);
+      continue;
+    }
+    double e = Exponent(x, y);
+    printf(" %s n^%.2f", name, e);
+    if (e > limit) {
+      fprintf(stderr, "*** compile_bench: %s grows as n^%.2f with %s "
+              "(limit n^%.2f)\n", name, e, s.name, limit);
+      failures++;
+    }
+  }
+  printf("\n\n");
+  fflush(stdout);
+  return failures;
+}
+
+int main(int argc, char *argv[]) {
+  string dcc = "./dcc", gen = "./decafgen";
+  int runs = 5;
+  double limit = 1.4;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "-dcc") == 0) dcc = argv[i + 1];
+    else if (strcmp(argv[i], "-gen") == 0) gen = argv[i + 1];
+    else if (strcmp(argv[i], "-runs") == 0) runs = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "-limit") == 0) limit = atof(argv[i + 1]);
+    else break;
+  }
+  if (argc % 2 == 0 || runs < 1 || limit <= 0) {
+    fprintf(stderr, "Usage: compile_bench [-dcc path] [-gen path] "
+            "[-runs n] [-limit x]\n");
+    return 2;
+  }
+
+  char path[] = "/tmp/compile_bench_XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0) {
+    perror("compile_bench");
+    return 2;
+  }
+  close(fd);
+
+  int failures = 0;
+  for (size_t i = 0; i < sizeof(AllSeries)/sizeof(AllSeries[0]); i++)
+    failures += RunSeries(AllSeries[i], dcc, gen, path, runs, limit);
+  unlink(path);
+
+  if (failures > 0) {
+    fprintf(stderr, "*** compile_bench: %d measure%s grew faster than "
+            "linearly\n", failures, failures == 1 ? "" : "s");
+    return 1;
+  }
+  printf("all phases scale linearly\n");
+  return 0;
+}
@@ -0,0 +1,107 @@
+/* File: container_check.cc
+ * ------------------------
+ * Checks the compiler's Hashtable and List against the containers they
+ * replaced (see baselines.h), which are taken to be right. Each pair is
+ * given the same long run of random operations, from a fixed seed, and
+ * whatever they report along the way must match, as must their contents
+ * at the end. The first disagreement fails an Assert, which names it.
+ *
+ * Usage: container_check [numOps]     (default 200000)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "baselines.h"
+#include "hashtable.h"
+#include "list.h"
+#include "utility.h"
+
+typedef long *Val;
+
+static vector<Val> Values(Hashtable<Val> &t) {
+  vector<Val> v;
+  Iterator<Val> iter = t.GetIterator();
+  Val x;
+  while ((x = iter.GetNextValue()) != NULL)
+    v.push_back(x);
+  return v;
+}
+
+/* Function: CheckHashtable
+ * ------------------------
+ * Enters values under a couple of hundred keys, both overwriting and
+ * shadowing, removes some, and looks keys up, so keys gain and lose
+ * shadowed values and the table grows and empties slots as it goes.
+ */
+static void CheckHashtable(int numOps) {
+  Hashtable<Val> table;
+  MultimapTable<Val> baseline;
+  static long cells[64];
+  char key[32];
+
+  srand(143);
+  for (int i = 0; i < numOps; i++) {
+    sprintf(key, "k%d", rand() % 200);
+    Val v = &cells[rand() % 64];
+    switch (rand() % 4) {
+      case 0: table.Enter(key, v); baseline.Enter(key, v); break;
+      case 1: table.Enter(key, v, false); baseline.Enter(key, v, false); break;
+      case 2: table.Remove(key, v); baseline.Remove(key, v); break;
+      case 3: Assert(table.Lookup(key) == baseline.Lookup(key)); break;
+    }
+    Assert(table.NumEntries() == baseline.NumEntries());
+  }
+  Assert(Values(table) == baseline.Values());
+}
+
+/* Function: CheckList
+ * -------------------
+ * Appends, inserts and removes at random places. The lists stay short,
+ * so elements keep moving in and out of the ones a List holds inside
+ * itself, and now and then a copy of the List is walked with its
+ * iterators.
+ */
+static void CheckList(int numOps) {
+  List<Val> list;
+  DequeList<Val> baseline;
+  static long cells[64];
+
+  srand(143);
+  for (int i = 0; i < numOps; i++) {
+    int n = list.NumElements();
+    Val v = &cells[rand() % 64];
+    switch (rand() % 4) {
+      case 0: list.Append(v); baseline.Append(v); break;
+      case 1: { int at = rand() % (n + 1);
+                list.InsertAt(v, at); baseline.InsertAt(v, at); break; }
+      case 2: case 3:
+        if (n > 0) { int at = rand() % n;
+                     list.RemoveAt(at); baseline.RemoveAt(at); }
+        break;
+    }
+    Assert(list.NumElements() == baseline.NumElements());
+    if (i % 97 == 0) {
+      List<Val> copy(list);
+      int j = 0;
+      for (Val x : copy)
+        Assert(x == baseline.Nth(j++));
+      Assert(j == baseline.NumElements());
+    }
+  }
+  for (int i = 0, n = list.NumElements(); i < n; i++)
+    Assert(list.Nth(i) == baseline.Nth(i));
+}
+
+int main(int argc, char *argv[]) {
+  int numOps = (argc > 1 ? atoi(argv[1]) : 200000);
+  if (argc > 2 || numOps < 1) {
+    fprintf(stderr, "Usage: container_check [numOps]\n");
+    return 2;
+  }
+  CheckHashtable(numOps);
+  printf("Hashtable agrees with the multimap table\n");
+  CheckList(numOps);
+  printf("List agrees with the deque list\n");
+  return 0;
+}
@@ -0,0 +1,153 @@
+/* File: decafgen.cc
+ * -----------------
+ * Writes a synthetic Decaf program to stdout, for benchmarking the
+ * compiler on programs much bigger than the samples. The program is
+ * well formed and type-correct, so every phase of the compiler runs on
+ * it, and its size is set by a few knobs:
+ *
+ *   -classes n    number of classes
+ *   -depth n      length of each chain of classes extending one another
+ *   -methods n    methods per class (a subclass overrides all of them)
+ *   -nesting n    depth of the nested if/while/for in each method
+ *   -expr n       depth of the arithmetic expression at the innermost
+ *                 level of that nesting
+ *   -strings n    string literals printed by each method
+ *
+ * The output only depends on the knobs, so the same knobs always give
+ * the same program. main creates an object of every class and calls its
+ * first method.
+ *
+ * Usage: decafgen [-classes n] [-depth n] [-methods n] [-nesting n]
+ *                 [-expr n] [-strings n]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct Knobs {
+  int classes, depth, methods, nesting, expr, strings;
+};
+
+// Deep nesting is indented no further than this, so the size of the
+// program in bytes grows with its size in tokens
+static const int MaxIndent = 8;
+
+static void Indent(int level) {
+  for (int i = 0; i < level && i < MaxIndent; i++)
+    fputs("  ", stdout);
+}
+
+// A left-deep chain of depth operators over the method's variables
+static void Expr(int depth, int cls) {
+  static const char *const ops[] = { " + ", " - ", " * " };
+  if (depth == 0) {
+    printf("a");
+    return;
+  }
+  putchar('(');
+  Expr(depth - 1, cls);
+  fputs(ops[depth % 3], stdout);
+  switch (depth % 5) {
+    case 0: printf("x"); break;
+    case 1: printf("y"); break;
+    case 2: printf("b"); break;
+    case 3: printf("f%d", cls); break;
+    default: printf("%d", depth); break;
+  }
+  putchar(')');
+}
+
+static void Stmt(int depth, int level, const Knobs &k, int cls) {
+  Indent(level);
+  if (depth == 0) {
+    printf("x = ");
+    Expr(k.expr, cls);
+    printf(";\n");
+    return;
+  }
+  switch (depth % 3) {
+    case 1:
+      printf("if (x < y) {\n");
+      Stmt(depth - 1, level + 1, k, cls);
+      Indent(level);
+      printf("} else {\n");
+      Indent(level + 1);
+      printf("y = y - 1;\n");
+      Indent(level);
+      printf("}\n");
+      break;
+    case 2:
+      printf("while (x < 100) {\n");
+      Indent(level + 1);
+      printf("x = x + 1;\n");
+      Stmt(depth - 1, level + 1, k, cls);
+      Indent(level);
+      printf("}\n");
+      break;
+    default:
+      printf("for (y = 0; y < 3; y = y + 1) {\n");
+      Stmt(depth - 1, level + 1, k, cls);
+      Indent(level);
+      printf("}\n");
+      break;
+  }
+}
+
+static void Method(int cls, int m, const Knobs &k) {
+  printf("  int m%d(int a, int b) {\n", m);
+  printf("    int x;\n    int y;\n    string s;\n");
+  printf("    x = a + f%d;\n    y = b;\n", cls);
+  Stmt(k.nesting, 2, k, cls);
+  for (int i = 0; i < k.strings; i++)
+    printf("    s = \"class %d method %d string %d\";\n    Print(s);\n",
+           cls, m, i);
+  if (m > 0)
+    printf("    y = m%d(x, y);\n", m - 1);
+  printf("    return x + y;\n  }\n");
+}
+
+static void Program(const Knobs &k) {
+  for (int c = 0; c < k.classes; c++) {
+    printf("class C%d", c);
+    if (c % k.depth != 0)
+      printf(" extends C%d", c - 1);
+    printf(" {\n  int f%d;\n", c);
+    for (int m = 0; m < k.methods; m++)
+      Method(c, m, k);
+    printf("}\n\n");
+  }
+
+  printf("void main() {\n  int total;\n  total = 0;\n");
+  for (int c = 0; c < k.classes; c++) {
+    printf("  {\n    C%d o;\n    o = new C%d;\n", c, c);
+    if (k.methods > 0)
+      printf("    total = total + o.m0(%d, 2);\n", c);
+    printf("  }\n");
+  }
+  printf("  Print(total);\n}\n");
+}
+
+static void Usage() {
+  fprintf(stderr, "Usage: decafgen [-classes n] [-depth n] [-methods n] "
+          "[-nesting n] [-expr n] [-strings n]\n");
+  exit(2);
+}
+
+int main(int argc, char *argv[]) {
+  Knobs k = { 100, 4, 4, 3, 4, 2 };
+  struct { const char *name; int *value; int min; } knobs[] = {
+    { "-classes", &k.classes, 0 }, { "-depth", &k.depth, 1 },
+    { "-methods", &k.methods, 0 }, { "-nesting", &k.nesting, 0 },
+    { "-expr", &k.expr, 0 }, { "-strings", &k.strings, 0 } };
+  for (int i = 1; i < argc; i += 2) {
+    int j = 0, n = sizeof(knobs)/sizeof(knobs[0]);
+    while (j < n && strcmp(argv[i], knobs[j].name) != 0)
+      j++;
+    if (j == n || i + 1 == argc || atoi(argv[i + 1]) < knobs[j].min)
+      Usage();
+    *knobs[j].value = atoi(argv[i + 1]);
+  }
+  Program(k);
+  return 0;
+}
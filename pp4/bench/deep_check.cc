@@ -0,0 +1,115 @@
+/* File: deep_check.cc
+ * -------------------
+ * Checks that dcc compiles deeply nested programs on a small stack. It
+ * has decafgen write a program whose methods nest thousands of
+ * if/while/for statements, each body a block, around a chain of tens of
+ * thousands of operators, then limits the stack (of dcc, which inherits
+ * the limit) to well below what walking either recursively would take.
+ *
+ * The program must then compile without errors: straight to assembly,
+ * with -j 4, and to an AST file that -from-ast compiles back to the same
+ * assembly, so checking, code generation and the AST writer and loader
+ * all go down the nesting. If any of them fails, or the outputs differ,
+ * the check says so and exits with status 1.
+ *
+ * Usage: deep_check [-dcc path] [-gen path] [-nesting n] [-expr n]
+ *        (defaults ./dcc, ./decafgen, nesting 5000, expr 20000)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <string>
+using namespace std;
+
+static const rlim_t StackBytes = 1024 * 1024;
+static string errPath;  // where each command's standard error goes
+
+// Runs command and returns its standard output, or "" with *ok false
+// if it fails or writes to its standard error
+static string Run(const string &command, bool *ok) {
+  FILE *f = popen((command + " 2>" + errPath).c_str(), "r");
+  string text;
+  char buf[8192];
+  size_t n;
+  while (f != NULL && (n = fread(buf, 1, sizeof(buf), f)) > 0)
+    text.append(buf, n);
+  *ok = (f != NULL && pclose(f) == 0);
+  FILE *err = fopen(errPath.c_str(), "r");
+  if (err != NULL) {
+    *ok = *ok && getc(err) == EOF;
+    fclose(err);
+  }
+  if (!*ok)
+    fprintf(stderr, "*** deep_check: '%s' failed\n", command.c_str());
+  return *ok ? text : "";
+}
+
+int main(int argc, char *argv[]) {
+  string dcc = "./dcc", gen = "./decafgen";
+  int nesting = 5000, expr = 20000;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "-dcc") == 0) dcc = argv[i + 1];
+    else if (strcmp(argv[i], "-gen") == 0) gen = argv[i + 1];
+    else if (strcmp(argv[i], "-nesting") == 0) nesting = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "-expr") == 0) expr = atoi(argv[i + 1]);
+    else break;
+  }
+  if (argc % 2 == 0 || nesting < 1 || expr < 1) {
+    fprintf(stderr, "Usage: deep_check [-dcc path] [-gen path] "
+            "[-nesting n] [-expr n]\n");
+    return 2;
+  }
+
+  char source[] = "/tmp/deep_check_XXXXXX";
+  int fd = mkstemp(source);
+  if (fd < 0) {
+    perror("deep_check");
+    return 2;
+  }
+  close(fd);
+  string ast = string(source) + ".ast";
+  errPath = string(source) + ".err";
+  char knobs[128];
+  snprintf(knobs, sizeof(knobs), " -classes 2 -methods 1 -depth 1 "
+           "-nesting %d -expr %d -strings 0 > ", nesting, expr);
+  bool ok;
+  Run(gen + knobs + source, &ok);
+  if (!ok) {
+    unlink(source);
+    unlink(errPath.c_str());
+    return 2;
+  }
+
+  struct rlimit stack;
+  getrlimit(RLIMIT_STACK, &stack);
+  if (stack.rlim_cur == RLIM_INFINITY || stack.rlim_cur > StackBytes) {
+    stack.rlim_cur = StackBytes;
+    setrlimit(RLIMIT_STACK, &stack);
+  }
+
+  int failures = 0;
+  string code = Run(dcc + " < " + source, &ok);
+  failures += !ok || code.empty();
+  string parallel = Run(dcc + " -j 4 < " + source, &ok);
+  if (ok && parallel != code)
+    fprintf(stderr, "*** deep_check: -j 4 gave other code\n");
+  failures += !ok || parallel != code;
+  Run(dcc + " -emit-ast < " + source + " > " + ast, &ok);
+  failures += !ok;
+  string loaded = ok ? Run(dcc + " -from-ast " + ast, &ok) : "";
+  if (ok && loaded != code)
+    fprintf(stderr, "*** deep_check: -from-ast gave other code\n");
+  failures += !ok || loaded != code;
+  unlink(source);
+  unlink(ast.c_str());
+  unlink(errPath.c_str());
+
+  if (failures > 0)
+    return 1;
+  printf("nesting %d and operator chains %d long compile on a %lu KB "
+         "stack\n", nesting, expr, (unsigned long)(stack.rlim_cur / 1024));
+  return 0;
+}
@@ -0,0 +1,109 @@
+/* File: hashtable_bench.cc
+ * ------------------------
+ * Times the open-addressing Hashtable against the std::multimap table
+ * it replaced (see baselines.h) on the way a Scope uses it. For each
+ * size it enters that many members one by one, checking for a conflict
+ * first as Scope::AddDecl does, then looks up every member and as many
+ * names that are absent, ten rounds of each, and finally removes every
+ * entry. Times are per operation; the names are interned, as the
+ * scanner hands them out.
+ *
+ * Usage: hashtable_bench [numMembers ...]     (default 10000 50000 100000)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include "baselines.h"
+#include "hashtable.h"
+#include "utility.h"
+
+typedef long *Val;   // any pointer type will do as the stored value
+
+static double Now() {
+  using namespace std::chrono;
+  return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+template <class Table>
+static void RunOne(const char *label, const vector<const char*> &names,
+                   const vector<string> &missing, int rounds,
+                   double *times)
+{
+  static long cell;
+  int n = names.size();
+  Table *t = new Table;
+  long found = 0;
+
+  double start = Now();
+  for (int i = 0; i < n; i++)
+    if (t->Lookup(names[i]) == NULL)
+      t->Enter(names[i], &cell);
+  times[0] = Now() - start;
+
+  start = Now();
+  for (int r = 0; r < rounds; r++)
+    for (int i = 0; i < n; i++)
+      found += t->Lookup(names[i]) != NULL;
+  times[1] = Now() - start;
+
+  start = Now();
+  for (int r = 0; r < rounds; r++)
+    for (int i = 0; i < n; i++)
+      found += t->Lookup(missing[i].c_str()) != NULL;
+  times[2] = Now() - start;
+
+  start = Now();
+  for (int i = 0; i < n; i++)
+    t->Remove(names[i], &cell);
+  times[3] = Now() - start;
+
+  Assert(found == (long)n * rounds && t->NumEntries() == 0);
+  delete t;
+}
+
+typedef MultimapTable<Val> OldTable;
+typedef Hashtable<Val> NewTable;
+
+int main(int argc, char *argv[]) {
+  vector<int> sizes;
+  for (int i = 1; i < argc; i++)
+    sizes.push_back(atoi(argv[i]));
+  if (sizes.empty()) {
+    sizes.push_back(10000);
+    sizes.push_back(50000);
+    sizes.push_back(100000);
+  }
+
+  printf("%-8s %-10s %12s %12s %12s %12s\n", "members", "table",
+         "enter ns/op", "hit ns/op", "miss ns/op", "remove ns/op");
+
+  for (size_t s = 0; s < sizes.size(); s++) {
+    int n = sizes[s];
+    int rounds = 10;
+    char buf[32];
+    vector<const char*> names;
+    vector<string> missing;
+    for (int i = 0; i < n; i++) {
+      sprintf(buf, "member%d", i);
+      names.push_back(Symbols::Intern(buf));  // as handed out by the scanner
+      sprintf(buf, "absent%d", i);
+      missing.push_back(buf);
+    }
+
+    double told[4], tnew[4];
+    RunOne<OldTable>("multimap", names, missing, rounds, told);
+    RunOne<NewTable>("open-addr", names, missing, rounds, tnew);
+
+    double *t[2] = {told, tnew};
+    const char *label[2] = {"multimap", "open-addr"};
+    for (int k = 0; k < 2; k++)
+      printf("%-8d %-10s %12.1f %12.1f %12.1f %12.1f\n", n, label[k],
+             t[k][0] * 1e9 / n, t[k][1] * 1e9 / (n * rounds),
+             t[k][2] * 1e9 / (n * rounds), t[k][3] * 1e9 / n);
+  }
+  return 0;
+}
@@ -0,0 +1,133 @@
+/* File: list_bench.cc
+ * -------------------
+ * Times the array-backed List against the std::deque list it replaced
+ * (see baselines.h) on the two shapes of list the compiler has: one
+ * long list appended to and then walked, like the Tac a CodeGenerator
+ * collects, and a great many short ones (formals, actuals, the
+ * statements of a block), most holding no more than a few elements,
+ * built by the parser and walked by every pass. The deque list is
+ * walked with Nth, the List with its iterators.
+ *
+ * Usage: list_bench [numElements ...]     (default 100000 1000000)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <chrono>
+#include "baselines.h"
+#include "list.h"
+#include "utility.h"
+
+typedef long *Val;   // lists in the compiler hold pointers
+
+static double Now() {
+  using namespace std::chrono;
+  return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+template <class L>
+static long Sum(const L &list) {
+  long sum = 0;
+  for (int i = 0, n = list.NumElements(); i < n; i++)
+    sum += (long)list.Nth(i);
+  return sum;
+}
+
+static long Sum(const List<Val> &list) {
+  long sum = 0;
+  for (Val v : list)
+    sum += (long)v;
+  return sum;
+}
+
+/* Function: RunOne
+ * ----------------
+ * times[0]: appending n elements to one list, per element
+ * times[1]: walking it, per element per round
+ * times[2]: building n/4 lists of 0 to 7 elements, per element
+ * times[3]: walking the short lists, per element per round
+ */
+template <class L>
+static void RunOne(int n, const vector<int> &shortSizes, int rounds,
+                   double *times)
+{
+  static long cells[8];
+  long sum = 0, expect = 0;
+
+  double start = Now();
+  L *longList = new L;
+  for (int i = 0; i < n; i++)
+    longList->Append(&cells[i % 8]);
+  times[0] = Now() - start;
+
+  start = Now();
+  for (int r = 0; r < rounds; r++)
+    sum += Sum(*longList);
+  times[1] = Now() - start;
+  delete longList;
+  for (int i = 0; i < n; i++)
+    expect += (long)&cells[i % 8];
+  expect *= rounds;
+
+  int numShort = shortSizes.size(), shortElems = 0;
+  start = Now();
+  vector<L*> lists(numShort);
+  for (int i = 0; i < numShort; i++) {
+    lists[i] = new L;
+    for (int j = 0; j < shortSizes[i]; j++)
+      lists[i]->Append(&cells[j]);
+    shortElems += shortSizes[i];
+  }
+  times[2] = (Now() - start) * n / (shortElems ? shortElems : 1);
+
+  start = Now();
+  for (int r = 0; r < rounds; r++)
+    for (int i = 0; i < numShort; i++)
+      sum += Sum(*lists[i]);
+  times[3] = (Now() - start) * n / (shortElems ? shortElems : 1);
+
+  for (int i = 0; i < numShort; i++) {
+    for (int j = 0; j < shortSizes[i]; j++)
+      expect += (long)&cells[j] * rounds;
+    delete lists[i];
+  }
+  Assert(sum == expect);
+}
+
+typedef DequeList<Val> OldList;
+typedef List<Val> NewList;
+
+int main(int argc, char *argv[]) {
+  vector<int> sizes;
+  for (int i = 1; i < argc; i++)
+    sizes.push_back(atoi(argv[i]));
+  if (sizes.empty()) {
+    sizes.push_back(100000);
+    sizes.push_back(1000000);
+  }
+
+  printf("%-9s %-6s %12s %12s %12s %12s\n", "elements", "list",
+         "append ns", "walk ns", "short ns", "walk short");
+
+  for (size_t s = 0; s < sizes.size(); s++) {
+    int n = sizes[s];
+    int rounds = 10;
+    vector<int> shortSizes(n / 4);
+    srand(n);
+    for (size_t i = 0; i < shortSizes.size(); i++)
+      shortSizes[i] = rand() % 8;
+
+    double told[4], tnew[4];
+    RunOne<OldList>(n, shortSizes, rounds, told);
+    RunOne<NewList>(n, shortSizes, rounds, tnew);
+
+    double *t[2] = {told, tnew};
+    const char *label[2] = {"deque", "array"};
+    for (int k = 0; k < 2; k++)
+      printf("%-9d %-6s %12.2f %12.2f %12.2f %12.2f\n", n, label[k],
+             t[k][0] * 1e9 / n, t[k][1] * 1e9 / (n * rounds),
+             t[k][2] * 1e9 / n, t[k][3] * 1e9 / (n * rounds));
+  }
+  return 0;
+}
@@ -0,0 +1,151 @@
+/* File: server_memory.cc
+ * ----------------------
+ * Checks that a resident dcc --server (see server.h) does not grow as it
+ * serves request after request. It starts the server on a pair of
+ * pipes and sends it a program written by decafgen many times over,
+ * each time with a class of its own added, named after the request, so
+ * that every request also brings identifiers the server has not seen
+ * before. Each reply is read in full and must have no errors.
+ *
+ * The server's resident set is read from /proc after a warm-up share
+ * of the requests, once the heap has grown to what one program needs,
+ * and again after the last. Everything a program takes is released
+ * with its compilation, so the two should match; if the second is
+ * more than the limit above the first, the check says so and exits
+ * with status 1.
+ *
+ * Usage: server_memory [-dcc path] [-gen path] [-requests n] [-limit pct]
+ *        (defaults ./dcc, ./decafgen, 200 requests, limit 10%)
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <string>
+using namespace std;
+
+static const char *const GenKnobs = "-classes 40 -methods 4 -nesting 4";
+static const double WarmUpShare = 0.25;  // of the requests, before measuring
+
+static void Fail(const char *what) {
+  fprintf(stderr, "*** server_memory: %s\n", what);
+  exit(2);
+}
+
+// The output of command, or exits if it fails
+static string Run(const string &command) {
+  FILE *f = popen(command.c_str(), "r");
+  string text;
+  char buf[8192];
+  size_t n;
+  while (f != NULL && (n = fread(buf, 1, sizeof(buf), f)) > 0)
+    text.append(buf, n);
+  if (f == NULL || pclose(f) != 0)
+    Fail(("'" + command + "' failed").c_str());
+  return text;
+}
+
+// The resident set of process pid, in KB
+static long ResidentKB(pid_t pid) {
+  char path[64], line[256];
+  snprintf(path, sizeof(path), "/proc/%d/status", (int)pid);
+  FILE *f = fopen(path, "r");
+  long kb = -1;
+  while (f != NULL && fgets(line, sizeof(line), f) != NULL)
+    if (sscanf(line, "VmRSS: %ld", &kb) == 1)
+      break;
+  if (f != NULL)
+    fclose(f);
+  if (kb < 0)
+    Fail("cannot read the server's resident set from /proc");
+  return kb;
+}
+
+// Reads one reply frame, or exits if the server has gone
+static string ReadFrame(FILE *in) {
+  unsigned long len;
+  if (fscanf(in, "%lu", &len) != 1 || getc(in) != '\n')
+    Fail("the server sent a badly formed reply or quit");
+  string bytes(len, '\0');
+  if (len > 0 && fread(&bytes[0], 1, len, in) != len)
+    Fail("the server's reply ends early");
+  return bytes;
+}
+
+int main(int argc, char *argv[]) {
+  string dcc = "./dcc", gen = "./decafgen";
+  int requests = 200;
+  double limit = 10;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "-dcc") == 0) dcc = argv[i + 1];
+    else if (strcmp(argv[i], "-gen") == 0) gen = argv[i + 1];
+    else if (strcmp(argv[i], "-requests") == 0) requests = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "-limit") == 0) limit = atof(argv[i + 1]);
+    else break;
+  }
+  if (argc % 2 == 0 || requests < 4 || limit <= 0) {
+    fprintf(stderr, "Usage: server_memory [-dcc path] [-gen path] "
+            "[-requests n] [-limit pct]\n");
+    return 2;
+  }
+  string program = Run(gen + " " + GenKnobs);
+
+  int toServer[2], fromServer[2];
+  if (pipe(toServer) != 0 || pipe(fromServer) != 0)
+    Fail("cannot make pipes");
+  pid_t pid = fork();
+  if (pid < 0)
+    Fail("cannot start the server");
+  if (pid == 0) {
+    dup2(toServer[0], 0);
+    dup2(fromServer[1], 1);
+    close(toServer[1]);
+    close(fromServer[0]);
+    execl(dcc.c_str(), dcc.c_str(), "--server", (char *)NULL);
+    perror("server_memory");
+    _exit(127);
+  }
+  close(toServer[0]);
+  close(fromServer[1]);
+  signal(SIGPIPE, SIG_IGN);  // a server that quits is reported below
+  FILE *out = fdopen(toServer[1], "w"), *in = fdopen(fromServer[0], "r");
+
+  int warmUp = requests * WarmUpShare;
+  long warmKB = 0;
+  for (int r = 0; r < requests; r++) {
+    char extra[256];
+    snprintf(extra, sizeof(extra), "\nclass Request%d {\n  int field%d;\n"
+             "  int Get%d() { return field%d; }\n}\n", r, r, r, r);
+    string request = program + extra;
+    fprintf(out, "%lu\n", (unsigned long)request.size());
+    fwrite(request.data(), 1, request.size(), out);
+    if (fflush(out) != 0)
+      Fail("the server quit");
+    string code = ReadFrame(in), errors = ReadFrame(in);
+    if (code.empty() || !errors.empty()) {
+      fprintf(stderr, "%s", errors.c_str());
+      Fail("a request did not compile");
+    }
+    if (r + 1 == warmUp)
+      warmKB = ResidentKB(pid);
+  }
+  long finalKB = ResidentKB(pid);
+  fclose(out);
+  fclose(in);
+  int status;
+  waitpid(pid, &status, 0);
+
+  double growth = 100.0 * (finalKB - warmKB) / warmKB;
+  printf("server resident set after %d requests: %ld KB, after %d: %ld KB "
+         "(%+.1f%%)\n", warmUp, warmKB, requests, finalKB, growth);
+  if (growth > limit) {
+    fprintf(stderr, "*** server_memory: the server grew by %.1f%% over %d "
+            "requests (limit %.1f%%)\n", growth, requests - warmUp, limit);
+    return 1;
+  }
+  printf("server memory stays flat\n");
+  return 0;
+}
@@ -0,0 +1,208 @@
+/* File: codecache.cc
+ * ------------------
+ * Implementation of the code cache.
+ */
+
+#include "codecache.h"
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Entries are only found again by a compiler that writes this version.
+// Bump it whenever a change to the compiler changes the code generated
+// for some function.
+static const int FormatVersion = 1;
+
+static const unsigned __int128 FnvOffsetBasis =
+    ((unsigned __int128)0x6c62272e07bb0142ULL << 64) | 0x62b821756295c58dULL;
+static const unsigned __int128 FnvPrime =
+    ((unsigned __int128)0x0000000001000000ULL << 64) | 0x000000000000013BULL;
+
+static bool IsWordChar(char ch) {
+  return isalnum((unsigned char)ch) || ch == '_';
+}
+
+Hasher::Hasher() : hash(FnvOffsetBasis) {}
+
+void Hasher::Add(const char *bytes, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    hash ^= (unsigned char)bytes[i];
+    hash *= FnvPrime;
+  }
+}
+
+/* Method: AddFunctionText
+ * -----------------------
+ * The program has already been parsed, so the text is known to be well
+ * formed: comments are closed, string literals end on the line they
+ * start, and the braces balance. A run of white space and comments is
+ * added as a single space when it separates two word characters or two
+ * operator characters (keeping "a = = b" apart from "a == b"), and
+ * dropped otherwise.
+ */
+void Hasher::AddFunctionText(const char *p) {
+  int depth = 0;
+  bool inBody = false, gap = false;
+  char last = '\0';
+  while (*p != '\0' && !(inBody && depth == 0)) {
+    if (isspace((unsigned char)*p)) {
+      p++;
+      gap = true;
+    } else if (p[0] == '/' && p[1] == '/') {
+      p += strcspn(p, "\n");
+      gap = true;
+    } else if (p[0] == '/' && p[1] == '*') {
+      const char *end = strstr(p + 2, "*/");
+      p = end ? end + 2 : p + strlen(p);
+      gap = true;
+    } else {
+      const char *start = p++;
+      if (*start == '"') {
+        const char *end = strchr(p, '"');
+        p = end ? end + 1 : p + strlen(p);
+      } else if (*start == '{')
+        depth++, inBody = true;
+      else if (*start == '}')
+        depth--;
+      if (gap && last != '\0' && IsWordChar(last) == IsWordChar(*start))
+        Add(" ", 1);
+      Add(start, p - start);
+      last = p[-1];
+      gap = false;
+    }
+  }
+}
+
+string Hasher::Digest() const {
+  char hex[33];
+  snprintf(hex, sizeof(hex), "%016llx%016llx",
+           (unsigned long long)(hash >> 64), (unsigned long long)hash);
+  return hex;
+}
+
+
+CodeCache::CodeCache(const char *d) : dir(d) {
+  struct stat st;
+  if (mkdir(d, 0777) != 0 && (errno != EEXIST || stat(d, &st) != 0 ||
+                               !S_ISDIR(st.st_mode))) {
+    fprintf(stderr, "Cannot use cache directory '%s': %s\n", d,
+            errno == EEXIST ? "Not a directory" : strerror(errno));
+    exit(2);
+  }
+}
+
+// No debug key changes the code generated, except tac, which isn't
+// cached, so they don't go into the key
+string CodeCache::KeyFor(const string &depsDigest, const char *label,
+                         const char *text, bool tacComments) {
+  Hasher h;
+  char version[16];
+  h.Add(version, snprintf(version, sizeof(version), "dcc %d", FormatVersion) + 1);
+  h.Add(tacComments ? "tac" : "notac", tacComments ? 4 : 6);
+  h.Add(depsDigest);
+  h.Add(label, strlen(label) + 1);
+  h.AddFunctionText(text);
+  return h.Digest();
+}
+
+/* Method: Lookup
+ * --------------
+ * An entry is a line giving the version and the numbers of labels,
+ * temps and strings, followed by the code. A file that doesn't start
+ * that way is taken to be no entry at all.
+ */
+CachedCode *CodeCache::Lookup(const string &key) {
+  FILE *f = fopen((dir + "/" + key).c_str(), "rb");
+  if (f == NULL)
+    return NULL;
+  CachedCode *code = new CachedCode;
+  int version;
+  bool ok = (fscanf(f, "dcc-cache %d %d %d %d", &version, &code->numLabels,
+                    &code->numTemps, &code->numStrings) == 4 &&
+             version == FormatVersion && getc(f) == '\n');
+  char buf[8192];
+  size_t n;
+  while (ok && (n = fread(buf, 1, sizeof(buf), f)) > 0)
+    code->text.append(buf, n);
+  if (ferror(f))
+    ok = false;
+  fclose(f);
+  if (!ok) {
+    delete code;
+    return NULL;
+  }
+  return code;
+}
+
+/* Method: Store
+ * -------------
+ * The entry is written to a temporary file which is then renamed, so
+ * one compiler never finds another's entry half written.
+ */
+void CodeCache::Store(const string &key, const CachedCode &code) {
+  string temp = dir + "/.new-XXXXXX";
+  int fd = mkstemp(&temp[0]);
+  if (fd < 0)
+    return;
+  FILE *f = fdopen(fd, "wb");
+  if (f == NULL) {
+    close(fd);
+    unlink(temp.c_str());
+    return;
+  }
+  fprintf(f, "dcc-cache %d %d %d %d\n", FormatVersion, code.numLabels,
+          code.numTemps, code.numStrings);
+  fwrite(code.text.data(), 1, code.text.size(), f);
+  if (fclose(f) != 0 || rename(temp.c_str(), (dir + "/" + key).c_str()) != 0)
+    unlink(temp.c_str());
+}
+
+/* Method: Renumber
+ * ----------------
+ * Labels, temps and string constants are named _L<n>, _tmp<n> and
+ * _string<n>. Decaf identifiers start with a letter, so no name from
+ * the program looks like one, but the contents of a string literal can,
+ * so quoted text (which never spans a line) is left alone.
+ */
+string CodeCache::Renumber(const char *text, size_t len, int labelDelta,
+                           int tempDelta, int stringDelta) {
+  static const struct { const char *prefix; size_t len; } names[] = {
+    { "_L", 2 }, { "_tmp", 4 }, { "_string", 7 } };
+  const int deltas[] = { labelDelta, tempDelta, stringDelta };
+
+  string result;
+  result.reserve(len + len/16);
+  bool quoted = false;
+  for (size_t i = 0; i < len; ) {
+    char ch = text[i];
+    if (ch == '\n')
+      quoted = false;
+    else if (ch == '"')
+      quoted = !quoted;
+    else if (ch == '_' && !quoted && (i == 0 || !IsWordChar(text[i-1]))) {
+      bool renumbered = false;
+      for (int k = 0; k < 3 && !renumbered; k++) {
+        size_t digits = i + names[k].len, end = digits;
+        if (end > len || strncmp(text + i, names[k].prefix, names[k].len) != 0)
+          continue;
+        int num = 0;
+        for (; end < len && isdigit((unsigned char)text[end]); end++)
+          num = num*10 + (text[end] - '0');
+        if (end == digits || (end < len && IsWordChar(text[end])))
+          continue;
+        result.append(names[k].prefix);
+        result.append(std::to_string(num + deltas[k]));
+        i = end;
+        renumbered = true;
+      }
+      if (renumbered)
+        continue;
+    }
+    result += ch;
+    i++;
+  }
+  return result;
+}
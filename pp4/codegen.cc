@@ -9,45 +9,89 @@
 #include <string.h>
 #include "tac.h"
 #include "mips.h"
+#include "asmwriter.h"
+#include "compilation.h"
+#include "utility.h"
   
 CodeGenerator::CodeGenerator()
 {
   code = new List<Instruction*>();
   localOffset = OffsetToFirstLocal;
+  curFunc = NULL;
   mainDefined = false;
+  firstLabelNum = nextLabelNum = 0;
+  firstTempNum = nextTempNum = 0;
+  numStrings = 0;
+  cached = NULL;
+}
+
+// room for "_L" and any int
+static const int LabelSize = 16;
 
-    code->Append(new _Alloc);
-    code->Append(new _ReadLine);
-    code->Append(new _ReadInteger);
-    code->Append(new _StringEqual);
-    code->Append(new _PrintInt);
-    code->Append(new _PrintString);
-    code->Append(new _PrintBool);
-    code->Append(new _Halt);
+/* Method: NumberFrom
+ * ------------------
+ * The instructions share the text of the labels they name, and the
+ * Locations of the temps, so rewriting those in place renumbers the
+ * whole part.
+ */
+void CodeGenerator::NumberFrom(int labelNum, int tempNum)
+{
+  Assert(firstLabelNum == 0 && firstTempNum == 0); // numbered only once
+  for (size_t i = 0; i < labels.size(); i++)
+    snprintf(labels[i], LabelSize, "_L%d", labelNum + (int)i);
+  for (size_t i = 0; i < temps.size(); i++)
+    temps[i]->SetTempNum(tempNum + i);
+  firstLabelNum = labelNum;
+  nextLabelNum += labelNum;
+  firstTempNum = tempNum;
+  nextTempNum += tempNum;
+}
+
+void CodeGenerator::UseCachedCode(CachedCode *c)
+{
+  Assert(code->NumElements() == 0 && NumLabels() == 0 && NumTemps() == 0);
+  cached = c;
+  nextLabelNum = firstLabelNum + c->numLabels;
+  nextTempNum = firstTempNum + c->numTemps;
+  numStrings = c->numStrings;
+}
+
+void CodeGenerator::GenBuiltIns()
+{
+         // the built-in stubs are the same for every program, so they
+         // are made once, outside any arena, and shared by all code
+         // generators
+  static _Alloc alloc;
+  static _ReadLine readLine;
+  static _ReadInteger readInteger;
+  static _StringEqual stringEqual;
+  static _PrintInt printInt;
+  static _PrintString printString;
+  static _PrintBool printBool;
+  static _Halt halt;
+  static Instruction *const builtInStubs[] = {
+    &alloc, &readLine, &readInteger, &stringEqual,
+    &printInt, &printString, &printBool, &halt };
+  for (size_t i = 0; i < sizeof(builtInStubs)/sizeof(builtInStubs[0]); i++)
+    code->Append(builtInStubs[i]);
 }
 
 char *CodeGenerator::NewLabel()
 {
-  static int nextLabelNum = 0;
-  char temp[10];
-  sprintf(temp, "_L%d", nextLabelNum++);
-  return strdup(temp);
+  char *label = (char *)Arena::Current()->Allocate(LabelSize);
+  snprintf(label, LabelSize, "_L%d", nextLabelNum++);
+  labels.push_back(label);
+  return label;
 }
 
 
+// A temp is known by its number; its name is only made if the Tac is
+// printed or echoed into the assembly
 Location *CodeGenerator::GenTempVar()
 {
-  static int nextTempNum;
-  char temp[10];
-  Location *result = NULL;
-  sprintf(temp, "_tmp%d", nextTempNum++);
-  /* pp4: need to create variable in proper location
-     in stack frame for use as temporary. Until you
-     do that, the assert below will always fail to remind
-     you this needs to be implemented  */
-  result = new Location(fpRelative,localOffset,temp);
+  Location *result = new Location(localOffset, nextTempNum++);
+  temps.push_back(result);
   localOffset -=VarSize;
-  Assert(result != NULL);
   return result;
 }
 
@@ -62,6 +106,7 @@ Location *CodeGenerator::GenLoadConstant(int value)
 Location *CodeGenerator::GenLoadConstant(const char *s)
 {
   Location *result = GenTempVar();
+  numStrings++;
   code->Append(new LoadStringConstant(result, s));
   return result;
 } 
@@ -123,15 +168,39 @@ void CodeGenerator::GenReturn(Location *val)
 }
 
 
+void CodeGenerator::PushBreakLabel(const char *label)
+{
+  breakLabels.push(label);
+}
+
+void CodeGenerator::PopBreakLabel()
+{
+  Assert(!breakLabels.empty());
+  breakLabels.pop();
+}
+
+const char *CodeGenerator::GetBreakLabel()
+{
+  Assert(!breakLabels.empty()); // break outside loop is a semantic error
+  return breakLabels.top();
+}
+
+
 BeginFunc *CodeGenerator::GenBeginFunc()
 {
+  Assert(curFunc == NULL); // functions don't nest
   BeginFunc *result = new BeginFunc;
   code->Append(result);
+  curFunc = result;
+  localOffset = OffsetToFirstLocal;
   return result;
 }
 
 void CodeGenerator::GenEndFunc()
 {
+  Assert(curFunc != NULL);
+  curFunc->SetFrameSize(OffsetToFirstLocal - localOffset);
+  curFunc = NULL;
   code->Append(new EndFunc());
 }
 
@@ -201,17 +270,112 @@ void CodeGenerator::GenVTable(const char *className, List<const char *> *methodL
 }
 
 
-void CodeGenerator::DoFinalCodeGen()
+/* Method: DoFinalCodeGen
+ * -----------------------
+ * A part's string constants are numbered on from those of the parts
+ * before it, which is known up front from the Tac. The register the
+ * Mips object last chose to spill is not: it carries over from one
+ * function to the next. Translated in order, one part after another,
+ * the code goes into a single buffer that is written out whenever it
+ * fills. Translated side by side, each part goes into a buffer of its
+ * own, as if starting from the initial register, and the rare part
+ * whose translation turns out to have depended on the actual one is
+ * translated again, in order, once that is known; the buffers are then
+ * written out together.
+ */
+void CodeGenerator::DoFinalCodeGen(const vector<CodeGenerator*> &parts)
 {
+  PhaseTimer timer(FinalPhase);
+  Compilation *c = Compilation::Current();
+  FILE *out = c->out;
+  for (size_t p = 0; p < parts.size(); p++)
+    c->stats.instructions += parts[p]->code->NumElements();
   if (IsDebugOn("tac")) { // if debug don't translate to mips, just print Tac
-    for (int i = 0; i < code->NumElements(); i++)
-	code->Nth(i)->Print();
-   }  else {
-     Mips mips;
-     mips.EmitPreamble();
-     for (int i = 0; i < code->NumElements(); i++)
-	 code->Nth(i)->Emit(&mips);
+    for (size_t p = 0; p < parts.size(); p++)
+      for (Instruction *instr : *parts[p]->code)
+	instr->Print(out);
+    return;
+  }
+
+  int n = parts.size();
+  vector<int> firstStringNum(n);
+  for (int p = 0, num = 1; p < n; num += parts[p++]->numStrings)
+    firstStringNum[p] = num;
+
+  vector<int> lastUsed(n);
+  vector<char> dependsOnLastUsed(n); // not vector<bool>, whose elements share words
+  vector<int> numSpills(n);
+  auto translate = [&](int p, int startLastUsed, AsmWriter *writer) {
+    CodeGenerator *part = parts[p];
+    size_t start = writer->Length();
+    if (part->cached != NULL) {
+      string code = CodeCache::Renumber(part->cached->text.data(),
+                                        part->cached->text.size(),
+                                        part->firstLabelNum, part->firstTempNum,
+                                        firstStringNum[p] - 1);
+      writer->Write(code.data(), code.size());
+      lastUsed[p] = startLastUsed;
+      dependsOnLastUsed[p] = false;
+      numSpills[p] = 0;
+      return;
+    }
+    Mips mips(writer, firstStringNum[p], startLastUsed, c->tacComments);
+    for (Instruction *instr : *part->code)
+      instr->Emit(&mips);
+    lastUsed[p] = mips.GetLastUsed();
+    dependsOnLastUsed[p] = mips.DependsOnLastUsed();
+    numSpills[p] = mips.NumSpills();
+    if (!part->cacheKey.empty() && !dependsOnLastUsed[p]) {
+      CachedCode entry;
+      entry.numLabels = part->NumLabels();
+      entry.numTemps = part->NumTemps();
+      entry.numStrings = part->numStrings;
+      entry.text = CodeCache::Renumber(writer->Data() + start,
+                                       writer->Length() - start,
+                                       -part->firstLabelNum, -part->firstTempNum,
+                                       -(firstStringNum[p] - 1));
+      c->cache->Store(part->cacheKey, entry);
+    }
+  };
+
+  const int initial = Mips(NULL).GetLastUsed();
+  if (!c->RunsInParallel(n)) {
+    AsmWriter writer(out);
+    Mips(&writer).EmitPreamble();
+    for (int p = 0, actual = initial; p < n; p++) {
+      translate(p, actual, &writer);
+      if (dependsOnLastUsed[p])
+        actual = lastUsed[p];
+      writer.FlushIfFull();
+    }
+    writer.Flush();
+    c->stats.asmBytes += writer.BytesFlushed();
+  } else {
+    vector<AsmWriter*> text(n + 1); // the preamble, then the parts
+    text[0] = new AsmWriter;
+    Mips(text[0]).EmitPreamble();
+    c->RunInParallel(n, [&](int p) {
+      text[p + 1] = new AsmWriter;
+      translate(p, initial, text[p + 1]);
+      text[p + 1]->ShrinkToFit();
+    });
+    for (int p = 0, actual = initial; p < n; p++) {
+      if (dependsOnLastUsed[p] && actual != initial) {
+        delete text[p + 1];
+        text[p + 1] = new AsmWriter;
+        translate(p, actual, text[p + 1]);
+      }
+      if (dependsOnLastUsed[p])
+        actual = lastUsed[p];
+    }
+    AsmWriter::WriteAll(text, out);
+    for (int p = 0; p <= n; p++) {
+      c->stats.asmBytes += text[p]->Length();
+      delete text[p];
+    }
   }
+  for (int p = 0; p < n; p++)
+    c->stats.spills += numSpills[p];
 }
 
 Location *CodeGenerator::GenLocalVar(const char* name,int size) {
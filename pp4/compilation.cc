@@ -0,0 +1,217 @@
+/* File: compilation.cc
+ * --------------------
+ * Implementation of the Compilation class.
+ */
+
+#include "compilation.h"
+#include "astfile.h"
+#include "parser.h"
+#include "ast_stmt.h"
+#include "symbols.h"
+#include "threadpool.h"
+#include "utility.h"
+#include <errno.h>
+#include <sstream>
+#include <string.h>
+#include <sys/resource.h>
+
+// Handing a few tasks to other threads costs more than running them
+static const int MinParallelTasks = 16;
+
+thread_local Compilation *Compilation::current = NULL;
+thread_local ostream *Compilation::taskErr = NULL;
+
+Compilation::Compilation(SourceBuffer *src, FILE *o, ostream *e, int n)
+    : numThreads(n), pool(NULL), parseTimer(NULL), source(src), scanner(NULL),
+      globalScope(NULL), types(new TypeContext), numErrors(0), debugKeys(GetDebugKeys()),
+      out(o), err(e), cache(NULL), tacComments(true), emitAst(false),
+      astInput(NULL) {}
+
+Compilation::~Compilation() {
+    delete types;
+    delete pool;
+    for (size_t i = 0; i < poolArenas.size(); i++)
+        delete poolArenas[i];
+}
+
+static double SecondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static long PeakKB() {
+    struct rusage usage;
+    return getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss : 0;
+}
+
+void PhaseTimer::Stop() {
+    if (!running)
+        return;
+    CompileStats &stats = Compilation::Current()->stats;
+    stats.seconds[phase] += SecondsSince(start);
+    stats.peakKB[phase] = PeakKB();
+    running = false;
+}
+
+/* Method: Compile
+ * ---------------
+ * Installs this as the current compilation (along with its debug keys,
+ * symbol table and arena) and runs the parser over the source. The parse
+ * action for a whole program goes on to Translate it (see parser.y), so
+ * once yyparse returns the compilation is complete. With astInput, the
+ * tree is loaded from the AST file instead, with no scanner or parser,
+ * and the time taken counts as parsing; a damaged file is reported as
+ * an error, and nothing more is done. With -d stats, the arena usage
+ * and the number of names interned are reported before the scanner is
+ * torn down, and with -d timing, the times and counts.
+ */
+int Compilation::Compile() {
+    Assert(current == NULL);
+    current = this;
+    SymbolTable::SetCurrent(&symbols);
+    Arena::SetCurrent(&arena);
+    SetDebugKeys(&debugKeys, out);
+    globalScope = new Scope;
+    if (astInput == NULL) {
+        scanner = InitScanner(source);
+        InitParser();
+    }
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    PhaseTimer parsing(ParsePhase);
+    parseTimer = &parsing;
+    if (astInput != NULL) {
+        Program *program = astInput->Load(); // NULL if the file is damaged
+        if (program != NULL)
+            Translate(program);
+    } else
+        yyparse(scanner);
+    EndParse();
+    double total = SecondsSince(start);
+    if (scanner != NULL)
+        stats.tokens = NumTokensScanned(scanner);
+    if (IsDebugOn("timing"))
+        ReportStats(total);
+    size_t used = arena.BytesUsed(), reserved = arena.BytesReserved();
+    int blocks = arena.NumBlocks();
+    for (size_t i = 0; i < poolArenas.size(); i++) {
+        used += poolArenas[i]->BytesUsed();
+        reserved += poolArenas[i]->BytesReserved();
+        blocks += poolArenas[i]->NumBlocks();
+    }
+    PrintDebug("stats", "arena: %lu bytes used, %lu bytes reserved in %d blocks",
+               (unsigned long)used, (unsigned long)reserved, blocks);
+    PrintDebug("stats", "symbols: %d interned", symbols.NumSymbols());
+    if (scanner != NULL)
+        FreeScanner(scanner);
+    scanner = NULL;
+    SetDebugKeys(NULL, NULL);
+    Arena::SetCurrent(NULL);
+    SymbolTable::SetCurrent(NULL);
+    current = NULL;
+    return numErrors;
+}
+
+void Compilation::Translate(Program *program) {
+    if (emitAst) {
+        if (!AstFile::Write(program, source, out)) {
+            *err << "\n*** Cannot write the AST file: " << strerror(errno) << "\n\n";
+            numErrors++;
+        }
+        return;
+    }
+    if (numErrors == 0)
+        program->Check();
+    if (numErrors == 0)
+        program->Emit();
+}
+
+void Compilation::EndParse() {
+    if (parseTimer != NULL)
+        parseTimer->Stop();
+    parseTimer = NULL;
+}
+
+/* Method: ReportStats
+ * ---------------------
+ * The times and counts go to the error stream on a single line of
+ * name=value pairs, so that a script can pick them out of the
+ * diagnostics (bench/compile_bench.cc does). Times are in seconds; the
+ * peak RSS, in KB, is the whole process's, so it only describes this
+ * compilation when it is the only one the process runs.
+ */
+void Compilation::ReportStats(double totalSeconds) {
+    static const char *const phaseNames[NumPhases] =
+        { "parse", "check", "emit", "final" };
+    char line[512];
+    int len = snprintf(line, sizeof(line), "+++ (timing):");
+    for (int i = 0; i < NumPhases; i++)
+        len += snprintf(line + len, sizeof(line) - len, " %s=%.6f",
+                        phaseNames[i], stats.seconds[i]);
+    for (int i = 0; i < NumPhases; i++)
+        len += snprintf(line + len, sizeof(line) - len, " rss_%s=%ld",
+                        phaseNames[i], stats.peakKB[i]);
+    snprintf(line + len, sizeof(line) - len,
+             " total=%.6f tokens=%ld nodes=%ld scopes=%ld decls=%ld"
+             " tac=%ld spills=%ld asm_bytes=%ld\n",
+             totalSeconds, stats.tokens.load(), stats.nodes.load(),
+             stats.scopes.load(), stats.decls.load(),
+             stats.instructions.load(), stats.spills.load(),
+             stats.asmBytes.load());
+    *err << line;
+}
+
+/* Method: RunInParallel
+ * ---------------------
+ * The threads of the pool take the tasks one at a time, so a few large
+ * tasks among many small ones don't leave threads idle. While running a
+ * task, a thread of the pool other than this one works as part of this
+ * compilation, with its own arena for anything the task makes, and
+ * every task writes its errors to a buffer of its own.
+ */
+void Compilation::RunInParallel(int n, const function<void(int)> &task) {
+    if (!RunsInParallel(n)) {
+        for (int i = 0; i < n; i++)
+            task(i);
+        return;
+    }
+    if (pool == NULL) {
+        pool = new ThreadPool(numThreads);
+        for (int i = 1; i < pool->NumThreads(); i++)
+            poolArenas.push_back(new Arena);
+    }
+
+    vector<ostringstream> errors(n);
+    pool->Run(n, [&](int i) {
+        int worker = ThreadPool::WorkerIndex();
+        if (worker > 0) {
+            current = this;
+            SymbolTable::SetCurrent(&symbols);
+            Arena::SetCurrent(poolArenas[worker - 1]);
+            SetDebugKeys(&debugKeys, out);
+        }
+        taskErr = &errors[i];
+        task(i);
+        taskErr = NULL;
+        if (worker > 0) {
+            SetDebugKeys(NULL, NULL);
+            Arena::SetCurrent(NULL);
+            SymbolTable::SetCurrent(NULL);
+            current = NULL;
+        }
+    });
+
+    for (int i = 0; i < n; i++)
+        *err << errors[i].str();
+}
+
+bool Compilation::RunsInParallel(int n) const {
+    return numThreads != 1 && n >= MinParallelTasks;
+}
+
+bool Compilation::Owns(const void *p) const {
+    if (arena.Owns(p))
+        return true;
+    for (size_t i = 0; i < poolArenas.size(); i++)
+        if (poolArenas[i]->Owns(p))
+            return true;
+    return false;
+}
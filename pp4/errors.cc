@@ -11,37 +11,57 @@
 #include <stdio.h>
 using namespace std;
 #include "scanner.h" // for GetLineNumbered
+#include "compilation.h"
+#include "source.h"
 #include "ast_type.h"
 #include "ast_expr.h"
 #include "ast_stmt.h"
 #include "ast_decl.h"
 
 
-int ReportError::numErrors = 0;
+int ReportError::NumErrors() {
+    return Compilation::Current()->numErrors;
+}
 
-void ReportError::UnderlineErrorInLine(const char *line, yyltype *pos) {
+void ReportError::UnderlineErrorInLine(const char *line, int len,
+                                       int firstColumn, int lastColumn) {
     if (!line) return;
-    cerr << line << endl;
-    for (int i = 1; i <= pos->last_column; i++)
-        cerr << (i >= pos->first_column ? '^' : ' ');
-    cerr << endl;
+    ostream &err = Compilation::Current()->ErrorStream();
+    err.write(line, len) << endl;
+    for (int i = 1; i <= lastColumn; i++)
+        err << (i >= firstColumn ? '^' : ' ');
+    err << endl;
 }
 
  
  
-void ReportError::OutputError(yyltype *loc, string msg) {
-    numErrors++;
-    fflush(stdout); // make sure any buffered text has been output
-    if (loc) {
-        cerr << endl << "*** Error line " << loc->first_line << "." << endl;
-        UnderlineErrorInLine(GetLineNumbered(loc->first_line), loc);
+/* Errors go to the current compilation's error stream, which is cerr
+ * unless it is being compiled alongside others, or to the buffer of the
+ * task reporting them if it is running in parallel with others. The
+ * line is that of the first character of loc, which is underlined up
+ * to the column of its last.
+ */
+void ReportError::OutputError(SourceRange loc, string msg) {
+    Compilation *c = Compilation::Current();
+    ostream &err = c->ErrorStream();
+    c->numErrors++;
+    fflush(c->out); // make sure any buffered text has been output
+    if (loc.IsValid()) {
+        int lineNum, firstColumn, lastLine, lastColumn;
+        c->source->Position(loc.begin, &lineNum, &firstColumn);
+        c->source->Position(loc.end - 1, &lastLine, &lastColumn);
+        err << endl << "*** Error line " << lineNum << "." << endl;
+        int len;
+        const char *line = c->scanner ? GetLineNumbered(c->scanner, lineNum, &len)
+                                      : c->source->Line(lineNum, &len);
+        UnderlineErrorInLine(line, len, firstColumn, lastColumn);
     } else
-        cerr << endl << "*** Error." << endl;
-    cerr << "*** " << msg << endl << endl;
+        err << endl << "*** Error." << endl;
+    err << "*** " << msg << endl << endl;
 }
 
 
-void ReportError::Formatted(yyltype *loc, const char *format, ...) {
+void ReportError::Formatted(SourceRange loc, const char *format, ...) {
     va_list args;
     char errbuf[2048];
     
@@ -52,23 +72,23 @@ void ReportError::Formatted(yyltype *loc, const char *format, ...) {
 }
 
 void ReportError::UntermComment() {
-    OutputError(NULL, "Input ends with unterminated comment");
+    OutputError(SourceRange(), "Input ends with unterminated comment");
 }
 
 
-void ReportError::LongIdentifier(yyltype *loc, const char *ident) {
+void ReportError::LongIdentifier(SourceRange loc, const char *ident) {
     ostringstream s;
     s << "Identifier too long: \"" << ident << "\"";
     OutputError(loc, s.str());
 }
 
-void ReportError::UntermString(yyltype *loc, const char *str) {
+void ReportError::UntermString(SourceRange loc, const char *str) {
     ostringstream s;
     s << "Unterminated string constant: " << str;
     OutputError(loc, s.str());
 }
 
-void ReportError::UnrecogChar(yyltype *loc, char ch) {
+void ReportError::UnrecogChar(SourceRange loc, char ch) {
     ostringstream s;
     s << "Unrecognized char: '" << ch << "'";
     OutputError(loc, s.str());
@@ -76,8 +96,11 @@ void ReportError::UnrecogChar(yyltype *loc, char ch) {
 
 void ReportError::DeclConflict(Decl *decl, Decl *prevDecl) {
     ostringstream s;
+    int prevLine, prevColumn;
+    Compilation::Current()->source->Position(prevDecl->GetLocation().begin,
+                                             &prevLine, &prevColumn);
     s << "Declaration of '" << decl << "' here conflicts with declaration on line " 
-      << prevDecl->GetLocation()->first_line;
+      << prevLine;
     OutputError(decl->GetLocation(), s.str());
 }
   
@@ -176,7 +199,7 @@ void ReportError::BreakOutsideLoop(BreakStmt *bStmt) {
 }
   
 void ReportError::NoMainFound() {
-    OutputError(NULL, "Linker: function 'main' not defined");
+    OutputError(SourceRange(), "Linker: function 'main' not defined");
 }
   
 /**
@@ -184,12 +207,13 @@ void ReportError::NoMainFound() {
  * -------------------
  * Standard error-reporting function expected by yacc. Our version merely
  * just calls into the error reporter above, passing the location of
- * the last token read. If you want to suppress the ordinary "parse error"
+ * the last token read, which the pure parser hands us along with its
+ * scanner. If you want to suppress the ordinary "parse error"
  * message from yacc, you can implement yyerror to do nothing and
  * then call ReportError::Formatted yourself with a more descriptive 
  * message.
  */
 
-void yyerror(const char *msg) {
-    ReportError::Formatted(&yylloc, "%s", msg);
+void yyerror(yyltype *loc, yyscan_t scanner, const char *msg) {
+    ReportError::Formatted(*loc, "%s", msg);
 }
@@ -2,25 +2,150 @@
  * ------------------
  * Implementation of Hashtable class.
  */
-   
+
+#include <algorithm>
+
+
+/* Hashtable::Hash
+ * ---------------
+ * FNV-1a over the characters of the key. Keys are short identifiers,
+ * so hashing the contents is cheap and works whether or not the
+ * caller's key is interned.
+ */
+template <class Value>
+unsigned int Hashtable<Value>::Hash(const char *key)
+{
+  unsigned int h = 2166136261u;
+  for (const unsigned char *p = (const unsigned char *)key; *p; p++)
+    h = (h ^ *p) * 16777619u;
+  return h;
+}
+
+
+/* Hashtable::Find
+ * ---------------
+ * Probes linearly from the home slot of hash and returns the slot
+ * holding key, or the empty slot where key would go if it is absent.
+ * Interned keys match by pointer, others fall back on strcmp.
+ */
+template <class Value>
+typename Hashtable<Value>::Slot *Hashtable<Value>::Find(const char *key,
+                                                        unsigned int hash) const
+{
+  int mask = capacity - 1;
+  for (int i = hash & mask; ; i = (i + 1) & mask) {
+    Slot *s = &slots[i];
+    if (s->key == NULL)
+      return s;
+    if (s->hash == hash && (s->key == key || strcmp(s->key, key) == 0))
+      return s;
+  }
+}
+
+
+/* Hashtable::Grow
+ * ---------------
+ * Doubles the slot array (starting at 8) and reinserts every key.
+ * Called before the table gets more than half full, which keeps the
+ * probe sequences short.
+ */
+template <class Value>
+void Hashtable<Value>::Grow()
+{
+  Slot *old = slots;
+  int oldCapacity = capacity;
+
+  capacity = capacity ? capacity * 2 : 8;
+  slots = new Slot[capacity];
+  for (int i = 0; i < capacity; i++)
+    slots[i].key = NULL;
+
+  for (int i = 0; i < oldCapacity; i++)
+    if (old[i].key != NULL)
+      *Find(old[i].key, old[i].hash) = old[i];
+  delete[] old;
+}
+
+
+/* Hashtable::RemoveSlot
+ * ---------------------
+ * Empties slot and shifts back any later entries of the same probe run
+ * that would otherwise become unreachable, so no tombstones are needed.
+ */
+template <class Value>
+void Hashtable<Value>::RemoveSlot(Slot *slot)
+{
+  int mask = capacity - 1;
+  int hole = slot - slots;
+  delete slot->shadowed;
+  slot->key = NULL;
+  numKeys--;
+
+  for (int i = (hole + 1) & mask; slots[i].key != NULL; i = (i + 1) & mask) {
+    int home = slots[i].hash & mask;
+         // entry at i may move into the hole only if its home slot
+         // does not lie cyclically in (hole, i]
+    if ((i > hole && (home <= hole || home > i)) ||
+        (i < hole && (home <= hole && home > i))) {
+      slots[hole] = slots[i];
+      slots[i].key = NULL;
+      hole = i;
+    }
+  }
+}
+
+
+template <class Value>
+Hashtable<Value>::~Hashtable()
+{
+  for (int i = 0; i < capacity; i++)
+    if (slots[i].key != NULL)
+      delete slots[i].shadowed;
+  delete[] slots;
+}
+
 
 /* Hashtable::Enter
  * ----------------
  * Stores new value for given identifier. If the key already
  * has an entry and flag is to overwrite, will remove previous entry first,
- * otherwise it just adds another entry under same key. Copies the
- * key, so you don't have to worry about its allocation.
+ * otherwise it just adds another entry under same key. Stores the
+ * interned copy of the key, so you don't have to worry about its
+ * allocation.
  */
-template <class Value> 
+template <class Value>
 void Hashtable<Value>::Enter(const char *key, Value val, bool overwrite)
 {
-  Value prev;
-  if (overwrite && (prev = Lookup(key)))
-    Remove(key, prev);
-  mmap.insert(make_pair(strdup(key), val));
+  if (2 * (numKeys + 1) > capacity)
+    Grow();
+
+  unsigned int hash = Hash(key);
+  Slot *s = Find(key, hash);
+  if (overwrite && s->key != NULL && s->value != NULL) {
+    if (s->shadowed == NULL) { // only one entry, just replace its value
+      s->value = val;
+      return;
+    }
+    Remove(key, s->value);
+    s = Find(key, hash);
+  }
+
+  if (s->key == NULL) {
+    s->key = Symbols::Intern(key);
+    s->hash = hash;
+    s->value = val;
+    s->shadowed = NULL;
+    numKeys++;
+  } else {
+    if (s->shadowed == NULL)
+      s->shadowed = new vector<Value>;
+    s->shadowed->push_back(s->value);
+    s->value = val;
+  }
+  numEntries++;
 }
 
- 
+
 /* Hashtable::Remove
  * -----------------
  * Removes a given key-value pair from table. If no such pair, no
@@ -28,64 +153,91 @@ void Hashtable<Value>::Enter(const char *key, Value val, bool overwrite)
  */
 template <class Value> void Hashtable<Value>::Remove(const char *key, Value val)
 {
-  if (mmap.count(key) == 0) // no matches at all
+  if (numKeys == 0)
     return;
 
-  typename multimap<const char *, Value>::iterator itr;
-  itr = mmap.find(key); // start at first occurrence
-  while (itr != mmap.upper_bound(key)) {
-    if (itr->second == val) { // iterate to find matching pair
-	mmap.erase(itr);
-	break;
+  Slot *s = Find(key, Hash(key));
+  if (s->key == NULL) // no matches at all
+    return;
+
+  vector<Value> *older = s->shadowed;
+  if (older != NULL) {
+    for (size_t i = 0; i < older->size(); i++) {
+      if ((*older)[i] == val) { // oldest matching pair goes first
+        older->erase(older->begin() + i);
+        numEntries--;
+        return;
+      }
     }
-    ++itr;
   }
-} 
+  if (s->value != val)
+    return;
+
+  numEntries--;
+  if (older != NULL && !older->empty()) {
+    s->value = older->back();
+    older->pop_back();
+  } else {
+    RemoveSlot(s);
+  }
+}
 
 /* Hashtable::Lookup
  * -----------------
  * Returns the value earlier stored under key or NULL
  *if there is no matching entry
  */
-template <class Value> 
-Value Hashtable<Value>::Lookup(const char *key) 
+template <class Value>
+Value Hashtable<Value>::Lookup(const char *key)
 {
-  Value found = NULL;
-  
-  if (mmap.count(key) > 0) {
-    typename multimap<const char *, Value>::iterator cur, last, prev;
-    cur = mmap.find(key); // start at first occurrence
-    last = mmap.upper_bound(key);
-    while (cur != last) { // iterate to find last entered
-	prev = cur; 
-	if (++cur == mmap.upper_bound(key)) { // have to go one too far
-	  found = prev->second; // one before last was it
-	  break;
-	}
-    }
-  }
-  return found;
+  if (numKeys == 0)
+    return NULL;
+
+  Slot *s = Find(key, Hash(key));
+  return s->key == NULL ? NULL : s->value;
 }
 
 
 /* Hashtable::NumEntries
  * ---------------------
  */
-template <class Value> 
+template <class Value>
 int Hashtable<Value>::NumEntries() const
 {
-  return mmap.size();
+  return numEntries;
 }
 
 
 /* Hashtable:GetIterator
  * ---------------------
  * Returns iterator which can be used to walk through all values in table.
+ * The occupied slots are sorted by key so the walk is alphabetical, and
+ * within a key values come out in the order they were entered.
  */
-template <class Value> 
-Iterator<Value> Hashtable<Value>::GetIterator() 
+template <class Value>
+Iterator<Value> Hashtable<Value>::GetIterator()
 {
-  return Iterator<Value>(mmap);
+  vector<Slot*> used;
+  used.reserve(numKeys);
+  for (int i = 0; i < capacity; i++)
+    if (slots[i].key != NULL)
+      used.push_back(&slots[i]);
+
+  struct ByKey {
+    bool operator()(const Slot *a, const Slot *b) const
+    { return strcmp(a->key, b->key) < 0; }
+  };
+  sort(used.begin(), used.end(), ByKey());
+
+  Iterator<Value> iter;
+  iter.values.reserve(numEntries);
+  for (size_t i = 0; i < used.size(); i++) {
+    if (used[i]->shadowed != NULL)
+      iter.values.insert(iter.values.end(), used[i]->shadowed->begin(),
+                         used[i]->shadowed->end());
+    iter.values.push_back(used[i]->value);
+  }
+  return iter;
 }
 
 
@@ -94,10 +246,9 @@ Iterator<Value> Hashtable<Value>::GetIterator()
  * Iterator method used to return current value and advance iterator
  * to next entry. Returns null if no more values exist.
  */
-template <class Value> 
+template <class Value>
 Value Iterator<Value>::GetNextValue()
 {
-  return (cur == end ? NULL : (*cur++).second);
+  return (cur == values.size() ? NULL : values[cur++]);
 }
 
-
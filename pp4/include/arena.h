@@ -0,0 +1,124 @@
+/* File: arena.h
+ * -------------
+ * The Arena class is a simple bump-pointer allocator used to own the
+ * parse tree. Memory is grabbed from the heap in large blocks and
+ * handed out sequentially, so allocating a node is just a pointer
+ * increment and nodes built one after another end up next to each
+ * other in memory. Individual allocations are never freed, instead
+ * the whole arena is released in one operation once the compiler is
+ * done with the tree.
+ *
+ * Objects placed in the arena do not have their destructors run when
+ * the arena is freed, unless they are registered with DestroyOnFree.
+ * A class deriving from InArena (below) has all its objects placed in
+ * the current arena, and registered if they need destroying, so that
+ * everything a compilation makes goes when its arena does.
+ */
+
+#ifndef _H_arena
+#define _H_arena
+
+#include <stddef.h>
+#include <new>
+#include <type_traits>
+
+class Arena {
+  private:
+    struct Block {
+        Block *next;
+        size_t size, used;
+        char *Data();
+    };
+
+    // An object to destroy before the blocks are released, kept in the
+    // arena itself
+    struct Cleanup {
+        void (*destroy)(void *object);
+        void *object;
+        Cleanup *next;
+    };
+
+    static thread_local Arena *current;
+
+    Block *blocks;             // most recently allocated block first
+    size_t blockSize;
+    size_t bytesUsed;          // total bytes handed out to callers
+    Cleanup *cleanups;         // most recently registered first
+
+    Block *NewBlock(size_t minSize);
+
+    template <class T> static void Destroy(void *object)
+        { static_cast<T*>(object)->~T(); }
+
+  public:
+    static const size_t DefaultBlockSize = 64*1024;
+    static const size_t Alignment = 16;
+
+    Arena(size_t blockSize = DefaultBlockSize);
+    ~Arena() { Free(); }
+
+         // Returns a pointer to bytes of fresh memory, aligned suitably
+         // for any type. Never returns NULL (calls Failure on exhaustion).
+    void *Allocate(size_t bytes);
+
+         // Copies the null-terminated string str into the arena
+    char *Strdup(const char *str);
+
+         // Returns true if p points into memory handed out by this arena
+    bool Owns(const void *p) const;
+
+         // Has the destructor of object, which must be in the arena,
+         // run when the arena is freed
+    template <class T> void DestroyOnFree(T *object) {
+        Cleanup *c = static_cast<Cleanup*>(Allocate(sizeof(Cleanup)));
+        c->destroy = &Destroy<T>;
+        c->object = object;
+        c->next = cleanups;
+        cleanups = c;
+    }
+
+         // Destroys the registered objects, the most recent first, then
+         // releases every block at once. All pointers previously
+         // returned by Allocate/Strdup become invalid.
+    void Free();
+
+         // The arena the calling thread places InArena objects in, NULL
+         // for none (see Compilation::Compile)
+    static Arena *Current()               { return current; }
+    static void SetCurrent(Arena *arena)  { current = arena; }
+
+    size_t BytesUsed() const     { return bytesUsed; }
+    size_t BytesReserved() const;
+    int NumBlocks() const;
+};
+
+/* Class: InArena
+ * --------------
+ * Deriving class T from InArena<T> places the objects made with new in
+ * the current arena, if there is one, and on the heap otherwise. One in
+ * an arena is destroyed when the arena is freed (if T's destructor does
+ * anything), so it must never be deleted; delete only frees those on
+ * the heap. A class deriving from T shares its operator new, so any of
+ * them that owns resources must be destroyed through a virtual
+ * destructor of T.
+ */
+template <class T> class InArena {
+  public:
+    static void *operator new(size_t size) {
+        Arena *arena = Arena::Current();
+        if (arena == NULL)
+            return ::operator new(size);
+        void *p = arena->Allocate(size);
+        if (!std::is_trivially_destructible<T>::value)
+            arena->DestroyOnFree(static_cast<T*>(p));
+        return p;
+    }
+
+    static void operator delete(void *p) {
+        Arena *arena = Arena::Current();
+        if (p && !(arena && arena->Owns(p)))
+            ::operator delete(p);
+    }
+};
+
+#endif
@@ -0,0 +1,66 @@
+/* File: asmwriter.h
+ * -----------------
+ * An AsmWriter collects generated assembly in a buffer of its own,
+ * which grows as needed and is reused once written out, so the Mips
+ * translator appends each line with a single formatting call and the
+ * text reaches the output file in a few large writes rather than a few
+ * small ones per line. When the output has a file descriptor (a file
+ * given with -o, or stdout) the buffers are handed to writev directly;
+ * otherwise (an in-memory stream, as the server uses) they go through
+ * fwrite.
+ */
+
+#ifndef _H_asmwriter
+#define _H_asmwriter
+
+#include <stdio.h>
+#include <vector>
+using std::vector;
+
+class AsmWriter {
+  private:
+    char *buf;
+    size_t length, capacity;
+    FILE *out;                 // where Flush writes, NULL if nowhere
+    size_t bytesFlushed;
+
+  public:
+    static const size_t FlushSize = 1 << 20; // see FlushIfFull
+
+         // Makes an empty buffer whose contents Flush writes to out
+    AsmWriter(FILE *out = NULL);
+    ~AsmWriter();
+
+    const char *Data() const    { return buf; }
+    size_t Length() const       { return length; }
+
+         // The number of bytes Flush has passed on to out so far
+    size_t BytesFlushed() const { return bytesFlushed; }
+
+    void Write(const char *bytes, size_t len);
+
+         // Returns room for at least len more bytes at the end of the
+         // buffer, to be filled and then added with Commit
+    char *Reserve(size_t len);
+    void Commit(size_t len)     { length += len; }
+
+         // Gives back the room left at the end of the buffer, for one
+         // that is held on to until later
+    void ShrinkToFit();
+
+         // Writes the contents to out and empties the buffer, keeping
+         // its memory for what comes next. FlushIfFull only does so
+         // once it holds FlushSize bytes or more.
+    void Flush();
+    void FlushIfFull()          { if (length >= FlushSize) Flush(); }
+
+         // Writes the contents of each writer in turn to out, and
+         // returns the number of bytes written
+    static size_t WriteAll(const vector<AsmWriter*> &writers, FILE *out);
+
+  private:
+    AsmWriter(const AsmWriter&);            // writers are not copied
+    AsmWriter& operator=(const AsmWriter&);
+};
+
+#endif
@@ -7,10 +7,12 @@
  * more correctly, of instances of concrete subclassses such as VarDecl,
  * ForStmt, and AssignExpr).
  * 
- * Location: Each node maintains its lexical location (line and columns in 
- * file), that location can be NULL for those nodes that don't care/use 
- * locations. The location is typcially set by the node constructor.  The 
- * location is used to provide the context when reporting semantic errors.
+ * Location: Each node maintains its lexical location, as the range of
+ * offsets in the source it was parsed from (see location.h), which is
+ * invalid for those nodes that don't care/use locations. The location
+ * is typcially set by the node constructor.  The location is used to
+ * provide the context when reporting semantic errors, which is when
+ * the line and columns are worked out from it.
  *
  * Parent: Each node has a pointer to its parent. For a Program node, the 
  * parent is NULL, for all other nodes it is the pointer to the node one level
@@ -20,6 +22,13 @@
  * set up links in both directions. The parent link is typically not used 
  * during parsing, but is more important in later phases.
  *
+ * Memory: While a program is being compiled, every node is carved out
+ * of the arena of the current Compilation (see compilation.h) rather
+ * than allocated individually on the heap. Nodes are never deleted one
+ * at a time; the whole tree goes away with the compilation. Nodes
+ * created outside of any compilation (e.g. the static built-in types)
+ * come from the ordinary heap.
+ *
  * Semantic analysis: For pp3 you are adding "Check" behavior to the ast
  * node classes. Your semantic analyzer should do an inorder walk on the
  * parse tree, and when visiting each node, verify the particular
@@ -32,37 +41,87 @@
 
 #include <stdlib.h>   // for NULL
 #include "location.h"
+#include "utility.h"  // for Assert()
 #include <iostream>
 using namespace std;
 class Scope;
+class Decl;
+class AstWriter;
+
+// The kinds of node. Every node is tagged with its kind when made, which
+// is what isa and dyn_cast below test and what a Visitor (see
+// ast_visitor.h) switches on. The kinds of an abstract class's
+// subclasses are kept together, so that its classof is a range test.
+// The kinds are also written to AST files (see astfile.h), where a list
+// of nodes is a node of its own, so the numbering is part of the file
+// format: new kinds go at the end, with a new format version. An Error
+// is never written, and its kind not counted as part of the format.
+enum NodeKind {
+    ListNode, ProgramNode, IdentifierNode, OperatorNode,
+    BuiltInTypeNode, NamedTypeNode, ArrayTypeNode,
+    VarDeclNode, ClassDeclNode, InterfaceDeclNode, FnDeclNode,
+    StmtBlockNode, ForStmtNode, WhileStmtNode, IfStmtNode,
+    BreakStmtNode, ReturnStmtNode, PrintStmtNode,
+    EmptyExprNode, IntConstantNode, DoubleConstantNode, BoolConstantNode,
+    StringConstantNode, NullConstantNode,
+    ArithmeticExprNode, RelationalExprNode, EqualityExprNode,
+    LogicalExprNode, AssignExprNode,
+    ThisNode, ArrayAccessNode, FieldAccessNode, CallNode,
+    NewExprNode, NewArrayExprNode, ReadIntegerExprNode, ReadLineExprNode,
+    ErrorNode,
+    NumNodeKinds
+};
+
 class Node  {
   protected:
-    yyltype *location;
+    SourceRange location;
     Node *parent;
     Scope *scope;
+    const NodeKind kind;
   public:
-    Node(yyltype loc);
-    Node();
+    Node(NodeKind kind, SourceRange loc);
+    Node(NodeKind kind);
     virtual ~Node() {}
+
+    static void *operator new(size_t size);
+    static void operator delete(void *p);
     virtual Scope *GetScope()        { return scope; }
-    yyltype *GetLocation()   { return location; }
-    void SetParent(Node *p)  { parent = p; }
+    SourceRange GetLocation() { return location; }
+         // The built-in types are shared by all the programs being
+         // compiled, on whatever threads, so they are never given one
+    void SetParent(Node *p)  { if (kind != BuiltInTypeNode) parent = p; }
     Node *GetParent()        { return parent; }
     Node* GetNode()             {return this;}
+    NodeKind GetKind() const { return kind; }
+
+         // Adds the node to an AST file, after its children, and
+         // returns its index there
+    virtual int Write(AstWriter *out) = 0;
 };
    
 
+// The name of an Identifier is an interned symbol (see symbols.h), so
+// two identifiers spell the same name exactly when their name pointers
+// are equal. For identifiers that refer to a declaration (a variable,
+// function or type name being used), the resolution pass records the
+// Decl the name is bound to in the enclosing lexical scopes, or NULL if
+// there is none.
 class Identifier : public Node 
 {
   protected:
-    char *name;
+    const char *name;
+    Decl *decl;
     
   public:
-    char* GetName() {return name;}
-    char* Name() {return name;}
-    bool operator==(const Identifier &rhs);
-    Identifier(yyltype loc, const char *name);
+    const char* GetName() {return name;}
+    const char* Name() {return name;}
+    Decl* GetDecl() {return decl;}
+    void SetDecl(Decl *d) {decl = d;}
+    bool operator==(const Identifier &rhs) { return name == rhs.name; }
+    Identifier(SourceRange loc, const char *internedName);
+    static bool classof(const Node *n) { return n->GetKind() == IdentifierNode; }
     friend ostream& operator<<(ostream& out, Identifier *id) { return out << id->name; }
+    int Write(AstWriter *out) override;
 };
 
 
@@ -74,9 +133,35 @@ class Identifier : public Node
 class Error : public Node
 {
   public:
-    Error() : Node() {}
+    Error() : Node(ErrorNode) {}
+    static bool classof(const Node *n) { return n->GetKind() == ErrorNode; }
+    int Write(AstWriter *out) override; // never written, see astfile.h
 };
 
 
+/* Kind tests
+ * ----------
+ * In place of dynamic_cast, which has to search the class hierarchy at
+ * run time, a node's class is told from its kind. Each node class has a
+ * static classof saying whether a node of the given kind is one of its
+ * instances, and these use it: isa<T>(n) is whether n is a T,
+ * dyn_cast<T>(n) is n as a T, or NULL if it isn't one, and cast<T>(n)
+ * is n as a T when it is known to be one. isa and dyn_cast take NULL,
+ * as dynamic_cast does, and say it is no T.
+ */
+template <class T> inline bool isa(const Node *n) {
+    return n != NULL && T::classof(n);
+}
+
+template <class T, class From> inline T *dyn_cast(From *n) {
+    return isa<T>(n) ? static_cast<T*>(n) : NULL;
+}
+
+template <class T, class From> inline T *cast(From *n) {
+    Assert(isa<T>(n));
+    return static_cast<T*>(n);
+}
+
+
 
 #endif
@@ -17,10 +17,12 @@
 #include "list.h"
 #include "ast_stmt.h"
 #include "ast_type.h"
+#include <vector>
 class Type;
 class Identifier;
 class Stmt;
 class InterfaceDecl;
+class FnDecl;
 
 class Decl : public Node 
 {
@@ -28,20 +30,23 @@ class Decl : public Node
     Identifier *id;
 
   public:
-    Decl(Identifier *name);
+    Decl(NodeKind kind, Identifier *name);
+    static bool classof(const Node *n) {
+        return n->GetKind() >= VarDeclNode && n->GetKind() <= FnDeclNode;
+    }
     friend ostream& operator<<(ostream& out, Decl *d) { return out << d->id; }
 
     virtual bool IsEquivalentTo(Decl *other);
 
-    char* GetName() {return id->GetName();}
+    const char* GetName() {return id->GetName();}
 
 
     virtual void BuildScope();
+    virtual void Resolve(Resolver *r) {}
     virtual void Check()=0;
     virtual void PreEmit() = 0;
     virtual Location* Emit(CodeGenerator *cg) = 0;
     virtual int GetMemBytes()=0;
-    virtual int GetVTblBytes()=0;
     virtual  void AddLabelPrefix(const char *prefix)=0;
 
 };
@@ -54,12 +59,13 @@ class VarDecl : public Decl
     int memOffset;
   public:
     VarDecl(Identifier *name, Type *type);
+    static bool classof(const Node *n) { return n->GetKind() == VarDeclNode; }
     Type* GetType() {return type;}
 
+    void Resolve(Resolver *r) override;
     void PreEmit() override {};
     Location *Emit(CodeGenerator *cg) override {return nullptr;};
     int GetMemBytes() override;
-    int GetVTblBytes() override {return 0;};
     void AddLabelPrefix(const char *prefix) override {};
     bool IsEquivalentTo(Decl* other) override ;
 
@@ -69,36 +75,55 @@ class VarDecl : public Decl
     void SetMemOffset(int m) {memOffset=m;}
 
     void Check() override ;
+    int Write(AstWriter *out) override;
 
   private:
     void CheckType();
 };
 
+// The run-time layout of a class's objects and vtable. It is worked out
+// once per class, on top of the superclass's layout, and not changed
+// afterwards. An object holds its vtable pointer followed by the fields,
+// inherited ones first.
+class ClassLayout : public InArena<ClassLayout>
+{
+  public:
+    vector<VarDecl*> fields;   // every field, in order of offset
+    vector<FnDecl*> vtable;    // the method in each vtable slot
+    int memBytes;              // size of the fields (vtable pointer excluded)
+
+    ClassLayout() : memBytes(0) {}
+};
+
 class ClassDecl : public Decl 
 {
   protected:
     List<Decl*> *members;
     NamedType *extends;
     List<NamedType*> *implements;
+    ClassLayout *layout;       // NULL until GetLayout
+    NamedType *type;           // the class as a type, shared by all uses
 
   public:
     ClassDecl(Identifier *name, NamedType *extends, 
               List<NamedType*> *implements, List<Decl*> *members);
+    static bool classof(const Node *n) { return n->GetKind() == ClassDeclNode; }
 
     void BuildScope() override ;
+    void Resolve(Resolver *r) override ;
     void Check() override ;
 
-    NamedType* GetType() {return new NamedType(id);}
+    NamedType* GetType() {return type;}
     NamedType* GetExtends() {return extends;}
     List<NamedType*>* GetImplements() {return implements;}
+    List<Decl*>* GetMembers() {return members;}
 
     void PreEmit() override ;
     Location* Emit(CodeGenerator *cg) override ;
     int GetMemBytes() override ;
-    int GetVTblBytes() override;
     void AddLabelPrefix(const char* prefix) override {}
-
-
+    ClassLayout* GetLayout();
+    int Write(AstWriter *out) override;
 
   private:
     void CheckExtends();
@@ -108,26 +133,28 @@ class ClassDecl : public Decl
     void CheckImplementedMembers(NamedType *impType);
     void CheckAgainstScope(Scope *other);
     void CheckImplementsInterfaces();
-    List<FnDecl*>* GetMethodDecls();
 };
 
 class InterfaceDecl : public Decl 
 {
   protected:
     List<Decl*> *members;
+    NamedType *type;
     
   public:
     InterfaceDecl(Identifier *name, List<Decl*> *members);
+    static bool classof(const Node *n) { return n->GetKind() == InterfaceDeclNode; }
 
     void BuildScope() override ;
+    void Resolve(Resolver *r) override ;
     void Check() override ;
     void PreEmit() override {}
     Location* Emit(CodeGenerator *cg) override {return nullptr;}
     int GetMemBytes() override {return 0;}
-    int GetVTblBytes() override {return 0;}
     void AddLabelPrefix(const char *prefix) override {}
-    Type* GetType() {return new NamedType(id);}
+    Type* GetType() {return type;}
     List<Decl*>* GetMembers() {return members;}
+    int Write(AstWriter *out) override;
 };
 
 class FnDecl : public Decl 
@@ -136,28 +163,39 @@ class FnDecl : public Decl
     List<VarDecl*> *formals;
     Type *returnType;
     Stmt *body;
-    std::string *label;
+    const char *label;         // interned
     int vtlOffset;
     bool isMethod;
+    List<Decl*> *uses;
   public:
     FnDecl(Identifier *name, Type *returnType, List<VarDecl*> *formals);
+    static bool classof(const Node *n) { return n->GetKind() == FnDeclNode; }
     const char* GetLabel();
     void SetFunctionBody(Stmt *b);
     bool IsEquivalentTo(Decl *other) override ;
     Type* GetReturnType() {return returnType;}
     List<VarDecl*>* GetFormals() {return formals;}
     void BuildScope() override;
+    void Resolve(Resolver *r) override;
     void Check() override;
     void PreEmit() override;
     Location* Emit(CodeGenerator *cg) override;
     int GetMemBytes()  override {return 0;}
-    int GetVTblBytes() override;
     void AddLabelPrefix(const char *prefix) override ;
     int  GetVTblOffset() {return vtlOffset;}
     void SetVTblOffset(int v) {vtlOffset = v;}
     void SetIsMethod(bool b) {isMethod = b;}
     Type* GetType() { return returnType; }
     bool HasReturnVal();
+    int Write(AstWriter *out) override;
+
+         // The source text of the declaration, from its name on
+    const char* GetSourceText();
+
+         // The globals, functions, classes and interfaces the body
+         // names (a member stands for its class), in the order first
+         // named; recorded only with a code cache (see Resolver::Use)
+    List<Decl*>* GetUses() {return uses;}
 
 };
 
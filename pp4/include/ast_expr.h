@@ -23,26 +23,41 @@ class Type; // for NewArray
 class FnDecl;
 class ClassDecl;
 
+// GetType is asked for repeatedly (by the parent's Check, then again
+// while emitting), so the type is worked out by ComputeType the first
+// time, which is when Check visits the expression bottom-up, and the
+// cached result is returned from then on.
+//
+// Expressions declare nothing, so BuildScope has nothing to do in them.
 class Expr : public Stmt 
 {
-  public:
-    Expr(yyltype loc) : Stmt(loc) {}
-    Expr() : Stmt() {}
+  protected:
+    Type *type;         // NULL until computed
 
-    virtual Type* GetType()=0;
-    virtual void BuildScope() override {};
+  public:
+    Expr(NodeKind k, SourceRange loc) : Stmt(k, loc), type(NULL) {}
+    Expr(NodeKind k) : Stmt(k), type(NULL) {}
+    static bool classof(const Node *n) {
+        return n->GetKind() >= EmptyExprNode && n->GetKind() <= ReadLineExprNode;
+    }
+
+    Type* GetType() {if (type == NULL) CacheType(); return type;}
+    virtual Type* ComputeType()=0;
+    void BuildScope() override {};
     void Check() override {};
     virtual Location *Emit(CodeGenerator *cg) {  };
-    virtual int GetMemBytes() = 0;
 
 protected:
 
-        ClassDecl* GetClassDecl();
+        ClassDecl* GetClassDecl() {return classDecl;}
         Location* GetThisLoc();
         Decl* GetFieldDecl(Identifier *field,Type *base);
         Decl* GetFieldDeclInOneNode(Identifier *f, Type *b);
-        Decl* GetFieldDecl(Identifier *field, Node *n);
+        Decl* GetFieldDecl(Identifier *field, Decl *d);
         Decl* GetFieldDecl(Identifier *field, Expr *e);
+
+private:
+        void CacheType();
 };
 
 /* This node type is used for those places where an expression is optional.
@@ -51,10 +66,13 @@ protected:
 class EmptyExpr : public Expr
 {
   public:
-    Type* GetType() override  {return nullptr;}
+    EmptyExpr() : Expr(EmptyExprNode) {}
+    static bool classof(const Node *n) { return n->GetKind() == EmptyExprNode; }
+
+    Type* ComputeType() override  {return nullptr;}
     void  Check() override {}
     Location *Emit(CodeGenerator *cg) override {return nullptr;}
-    int GetMemBytes() override {return 0;}
+    int Write(AstWriter *out) override;
 };
 
 class IntConstant : public Expr 
@@ -63,12 +81,13 @@ class IntConstant : public Expr
     int value;
   
   public:
-    IntConstant(yyltype loc, int val);
+    IntConstant(SourceRange loc, int val);
+    static bool classof(const Node *n) { return n->GetKind() == IntConstantNode; }
 
-    Type* GetType() override ;
+    Type* ComputeType() override ;
     void Check() override {}
     Location *Emit(CodeGenerator *cg) override ;
-    int GetMemBytes() override ;
+    int Write(AstWriter *out) override;
 };
 
 class DoubleConstant : public Expr 
@@ -77,12 +96,13 @@ class DoubleConstant : public Expr
     double value;
     
   public:
-    DoubleConstant(yyltype loc, double val);
+    DoubleConstant(SourceRange loc, double val);
+    static bool classof(const Node *n) { return n->GetKind() == DoubleConstantNode; }
 
-    Type* GetType() override ;
+    Type* ComputeType() override ;
     void Check() override {}
     Location *Emit(CodeGenerator *cg) override ;
-    int GetMemBytes() override ;
+    int Write(AstWriter *out) override;
 };
 
 class BoolConstant : public Expr 
@@ -91,12 +111,13 @@ class BoolConstant : public Expr
     bool value;
     
   public:
-    BoolConstant(yyltype loc, bool val);
+    BoolConstant(SourceRange loc, bool val);
+    static bool classof(const Node *n) { return n->GetKind() == BoolConstantNode; }
 
-    Type* GetType() override ;
+    Type* ComputeType() override ;
     void Check() override {}
     Location *Emit(CodeGenerator *cg) override ;
-    int GetMemBytes() override ;
+    int Write(AstWriter *out) override;
 };
 
 class StringConstant : public Expr 
@@ -105,21 +126,23 @@ class StringConstant : public Expr
     char *value;
     
   public:
-    StringConstant(yyltype loc, const char *val);
-    Type* GetType() override ;
+    StringConstant(SourceRange loc, const char *val);
+    static bool classof(const Node *n) { return n->GetKind() == StringConstantNode; }
+    Type* ComputeType() override ;
     void Check() {}
     Location *Emit(CodeGenerator *cg) override ;
-    int GetMemBytes() override ;
+    int Write(AstWriter *out) override;
 };
 
 class NullConstant: public Expr 
 {
   public: 
-    NullConstant(yyltype loc) : Expr(loc) {}
-    Type* GetType() override ;
+    NullConstant(SourceRange loc) : Expr(NullConstantNode, loc) {}
+    static bool classof(const Node *n) { return n->GetKind() == NullConstantNode; }
+    Type* ComputeType() override ;
     void Check() override  {}
     Location *Emit(CodeGenerator *cg) override;
-    int GetMemBytes() override ;
+    int Write(AstWriter *out) override;
 };
 
 class Operator : public Node 
@@ -128,147 +151,192 @@ class Operator : public Node
     char tokenString[4];
     
   public:
-    Operator(yyltype loc, const char *tok);
+    Operator(SourceRange loc, const char *tok);
+    static bool classof(const Node *n) { return n->GetKind() == OperatorNode; }
     friend ostream& operator<<(ostream& out, Operator *o) { return out << o->tokenString; }
 
     const char *GetTokenString() { return tokenString; }
+    int Write(AstWriter *out) override;
 };
  
+// A chain of operations like a+b+c+..., nested down the left operands,
+// can be longer than recursing through it on the C++ stack allows, so
+// the passes over an operation work down such a chain in a loop (see
+// ast_expr.cc). Check and Emit do that with the parts of the operation
+// that come after its left operand: CheckOperation, which checks the
+// right operand and then the operator, and EmitAfterLeft, given the
+// left operand's value and what EmitBeforeLeft saved for it in an
+// Emitted. EmitLeft is the left operand's code, where that is not
+// another operation in the chain.
 class CompoundExpr : public Expr
 {
   protected:
     Operator *op;
     Expr *left, *right; // left will be NULL if unary
+
+    struct Emitted {
+        Location *temp;
+        const char *labels[2];
+    };
     
   public:
-    CompoundExpr(Expr *lhs, Operator *op, Expr *rhs); // for binary
-    CompoundExpr(Operator *op, Expr *rhs);             // for unary
-    void BuildScope() override;
+    CompoundExpr(NodeKind k, Expr *lhs, Operator *op, Expr *rhs); // for binary
+    CompoundExpr(NodeKind k, Operator *op, Expr *rhs);             // for unary
+    static bool classof(const Node *n) {
+        return n->GetKind() >= ArithmeticExprNode && n->GetKind() <= AssignExprNode;
+    }
+    void Resolve(Resolver *r) override;
 
     void Check() override;
 
-    Type* GetType() override = 0;
-    Location* Emit(CodeGenerator *cg) override = 0;
-    int GetMemBytes() override = 0;
+    Type* ComputeType() override = 0;
+    Location* Emit(CodeGenerator *cg) override;
+
+         // Writes the operands and operator as the children, with
+         // NoIndex for a unary operation's left operand
+    int Write(AstWriter *out) override;
+
+    Expr* GetLeft() {return left;}
+
+  protected:
+    virtual void CheckOperation() = 0;
+
+    virtual void EmitBeforeLeft(CodeGenerator *cg, Emitted *e) {}
+    virtual Location* EmitLeft(CodeGenerator *cg) {return left->Emit(cg);}
+    virtual Location* EmitAfterLeft(CodeGenerator *cg, Location *ltemp,
+                                    Emitted *e) = 0;
 };
 
 class ArithmeticExpr : public CompoundExpr 
 {
   public:
-    ArithmeticExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) {}
-    ArithmeticExpr(Operator *op, Expr *rhs) : CompoundExpr(op,rhs) {}
+    ArithmeticExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(ArithmeticExprNode,lhs,op,rhs) {}
+    ArithmeticExpr(Operator *op, Expr *rhs) : CompoundExpr(ArithmeticExprNode,op,rhs) {}
+    static bool classof(const Node *n) { return n->GetKind() == ArithmeticExprNode; }
 
-    Type* GetType() override;
-    void Check() override;
+    Type* ComputeType() override;
 
-    Location* Emit(CodeGenerator *cg) override;
-    int GetMemBytes() override;
+protected:
+    void CheckOperation() override;
+    Location* EmitAfterLeft(CodeGenerator *cg, Location *ltemp,
+                            Emitted *e) override;
 
 private:
     Location* EmitUnary(CodeGenerator *cg);
-    int GetMemBytesUnary();
 
-    Location* EmitBinary(CodeGenerator *cg);
-    int GetMemBytesBinary();
+    Location* EmitBinary(CodeGenerator *cg, Location *ltemp);
 };
 
 class RelationalExpr : public CompoundExpr 
 {
   public:
-    RelationalExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) {}
+    RelationalExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(RelationalExprNode,lhs,op,rhs) {}
+    static bool classof(const Node *n) { return n->GetKind() == RelationalExprNode; }
 
-    Type* GetType() override ;
+    Type* ComputeType() override ;
     void Check() override ;
-    Location* Emit(CodeGenerator *cg) override;
-    int GetMemBytes()  override;
+
+  protected:
+    void CheckOperation() override;
+    void EmitBeforeLeft(CodeGenerator *cg, Emitted *e) override;
+    Location* EmitAfterLeft(CodeGenerator *cg, Location *ltemp,
+                            Emitted *e) override;
 
   private:
-    Location* EmitLess(CodeGenerator *cg, Expr *l, Expr *r);
-    int GetMemBytesLess(Expr *l, Expr *r);
+    bool IsReversed();
+
+    Location* EmitLess(CodeGenerator *cg, Location *ltmp, Location *rtmp);
 
-    Location* EmitLessEqual(CodeGenerator *cg, Expr *l, Expr *r);
-    int GetMemBytesLessEqual(Expr *l, Expr *r);
+    Location* EmitLessEqual(CodeGenerator *cg, Location *ltmp, Location *rtmp);
 };
 
 class EqualityExpr : public CompoundExpr 
 {
   public:
-    EqualityExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) {}
+    EqualityExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(EqualityExprNode,lhs,op,rhs) {}
+    static bool classof(const Node *n) { return n->GetKind() == EqualityExprNode; }
     const char *GetPrintNameForNode() { return "EqualityExpr"; }
 
-    Type* GetType() override;
-    void Check() override;
-    Location* Emit(CodeGenerator *cg) override;
-    int GetMemBytes() override ;
+    Type* ComputeType() override;
+
+  protected:
+    void CheckOperation() override;
+    void EmitBeforeLeft(CodeGenerator *cg, Emitted *e) override;
+    Location* EmitAfterLeft(CodeGenerator *cg, Location *ltemp,
+                            Emitted *e) override;
 
    private:
-    Location* EmitEqual(CodeGenerator *cg);
-    int GetMemBytesEqual();
+    Location* EmitEqual(CodeGenerator *cg, Location *ltmp);
 
-    Location* EmitNotEqual(CodeGenerator *cg);
-    int GetMemBytesNotEqual();
+    Location* EmitNotEqual(CodeGenerator *cg, Location *ltmp, Emitted *e);
 };
 
 class LogicalExpr : public CompoundExpr 
 {
   public:
-    LogicalExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) {}
-    LogicalExpr(Operator *op, Expr *rhs) : CompoundExpr(op,rhs) {}
+    LogicalExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(LogicalExprNode,lhs,op,rhs) {}
+    LogicalExpr(Operator *op, Expr *rhs) : CompoundExpr(LogicalExprNode,op,rhs) {}
+    static bool classof(const Node *n) { return n->GetKind() == LogicalExprNode; }
     const char *GetPrintNameForNode() { return "LogicalExpr"; }
 
-    Type* GetType() override;
-    void Check() override;
-    Location* Emit(CodeGenerator *cg);
-    int GetMemBytes();
+    Type* ComputeType() override;
+
+  protected:
+    void CheckOperation() override;
+    void EmitBeforeLeft(CodeGenerator *cg, Emitted *e) override;
+    Location* EmitAfterLeft(CodeGenerator *cg, Location *ltemp,
+                            Emitted *e) override;
 
   private:
-    Location* EmitAnd(CodeGenerator *cg);
-    int GetMemBytesAnd();
+    Location* EmitAnd(CodeGenerator *cg, Location *ltmp);
 
-    Location* EmitOr(CodeGenerator *cg);
-    int GetMemBytesOr();
+    Location* EmitOr(CodeGenerator *cg, Location *ltmp);
 
-    Location* EmitNot(CodeGenerator *cg);
-    int GetMemBytesNot();
+    Location* EmitNot(CodeGenerator *cg, Emitted *e);
 };
 
 class AssignExpr : public CompoundExpr 
 {
   public:
-    AssignExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) {}
+    AssignExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(AssignExprNode,lhs,op,rhs) {}
+    static bool classof(const Node *n) { return n->GetKind() == AssignExprNode; }
     const char *GetPrintNameForNode() { return "AssignExpr"; }
 
-    Type* GetType() override;
-    void Check() override ;
-    Location* Emit(CodeGenerator *cg) override;
-    int GetMemBytes() override;
+    Type* ComputeType() override;
+
+  protected:
+    void CheckOperation() override;
+    void EmitBeforeLeft(CodeGenerator *cg, Emitted *e) override;
+    Location* EmitLeft(CodeGenerator *cg) override;
+    Location* EmitAfterLeft(CodeGenerator *cg, Location *ltemp,
+                            Emitted *e) override;
 };
 
 class LValue : public Expr 
 {
   public:
-    LValue(yyltype loc) : Expr(loc) {}
+    LValue(NodeKind k, SourceRange loc) : Expr(k, loc) {}
+    static bool classof(const Node *n) {
+        return n->GetKind() == ArrayAccessNode || n->GetKind() == FieldAccessNode;
+    }
 
-    Type* GetType() override = 0;
+    Type* ComputeType() override = 0;
     Location* Emit(CodeGenerator *cg) override = 0;
-    int GetMemBytes() override = 0;
 
     virtual Location* EmitStore(CodeGenerator *cg, Location *val) = 0;
-    virtual int GetMemBytesStore() = 0;
 };
 
 class This : public Expr 
 {
   public:
-    This(yyltype loc) : Expr(loc) {}
+    This(SourceRange loc) : Expr(ThisNode, loc) {}
+    static bool classof(const Node *n) { return n->GetKind() == ThisNode; }
 
-    Type* GetType() override ;
+    Type* ComputeType() override ;
     void Check() override;
     Location* Emit(CodeGenerator *cg) override;
-    int GetMemBytes() override ;
-
-    void BuildScope() override;
 
+    int Write(AstWriter *out) override;
 };
 
 class ArrayAccess : public LValue 
@@ -277,25 +345,23 @@ class ArrayAccess : public LValue
     Expr *base, *subscript;
     
   public:
-    ArrayAccess(yyltype loc, Expr *base, Expr *subscript);
+    ArrayAccess(SourceRange loc, Expr *base, Expr *subscript);
+    static bool classof(const Node *n) { return n->GetKind() == ArrayAccessNode; }
 
-    Type* GetType() override ;
-    void BuildScope() override ;
+    Type* ComputeType() override ;
+    void Resolve(Resolver *r) override ;
     void Check() override ;
 
     Location* Emit(CodeGenerator *cg) override ;
-    int GetMemBytes() override ;
 
     Location* EmitStore(CodeGenerator *cg, Location *val) override ;
-    int GetMemBytesStore() override ;
+    int Write(AstWriter *out) override;
 
 private:
     Location* EmitAddr(CodeGenerator *cg);
-    int GetMemBytesAddr();
 
     Location* EmitRuntimeSubscriptCheck(CodeGenerator *cg, Location *siz,
                                         Location *sub);
-    int GetMemBytesRuntimeSubscriptCheck();
 };
 
 /* Note that field access is used both for qualified names
@@ -308,29 +374,29 @@ class FieldAccess : public LValue
   protected:
     Expr *base;	// will be NULL if no explicit base
     Identifier *field;
+    Decl *decl;         // what field names, valid once declResolved
+    bool declResolved;
     
   public:
     FieldAccess(Expr *base, Identifier *field); //ok to pass NULL base
+    static bool classof(const Node *n) { return n->GetKind() == FieldAccessNode; }
 
     Identifier* GetIdentifier() {return field;}
-    Type* GetType() override;
-    void BuildScope() override;
+    Type* ComputeType() override;
+    void Resolve(Resolver *r) override;
     void Check() override;
     Location* Emit(CodeGenerator *cg) override;
-    int GetMemBytes() override;
 
     Location* EmitStore(CodeGenerator *cg, Location *val) override ;
-    int GetMemBytesStore() override;
+    int Write(AstWriter *out) override;
 
 private:
     VarDecl* GetDecl();
 
     Location* EmitMemLoc(CodeGenerator *cg, VarDecl *fieldDecl);
-    int GetMemBytesMemLoc(VarDecl *fieldDecl);
 
     Location* EmitMemLocStore(CodeGenerator *cg, Location *val,
                               VarDecl *fieldDecl);
-    int GetMemBytesMemLocStore(VarDecl *fieldDecl);
 
 };
 
@@ -344,28 +410,27 @@ class Call : public Expr
     Expr *base;	// will be NULL if no explicit base
     Identifier *field;
     List<Expr*> *actuals;
+    Decl *decl;         // what field names, valid once declResolved
+    bool declResolved;
     
   public:
 
-    Call(yyltype loc, Expr *base, Identifier *field, List<Expr*> *args);
+    Call(SourceRange loc, Expr *base, Identifier *field, List<Expr*> *args);
+    static bool classof(const Node *n) { return n->GetKind() == CallNode; }
 
-    Type* GetType() override ;
-    void BuildScope() override ;
+    Type* ComputeType() override ;
+    void Resolve(Resolver *r) override ;
     void Check() override;
     Location* Emit(CodeGenerator *cg) override ;
-    int GetMemBytes() override ;
-    int GetMemBytesActuals();
+    int Write(AstWriter *out) override;
 private:
     void CheckActuals(Decl *d);
     Location* EmitLabel(CodeGenerator *cg);
 
-    int GetMemBytesLabel();
 
     Location* EmitArrayLength(CodeGenerator *cg);
-    int GetMemBytesArrayLength();
 
     Location* EmitDynamicDispatch(CodeGenerator *cg, Location *b);
-    int GetMemBytesDynamicDispatch();
 
     FnDecl* GetDecl();
     bool IsArrayLengthCall();
@@ -378,12 +443,14 @@ class NewExpr : public Expr
     NamedType *cType;
     
   public:
-    NewExpr(yyltype loc, NamedType *clsType);
-    Type* GetType() override ;
+    NewExpr(SourceRange loc, NamedType *clsType);
+    static bool classof(const Node *n) { return n->GetKind() == NewExprNode; }
+    void Resolve(Resolver *r) override ;
+    Type* ComputeType() override ;
     void Check() override ;
 
     Location* Emit(CodeGenerator *cg) override ;
-    int GetMemBytes() override ;
+    int Write(AstWriter *out) override;
 };
 
 class NewArrayExpr : public Expr
@@ -391,43 +458,43 @@ class NewArrayExpr : public Expr
   protected:
     Expr *size;
     Type *elemType;
+    ArrayType *arrayType;       // canonical, made with the node
     
   public:
-    NewArrayExpr(yyltype loc, Expr *sizeExpr, Type *elemType);
-    Type* GetType() override ;
-    void BuildScope() override ;
+    NewArrayExpr(SourceRange loc, Expr *sizeExpr, Type *elemType);
+    static bool classof(const Node *n) { return n->GetKind() == NewArrayExprNode; }
+    Type* ComputeType() override ;
+    void Resolve(Resolver *r) override ;
     void Check() override ;
     Location* Emit(CodeGenerator *cg) override ;
-    int GetMemBytes() override ;
+    int Write(AstWriter *out) override;
 
 private:
     Location* EmitRuntimeSizeCheck(CodeGenerator *cg, Location *siz);
-    int GetMemBytesRuntimeSizeCheck();
 
 };
 
 class ReadIntegerExpr : public Expr
 {
   public:
-    ReadIntegerExpr(yyltype loc) : Expr(loc) {}
-
-    void BuildScope() override {};
+    ReadIntegerExpr(SourceRange loc) : Expr(ReadIntegerExprNode, loc) {}
+    static bool classof(const Node *n) { return n->GetKind() == ReadIntegerExprNode; }
 
-    Type* GetType() override ;
+    Type* ComputeType() override ;
     void Check() override {}
     Location* Emit(CodeGenerator *cg) override ;
-    int GetMemBytes() override ;
+    int Write(AstWriter *out) override;
 };
 
 class ReadLineExpr : public Expr
 {
   public:
-    ReadLineExpr(yyltype loc) : Expr (loc) {}
-    void BuildScope() override {};
-    Type* GetType () override ;
+    ReadLineExpr(SourceRange loc) : Expr (ReadLineExprNode, loc) {}
+    static bool classof(const Node *n) { return n->GetKind() == ReadLineExprNode; }
+    Type* ComputeType() override ;
     void Check()  override {}
     Location* Emit(CodeGenerator *cg) override ;
-    int GetMemBytes() override ;
+    int Write(AstWriter *out) override;
 };
 
     
@@ -18,6 +18,9 @@
 #include "hashtable.h"
 #include "ast_type.h"
 #include <stack>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
 #include "codegen.h"
 class Decl;
 class VarDecl;
@@ -27,8 +30,10 @@ class LoopStmt;
 class FnDecl;
 class CodeGenerator;
 class Location;
+class WorkStack;
+class AstWriter;
 
-class Scope
+class Scope : public InArena<Scope>
 {
     private:
         Scope * parent;
@@ -38,8 +43,8 @@ class Scope
          LoopStmt *          loopStmt;
          FnDecl *            fnDecl;
     public:
-        Scope():table(new Hashtable<Decl*>),classDecl(NULL),loopStmt(NULL),
-                fnDecl(NULL) {}
+        Scope();
+        ~Scope() {delete table;}
         void SetParent(Scope * p) {parent = p;}
         Scope* GetParent() {return parent;}
 
@@ -56,36 +61,105 @@ class Scope
         friend ostream& operator<<(ostream& out,Scope* s);
 };
 
+// The Resolver carries the lexical context down the tree during the
+// name resolution pass (see Program::Resolve): what each name is bound
+// to in the scopes that enclose the node being visited, and the nearest
+// enclosing class, function and loop. With recordUses set, it also
+// notes in each function what the function names outside itself (see
+// FnDecl::GetUses).
+class Resolver
+{
+    private:
+            // For each name (interned, so compared by address), its
+            // declarations in the enclosing scopes, innermost last
+        unordered_map<const char*, vector<Decl*>> bindings;
+            // The binding stacks each scope pushed onto, scope after
+            // scope, and where each scope's run begins
+        vector<vector<Decl*>*> pushed;
+        vector<size_t>      scopeStarts;
+
+    public:
+        ClassDecl *         classDecl;
+        FnDecl *            fnDecl;
+        LoopStmt *          loopStmt;
+        bool                recordUses;
+        unordered_set<Decl*> used;   // already noted in fnDecl
+    public:
+        Resolver(bool record = false):classDecl(NULL),fnDecl(NULL),
+                 loopStmt(NULL),recordUses(record) {}
+
+             // Binds the names declared in s over any in the scopes
+             // already pushed, until s is popped
+        void PushScope(Scope *s);
+        void PopScope();
+
+             // Returns the declaration of id in the innermost scope
+             // that has one, NULL if none does. It takes the same time
+             // however many scopes enclose id.
+        Decl* Lookup(Identifier *id);
+
+             // Notes that the code for fnDecl depends on d, if d is
+             // declared outside any function; for a member, that is
+             // on its class or interface
+        void Use(Decl *d);
+};
+
 class Program : public Node
 {
-  public:
-    static Scope *gScope;
-    static stack<const char*> *gBreakLabels;
   protected:
      List<Decl*> *decls;
-     CodeGenerator *codeGenerator;
      
   public:
      Program(List<Decl*> *declList);
+     static bool classof(const Node *n) { return n->GetKind() == ProgramNode; }
      void Check();
      void Emit();
-     Scope*  GetScope() override  {return gScope;}
+     Scope*  GetScope() override  {return scope;}
+     int Write(AstWriter *out) override;
+
+         // Returns the global scope of the program being compiled
+     static Scope *GlobalScope();
   private:
     void BuildScope();
+    void Resolve();
 };
 
 class Stmt : public Node
 {
 protected:
+     // enclosing declarations and loop, filled in by Resolve
+     ClassDecl *classDecl;
+     FnDecl *fnDecl;
+     LoopStmt *loopStmt;
 
   public:
-     Stmt() : Node() {scope = new Scope;}
-     Stmt(yyltype loc) : Node(loc) {scope = new Scope;}
+     Stmt(NodeKind k) : Node(k) {Init();}
+     Stmt(NodeKind k, SourceRange loc) : Node(k, loc) {Init();}
+         // an Expr is a Stmt too
+     static bool classof(const Node *n) {
+         return n->GetKind() >= StmtBlockNode && n->GetKind() <= ReadLineExprNode;
+     }
 
      virtual void BuildScope()=0;
+     virtual void Resolve(Resolver *r);
      virtual void Check()=0;
      virtual Location* Emit(CodeGenerator *cg)=0;
-     virtual int  GetMemBytes()=0;
+
+         // The same passes, as steps of a walk over the statements this
+         // one is nested in (see workstack.h). A statement with others
+         // nested in it adds the steps for them to the walk rather than
+         // recursing, as programs can nest them deeper than the C++
+         // stack allows; any other statement just does the pass.
+     virtual void BuildScopeStep(WorkStack *w) {BuildScope();}
+     virtual void ResolveStep(Resolver *r, WorkStack *w) {Resolve(r);}
+     virtual void CheckStep(WorkStack *w) {Check();}
+     virtual void EmitStep(CodeGenerator *cg, WorkStack *w) {Emit(cg);}
+         // Write, storing the node's index in *index once it's written
+     virtual void WriteStep(AstWriter *out, WorkStack *w, int *index);
+
+  private:
+     void Init() {scope = new Scope; classDecl = NULL; fnDecl = NULL;
+                  loopStmt = NULL;}
 };
 
 class StmtBlock : public Stmt 
@@ -96,11 +170,19 @@ class StmtBlock : public Stmt
     
   public:
     StmtBlock(List<VarDecl*> *variableDeclarations, List<Stmt*> *statements);
+    static bool classof(const Node *n) { return n->GetKind() == StmtBlockNode; }
 
     void BuildScope() override ;
+    void Resolve(Resolver *r) override ;
     Location* Emit(CodeGenerator *cg) override ;
-    int   GetMemBytes() override ;
     void Check() override ;
+    int Write(AstWriter *out) override;
+
+    void BuildScopeStep(WorkStack *w) override;
+    void ResolveStep(Resolver *r, WorkStack *w) override;
+    void CheckStep(WorkStack *w) override;
+    void EmitStep(CodeGenerator *cg, WorkStack *w) override;
+    void WriteStep(AstWriter *out, WorkStack *w, int *index) override;
 };
 
   
@@ -111,10 +193,20 @@ class ConditionalStmt : public Stmt
     Stmt *body;
   
   public:
-    ConditionalStmt(Expr *testExpr, Stmt *body);
+    ConditionalStmt(NodeKind kind, Expr *testExpr, Stmt *body);
+    static bool classof(const Node *n) {
+        return n->GetKind() >= ForStmtNode && n->GetKind() <= IfStmtNode;
+    }
 
     void BuildScope() override;
+    void Resolve(Resolver *r) override;
     void Check() override;
+    Location* Emit(CodeGenerator *cg) override;
+    int Write(AstWriter *out) override;
+
+    void BuildScopeStep(WorkStack *w) override;
+    void ResolveStep(Resolver *r, WorkStack *w) override;
+    void CheckStep(WorkStack *w) override;
 };
 
 class LoopStmt : public ConditionalStmt 
@@ -122,10 +214,14 @@ class LoopStmt : public ConditionalStmt
 protected:
     const char* breakLabel;
   public:
-    LoopStmt(Expr *testExpr, Stmt *body)
-            : ConditionalStmt(testExpr, body) {}
-
-    void BuildScope() override ;
+    LoopStmt(NodeKind kind, Expr *testExpr, Stmt *body)
+            : ConditionalStmt(kind, testExpr, body) {}
+    static bool classof(const Node *n) {
+        return n->GetKind() == ForStmtNode || n->GetKind() == WhileStmtNode;
+    }
+
+    void BuildScopeStep(WorkStack *w) override;
+    void ResolveStep(Resolver *r, WorkStack *w) override;
     void SetBreak(const char* b) {breakLabel = b;}
     const char* GetBreak() {return breakLabel;}
 };
@@ -137,19 +233,20 @@ class ForStmt : public LoopStmt
   
   public:
     ForStmt(Expr *init, Expr *test, Expr *step, Stmt *body);
+    static bool classof(const Node *n) { return n->GetKind() == ForStmtNode; }
 
-    void BuildScope() override;
-    Location* Emit(CodeGenerator *cg) override;
-    int   GetMemBytes() override ;
+    void ResolveStep(Resolver *r, WorkStack *w) override;
+    void EmitStep(CodeGenerator *cg, WorkStack *w) override;
+    void WriteStep(AstWriter *out, WorkStack *w, int *index) override;
 };
 
 class WhileStmt : public LoopStmt {
 public:
-    WhileStmt(Expr *test, Stmt *body) : LoopStmt(test, body) {}
+    WhileStmt(Expr *test, Stmt *body) : LoopStmt(WhileStmtNode, test, body) {}
+    static bool classof(const Node *n) { return n->GetKind() == WhileStmtNode; }
 
-    void BuildScope() override;
-    Location *Emit(CodeGenerator *cg) override ;
-    int GetMemBytes() override ;
+    void EmitStep(CodeGenerator *cg, WorkStack *w) override;
+    void WriteStep(AstWriter *out, WorkStack *w, int *index) override;
 };
 
 class IfStmt : public ConditionalStmt 
@@ -159,22 +256,23 @@ class IfStmt : public ConditionalStmt
   
   public:
     IfStmt(Expr *test, Stmt *thenBody, Stmt *elseBody);
-    void Check() override;
-    void BuildScope() override ;
-    Location* Emit(CodeGenerator *cg) override;
-    int GetMemBytes() override ;
-
-
+    static bool classof(const Node *n) { return n->GetKind() == IfStmtNode; }
+    void BuildScopeStep(WorkStack *w) override;
+    void ResolveStep(Resolver *r, WorkStack *w) override;
+    void CheckStep(WorkStack *w) override;
+    void EmitStep(CodeGenerator *cg, WorkStack *w) override;
+    void WriteStep(AstWriter *out, WorkStack *w, int *index) override;
 };
 
 class BreakStmt : public Stmt 
 {
   public:
-    BreakStmt(yyltype loc) : Stmt(loc) {}
+    BreakStmt(SourceRange loc) : Stmt(BreakStmtNode, loc) {}
+    static bool classof(const Node *n) { return n->GetKind() == BreakStmtNode; }
     void BuildScope() override {};
     void Check() override ;
     Location* Emit(CodeGenerator *cg) override;
-    int GetMemBytes() override ;
+    int Write(AstWriter *out) override;
 };
 
 class ReturnStmt : public Stmt  
@@ -183,12 +281,14 @@ class ReturnStmt : public Stmt
     Expr *expr;
   
   public:
-    ReturnStmt(yyltype loc, Expr *expr);
+    ReturnStmt(SourceRange loc, Expr *expr);
+    static bool classof(const Node *n) { return n->GetKind() == ReturnStmtNode; }
 
-    void BuildScope() override ;
+    void BuildScope() override {};
+    void Resolve(Resolver *r) override ;
     void Check() override ;
     Location* Emit(CodeGenerator *cg) override;
-    int GetMemBytes() override ;
+    int Write(AstWriter *out) override;
 };
 
 class PrintStmt : public Stmt
@@ -198,11 +298,13 @@ class PrintStmt : public Stmt
     
   public:
     PrintStmt(List<Expr*> *arguments);
+    static bool classof(const Node *n) { return n->GetKind() == PrintStmtNode; }
 
-    void BuildScope() override;
+    void BuildScope() override {};
+    void Resolve(Resolver *r) override;
     void Check() override;
     Location* Emit(CodeGenerator *cg) override;
-    int GetMemBytes() override;
+    int Write(AstWriter *out) override;
 };
 
 
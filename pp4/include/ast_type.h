@@ -5,6 +5,12 @@
  * for built-in types, the NamedType for classes and interfaces,
  * and the ArrayType for arrays of other types.  
  *
+ * Each distinct type has one canonical Type object: the built-in types
+ * are their own, and a TypeContext (below) makes those of the named and
+ * array types. A NamedType or ArrayType in the tree stands for a place
+ * the type is written, and points to the canonical type it denotes, so
+ * two types are equal exactly when their canonical types are the same.
+ *
  * pp3: You will need to extend the Type classes to implement
  * the type system and rules for type equivalency and compatibility.
  */
@@ -17,45 +23,72 @@
 #include "errors.h"
 #include "codegen.h"
 #include <iostream>
+#include <unordered_map>
+#include <vector>
 using namespace std;
 
+class Decl;
+class Resolver;
+class Scope;
+class TypeContext;
 
 class Type : public Node 
 {
   protected:
-    char *typeName;
+    const char *typeName;      // a literal, for the built-in types
+    Type *canonical;           // this, if it is the canonical type
 
   public :
     static Type *intType, *doubleType, *boolType, *voidType,
                 *nullType, *stringType, *errorType;
 
-    Type(yyltype loc) : Node(loc) {}
-    Type() : Node() {}
+    Type(NodeKind k, SourceRange loc) : Node(k, loc), canonical(NULL) {}
+    Type(NodeKind k) : Node(k), canonical(NULL) {}
     Type(const char *str);
+    static bool classof(const Node *n) {
+        return n->GetKind() >= BuiltInTypeNode && n->GetKind() <= ArrayTypeNode;
+    }
+
+         // A canonical type is shared by everything of that type in
+         // its compilation, so it is never given a parent (nor is a
+         // built-in one, by Node::SetParent)
+    void SetParent(Node *p) { if (canonical != this) Node::SetParent(p); }
     
     virtual void PrintToStream(ostream& out) { out << typeName; }
     friend ostream& operator<<(ostream& out, Type *t) { t->PrintToStream(out); return out; }
     virtual bool IsEquivalentTo(Type *other);
-    virtual bool IsEqualTo(Type *other) {return this==other;}
+    Type* Canonical() {return canonical;}
+    bool IsEqualTo(Type *other) {return canonical == other->canonical;}
     virtual void ReportNotDeclaredIdentifier(reasonT reason){return;}
     virtual const char* GetName() {return typeName;}
     virtual const char* Name() {return typeName;}
     virtual bool IsPrimitive() {return true;}
     virtual BuiltIn GetPrint();
     virtual int GetMemBytes() { return CodeGenerator::VarSize; }
+
+         // binds the named type(s) to their declarations, see Program::Resolve
+    virtual void Resolve(Resolver *r) {}
+    virtual Decl* GetDecl() {return NULL;}
+    int Write(AstWriter *out) override;
 };
 //user define type
 class NamedType : public Type 
 {
   protected:
     Identifier *id;
+
+         // Kept by the canonical type only, see TypeContext::BindNames
+    Decl *typeDecl;            // see GetTypeDecl
+    vector<NamedType*> display; // superclasses from the root down, then itself
+    vector<bool> implemented;  // by interfaceNum, by it or a superclass
+    int interfaceNum;          // -1 unless named in some implements list
     
   public:
     NamedType(Identifier *i);
+    static bool classof(const Node *n) { return n->GetKind() == NamedTypeNode; }
     
     void PrintToStream(ostream& out) override { out << id; }
     void ReportNotDeclaredIdentifier(reasonT reason) override ;
-    bool IsEqualTo(Type *other) override ;
     bool IsEquivalentTo(Type *other) override ;
 
     const char* GetName() {return id->GetName();}
@@ -63,6 +96,25 @@ class NamedType : public Type
     bool IsPrimitive() override  {return false;}
     Identifier* GetId() {return id;}
     BuiltIn GetPrint() override;
+    void Resolve(Resolver *r) override;
+    Decl* GetDecl() override {return id->GetDecl();}
+    int Write(AstWriter *out) override;
+
+         // What the name is declared as at the top level (a class, an
+         // interface or whatever else), NULL if nothing. Only valid once
+         // the global scope is built, see TypeContext::BindNames.
+    Decl* GetTypeDecl() {return static_cast<NamedType*>(canonical)->typeDecl;}
+
+         // The class's superclasses, the root first, followed by the class
+         // itself; just the type itself if it does not name a class. Only
+         // valid once the global scope is built, like GetTypeDecl.
+    const vector<NamedType*>& GetDisplay() {
+        return static_cast<NamedType*>(canonical)->display;
+    }
+
+  private:
+    friend class TypeContext;
+    NamedType(TypeContext *owner, Identifier *i); // owner's canonical type
 };
 
 class ArrayType : public Type 
@@ -71,12 +123,12 @@ class ArrayType : public Type
     Type *elemType;
 
   public:
-    ArrayType(yyltype loc, Type *elemType);
+    ArrayType(SourceRange loc, Type *elemType);
     ArrayType(Type *elemType);
+    static bool classof(const Node *n) { return n->GetKind() == ArrayTypeNode; }
 
     void PrintToStream(ostream& out) override { out << elemType << "[]"; }
     void ReportNotDeclaredIdentifier(reasonT reason) override ;
-    bool IsEqualTo(Type *other) override ;
     bool IsEquivalentTo(Type *other) override ;
 
     const char* Name() override {return elemType->Name();}
@@ -84,6 +136,45 @@ class ArrayType : public Type
 
     Type* GetElemType() {return elemType;}
     BuiltIn GetPrint() override ;
+    void Resolve(Resolver *r) override {elemType->Resolve(r);}
+    Decl* GetDecl() override {return elemType->GetDecl();}
+    int Write(AstWriter *out) override;
+
+  private:
+    friend class TypeContext;
+    ArrayType(TypeContext *owner, Type *elemType); // owner's canonical type
+};
+
+/* Class: TypeContext
+ * ------------------
+ * Makes the canonical named and array types of one compilation (see
+ * compilation.h), each the first time it is asked for. Every NamedType
+ * and ArrayType asks for its canonical type when it is made, which is
+ * while the tree is built, on the compilation's own thread, so the
+ * tables are not locked.
+ */
+class TypeContext
+{
+  private:
+    unordered_map<const char*, NamedType*> named;  // by interned name
+    unordered_map<Type*, ArrayType*> arrays;       // by canonical element type
+
+  public:
+         // Returns the canonical type for the name of id
+    NamedType* Named(Identifier *id);
+
+         // Returns the canonical type for arrays of elemType
+    ArrayType* ArrayOf(Type *elemType);
+
+         // Records what each name used as a type is declared as in the
+         // global scope, for NamedType::GetTypeDecl, and then encodes the
+         // class hierarchy so that NamedType::IsEquivalentTo takes
+         // constant time
+    void BindNames(Scope *global);
+
+  private:
+    void EncodeHierarchy();
+    NamedType* Superclass(NamedType *t);
 };
 
  
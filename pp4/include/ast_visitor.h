@@ -0,0 +1,138 @@
+/* File: ast_visitor.h
+ * -------------------
+ * A Visitor is a pass over nodes that doesn't need a virtual method of
+ * its own in every node class. Visit switches on the node's kind (see
+ * ast.h) and calls the Visit method for its class, such as
+ * VisitForStmt. A pass derives from Visitor<ThePass> and defines just
+ * the Visit methods it cares about; the others fall back on the method
+ * for the class's base class (VisitForStmt on VisitLoopStmt, then
+ * VisitConditionalStmt, VisitStmt and finally VisitNode, which does
+ * nothing). The calls are resolved at compile time, so none of them is
+ * virtual.
+ *
+ * Visiting a node does not visit its children: a pass that walks the
+ * tree calls Visit on the children it wants to go on to.
+ *
+ * Result is what the Visit methods return, void by default.
+ */
+
+#ifndef _H_ast_visitor
+#define _H_ast_visitor
+
+#include "ast.h"
+#include "ast_decl.h"
+#include "ast_expr.h"
+#include "ast_stmt.h"
+#include "ast_type.h"
+
+template <class Derived, class Result = void>
+class Visitor
+{
+  public:
+    Result Visit(Node *n) {
+        Derived *d = static_cast<Derived*>(this);
+        switch (n->GetKind()) {
+          case ProgramNode:       return d->VisitProgram(cast<Program>(n));
+          case IdentifierNode:    return d->VisitIdentifier(cast<Identifier>(n));
+          case OperatorNode:      return d->VisitOperator(cast<Operator>(n));
+          case ErrorNode:         return d->VisitError(cast<Error>(n));
+
+          case BuiltInTypeNode:   return d->VisitType(cast<Type>(n));
+          case NamedTypeNode:     return d->VisitNamedType(cast<NamedType>(n));
+          case ArrayTypeNode:     return d->VisitArrayType(cast<ArrayType>(n));
+
+          case VarDeclNode:       return d->VisitVarDecl(cast<VarDecl>(n));
+          case ClassDeclNode:     return d->VisitClassDecl(cast<ClassDecl>(n));
+          case InterfaceDeclNode: return d->VisitInterfaceDecl(cast<InterfaceDecl>(n));
+          case FnDeclNode:        return d->VisitFnDecl(cast<FnDecl>(n));
+
+          case StmtBlockNode:     return d->VisitStmtBlock(cast<StmtBlock>(n));
+          case ForStmtNode:       return d->VisitForStmt(cast<ForStmt>(n));
+          case WhileStmtNode:     return d->VisitWhileStmt(cast<WhileStmt>(n));
+          case IfStmtNode:        return d->VisitIfStmt(cast<IfStmt>(n));
+          case BreakStmtNode:     return d->VisitBreakStmt(cast<BreakStmt>(n));
+          case ReturnStmtNode:    return d->VisitReturnStmt(cast<ReturnStmt>(n));
+          case PrintStmtNode:     return d->VisitPrintStmt(cast<PrintStmt>(n));
+
+          case EmptyExprNode:     return d->VisitEmptyExpr(cast<EmptyExpr>(n));
+          case IntConstantNode:   return d->VisitIntConstant(cast<IntConstant>(n));
+          case DoubleConstantNode: return d->VisitDoubleConstant(cast<DoubleConstant>(n));
+          case BoolConstantNode:  return d->VisitBoolConstant(cast<BoolConstant>(n));
+          case StringConstantNode: return d->VisitStringConstant(cast<StringConstant>(n));
+          case NullConstantNode:  return d->VisitNullConstant(cast<NullConstant>(n));
+          case ArithmeticExprNode: return d->VisitArithmeticExpr(cast<ArithmeticExpr>(n));
+          case RelationalExprNode: return d->VisitRelationalExpr(cast<RelationalExpr>(n));
+          case EqualityExprNode:  return d->VisitEqualityExpr(cast<EqualityExpr>(n));
+          case LogicalExprNode:   return d->VisitLogicalExpr(cast<LogicalExpr>(n));
+          case AssignExprNode:    return d->VisitAssignExpr(cast<AssignExpr>(n));
+          case ThisNode:          return d->VisitThis(cast<This>(n));
+          case ArrayAccessNode:   return d->VisitArrayAccess(cast<ArrayAccess>(n));
+          case FieldAccessNode:   return d->VisitFieldAccess(cast<FieldAccess>(n));
+          case CallNode:          return d->VisitCall(cast<Call>(n));
+          case NewExprNode:       return d->VisitNewExpr(cast<NewExpr>(n));
+          case NewArrayExprNode:  return d->VisitNewArrayExpr(cast<NewArrayExpr>(n));
+          case ReadIntegerExprNode: return d->VisitReadIntegerExpr(cast<ReadIntegerExpr>(n));
+          case ReadLineExprNode:  return d->VisitReadLineExpr(cast<ReadLineExpr>(n));
+
+          default:                break; // ListNode is never a node's kind
+        }
+        Failure("Visiting a node of unknown kind %d", n->GetKind());
+        return Result();
+    }
+
+         // The fallbacks, each on the method for the base class
+    Result VisitNode(Node *n)                 { return Result(); }
+    Result VisitProgram(Program *n)           { return Self()->VisitNode(n); }
+    Result VisitIdentifier(Identifier *n)     { return Self()->VisitNode(n); }
+    Result VisitOperator(Operator *n)         { return Self()->VisitNode(n); }
+    Result VisitError(Error *n)               { return Self()->VisitNode(n); }
+
+    Result VisitType(Type *n)                 { return Self()->VisitNode(n); }
+    Result VisitNamedType(NamedType *n)       { return Self()->VisitType(n); }
+    Result VisitArrayType(ArrayType *n)       { return Self()->VisitType(n); }
+
+    Result VisitDecl(Decl *n)                 { return Self()->VisitNode(n); }
+    Result VisitVarDecl(VarDecl *n)           { return Self()->VisitDecl(n); }
+    Result VisitClassDecl(ClassDecl *n)       { return Self()->VisitDecl(n); }
+    Result VisitInterfaceDecl(InterfaceDecl *n) { return Self()->VisitDecl(n); }
+    Result VisitFnDecl(FnDecl *n)             { return Self()->VisitDecl(n); }
+
+    Result VisitStmt(Stmt *n)                 { return Self()->VisitNode(n); }
+    Result VisitStmtBlock(StmtBlock *n)       { return Self()->VisitStmt(n); }
+    Result VisitConditionalStmt(ConditionalStmt *n) { return Self()->VisitStmt(n); }
+    Result VisitLoopStmt(LoopStmt *n)         { return Self()->VisitConditionalStmt(n); }
+    Result VisitForStmt(ForStmt *n)           { return Self()->VisitLoopStmt(n); }
+    Result VisitWhileStmt(WhileStmt *n)       { return Self()->VisitLoopStmt(n); }
+    Result VisitIfStmt(IfStmt *n)             { return Self()->VisitConditionalStmt(n); }
+    Result VisitBreakStmt(BreakStmt *n)       { return Self()->VisitStmt(n); }
+    Result VisitReturnStmt(ReturnStmt *n)     { return Self()->VisitStmt(n); }
+    Result VisitPrintStmt(PrintStmt *n)       { return Self()->VisitStmt(n); }
+
+    Result VisitExpr(Expr *n)                 { return Self()->VisitStmt(n); }
+    Result VisitEmptyExpr(EmptyExpr *n)       { return Self()->VisitExpr(n); }
+    Result VisitIntConstant(IntConstant *n)   { return Self()->VisitExpr(n); }
+    Result VisitDoubleConstant(DoubleConstant *n) { return Self()->VisitExpr(n); }
+    Result VisitBoolConstant(BoolConstant *n) { return Self()->VisitExpr(n); }
+    Result VisitStringConstant(StringConstant *n) { return Self()->VisitExpr(n); }
+    Result VisitNullConstant(NullConstant *n) { return Self()->VisitExpr(n); }
+    Result VisitCompoundExpr(CompoundExpr *n) { return Self()->VisitExpr(n); }
+    Result VisitArithmeticExpr(ArithmeticExpr *n) { return Self()->VisitCompoundExpr(n); }
+    Result VisitRelationalExpr(RelationalExpr *n) { return Self()->VisitCompoundExpr(n); }
+    Result VisitEqualityExpr(EqualityExpr *n) { return Self()->VisitCompoundExpr(n); }
+    Result VisitLogicalExpr(LogicalExpr *n)   { return Self()->VisitCompoundExpr(n); }
+    Result VisitAssignExpr(AssignExpr *n)     { return Self()->VisitCompoundExpr(n); }
+    Result VisitThis(This *n)                 { return Self()->VisitExpr(n); }
+    Result VisitLValue(LValue *n)             { return Self()->VisitExpr(n); }
+    Result VisitArrayAccess(ArrayAccess *n)   { return Self()->VisitLValue(n); }
+    Result VisitFieldAccess(FieldAccess *n)   { return Self()->VisitLValue(n); }
+    Result VisitCall(Call *n)                 { return Self()->VisitExpr(n); }
+    Result VisitNewExpr(NewExpr *n)           { return Self()->VisitExpr(n); }
+    Result VisitNewArrayExpr(NewArrayExpr *n) { return Self()->VisitExpr(n); }
+    Result VisitReadIntegerExpr(ReadIntegerExpr *n) { return Self()->VisitExpr(n); }
+    Result VisitReadLineExpr(ReadLineExpr *n) { return Self()->VisitExpr(n); }
+
+  private:
+    Derived *Self() { return static_cast<Derived*>(this); }
+};
+
+#endif
@@ -0,0 +1,183 @@
+/* File: astfile.h
+ * ---------------
+ * An AST file holds the parse tree of a program, together with the
+ * program's source text, in a form that can be mapped into memory and
+ * turned back into the tree without scanning or parsing anything:
+ * "dcc -emit-ast" writes one in place of the assembly, and
+ * "dcc -from-ast" compiles from one instead of from the source.
+ *
+ * The file is a header followed by flat arrays, each starting on an
+ * 8-byte boundary, in this order:
+ *
+ *   nodes      an AstNode for each node, every node after its children
+ *   children   the child indices of all the nodes, a node's together
+ *   locations  the SourceRange of each node that has one of its own
+ *   symbols    for each symbol, the offset of its text; one more
+ *              offset marks the end of the last
+ *   text       the symbols' text, each ending with a NUL
+ *   source     the source text, followed by two NULs
+ *
+ * A node's children are the nodes and lists of nodes it is made from,
+ * in the order its constructor takes them, and a list of nodes is a
+ * ListNode whose children are its elements. A child that is absent
+ * (the else part of an if, say) is given as NoIndex. Identifiers,
+ * operators and string constants name their text by symbol index.
+ * Only nodes made with a location of their own record one; the others
+ * work theirs out from their children, as they did when parsed. The
+ * numbers are stored in the byte order of the machine that wrote them,
+ * and a file with the other order, or of another format version, is
+ * not read.
+ *
+ * Since every node comes after its children, the loader makes the
+ * whole tree in a single pass over the nodes.
+ */
+
+#ifndef _H_astfile
+#define _H_astfile
+
+#include <stdint.h>
+#include <stdio.h>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ast.h"
+#include "list.h"
+#include "source.h"
+using std::deque;
+using std::string;
+using std::unordered_map;
+using std::vector;
+
+class Program;
+class Type;
+
+struct AstHeader {
+    char magic[8];             // "dcc-ast" and a NUL
+    uint32_t byteOrder;        // 0x01020304 as written
+    uint32_t version;
+    uint32_t numNodes, numChildren, numLocations, numSymbols;
+    uint32_t textBytes, sourceBytes;
+};
+
+struct AstNode {
+    uint32_t kind;             // a NodeKind
+    uint32_t numChildren;
+    uint32_t firstChild;       // index into the children
+    uint32_t location;         // index into the locations, or NoIndex
+    uint64_t value;            // a constant's value, or a symbol index
+};
+
+static const uint32_t NoIndex = 0xFFFFFFFFu;
+
+class AstWriter {
+  private:
+    SourceBuffer *source;
+    vector<AstNode> nodes;
+    vector<uint32_t> children;
+    vector<SourceRange> locations;
+    vector<uint32_t> symbols;
+    string text;
+    unordered_map<string, uint32_t> symbolIndex;
+    deque<vector<int>> slots;
+
+  public:
+    AstWriter(SourceBuffer *source) : source(source) {}
+
+         // Adds node and everything below it, and returns its index,
+         // or -1 (NoIndex, in the file) for NULL
+    int Add(Node *node)         { return node ? node->Write(this) : -1; }
+
+    template <class Element> int AddList(List<Element> *list) {
+        vector<int> elems;
+        elems.reserve(list->NumElements());
+        for (Element e : *list)
+            elems.push_back(Add(e));
+        return AddNode(ListNode, NULL, elems.data(), elems.size());
+    }
+
+         // Adds a node whose children have already been added, with loc
+         // if it was made with a location of its own
+    int AddNode(NodeKind kind, const SourceRange *loc, const int *children,
+                int numChildren, uint64_t value = 0);
+
+         // Returns room for n child indices, which stays put until the
+         // writer is destroyed, for a node whose children are added in
+         // steps of a walk (see Stmt::WriteStep)
+    int *Slots(int n) {
+        slots.emplace_back(n, -1);
+        return slots.back().data();
+    }
+
+         // Adds one of the built-in types (Type::intType and so on)
+    int AddBuiltInType(Type *type);
+
+         // Returns the index of the symbol for str, adding it if need be
+    uint32_t Symbol(const char *str);
+
+    static uint64_t Bits(double d);
+
+         // Writes the file, whose root is the node added last. Returns
+         // false if it can't be written.
+    bool WriteTo(FILE *out);
+};
+
+class AstFile {
+  private:
+    string path;
+    char *mem;
+    size_t length;
+    const AstHeader *header;
+    const AstNode *nodes;
+    const uint32_t *children;
+    const SourceRange *locations;
+    const uint32_t *symbols;
+    const char *text;
+    char *sourceText;
+    SourceBuffer source;
+    vector<Node*> built;       // by node index, NULL for a list
+    vector<bool> used;         // whether a node has been given a parent
+    vector<const char*> interned; // by symbol index, once needed
+    bool damaged;              // a problem has been reported by Load
+
+  public:
+    static const uint32_t FormatVersion = 2;
+
+         // Writes the tree of program, and the source it was parsed
+         // from, to out. Returns false if it can't be written.
+    static bool Write(Program *program, SourceBuffer *source, FILE *out);
+
+    AstFile() : mem(NULL), length(0), damaged(false) {}
+    ~AstFile();
+
+         // Maps the AST file at path into memory. Returns false, with
+         // the problem described in *problem, if it can't be read or is
+         // not an AST file that can be loaded.
+    bool Map(const char *path, string *problem);
+
+         // The source text the tree was parsed from
+    SourceBuffer *Source()      { return &source; }
+
+         // Makes the tree, in the current compilation, and returns its
+         // root. Returns NULL if the file is damaged, which is reported
+         // as an error of the compilation.
+    Program *Load();
+
+  private:
+    void Corrupt(const char *problem);
+    template <class N, class... Args> N *Build(Args... args);
+    uint32_t ChildIndex(const AstNode &n, int i, uint32_t index);
+    template <class T> T *Child(const AstNode &n, int i, uint32_t index,
+                                bool optional = false);
+    template <class T> List<T*> *ChildList(const AstNode &n, int i,
+                                           uint32_t index);
+    const char *Text(uint64_t symbol);
+    const char *Symbol(uint64_t symbol);
+    SourceRange Location(const AstNode &n);
+    Node *Make(uint32_t index);
+
+    AstFile(const AstFile&);                // files are not copied
+    AstFile& operator=(const AstFile&);
+};
+
+#endif
@@ -0,0 +1,91 @@
+/* File: codecache.h
+ * -----------------
+ * With --cache <dir>, the assembly generated for each function is kept
+ * in files under dir, so a program compiled again after a few of its
+ * functions were edited only generates code for those. The program is
+ * still parsed and checked in full; what is skipped for every function
+ * found in the cache is generating its Tac and translating it to MIPS.
+ *
+ * The cache is content-addressed: an entry's file is named after a hash
+ * of everything that goes into the function's code. That is the text of
+ * the function with comments and surplus white space taken out (so a
+ * function that was only reformatted is still found), its label, a
+ * description of the globals, functions and classes its code refers to
+ * (their types, offsets, signatures, fields and vtables), and whether
+ * the code is commented with its Tac (see
+ * --no-tac-comments). (The cache is not used with -d tac.) An entry is never
+ * updated, and nothing is ever removed; deleting the directory empties
+ * the cache.
+ *
+ * Labels, temps and string constants are numbered through the whole
+ * program, so an entry keeps its code with them numbered from zero (see
+ * Renumber) along with how many it uses, and it is renumbered to fit
+ * wherever it ends up. The code of a function that consults the Mips
+ * translator's spill state from the function before it (see
+ * Mips::DependsOnLastUsed) depends on more than its own text, and is
+ * never stored.
+ */
+
+#ifndef _H_codecache
+#define _H_codecache
+
+#include <string>
+using std::string;
+
+// The assembly for one function, with labels, temps and strings
+// numbered from zero, and how many of each it uses
+struct CachedCode {
+  int numLabels, numTemps, numStrings;
+  string text;
+};
+
+// A 128-bit FNV-1a hash, for naming entries
+class Hasher {
+  private:
+    unsigned __int128 hash;
+
+  public:
+    Hasher();
+    void Add(const char *bytes, size_t len);
+    void Add(const string &s) { Add(s.data(), s.size()); }
+
+         // Adds the text of the function declared starting at text, up
+         // to the brace closing its body, leaving out comments and any
+         // white space not needed to keep two tokens apart
+    void AddFunctionText(const char *text);
+
+         // Returns the hash as 32 hex digits
+    string Digest() const;
+};
+
+class CodeCache {
+  private:
+    string dir;
+
+  public:
+         // Uses the given directory, which is made if need be. Reports
+         // the problem and exits if it can't be.
+    CodeCache(const char *dir);
+
+         // Returns the key for the code of the function with the given
+         // label and text, whose description of what it refers to has
+         // the given digest, with or without the Tac comments
+    string KeyFor(const string &depsDigest, const char *label,
+                  const char *text, bool tacComments);
+
+         // Returns the entry for key, or NULL if there is none, for the
+         // caller to delete. May be called from any thread.
+    CachedCode *Lookup(const string &key);
+
+         // Adds an entry for key. May be called from any thread; if two
+         // store the same key, either entry is kept. A failure to write
+         // the entry is not an error.
+    void Store(const string &key, const CachedCode &code);
+
+         // Returns len bytes of assembly at text with delta added to the
+         // numbers of its labels, temps and string constants
+    static string Renumber(const char *text, size_t len, int labelDelta,
+                           int tempDelta, int stringDelta);
+};
+
+#endif
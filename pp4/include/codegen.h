@@ -15,20 +15,34 @@
 #define _H_codegen
 
 #include <stdlib.h>
+#include <stack>
+#include <vector>
 #include "list.h"
 #include "tac.h"
+#include "codecache.h"
+using std::stack;
+using std::vector;
  
 
               // These codes are used to identify the built-in functions
 typedef enum { Alloc, ReadLine, ReadInteger, StringEqual,
                PrintInt, PrintString, PrintBool, Halt, NumBuiltIns } BuiltIn;
 
-class CodeGenerator {
+class CodeGenerator : public InArena<CodeGenerator> {
   private:
     List<Instruction*> *code;
 
-    int localOffset;
+    int localOffset;           // next free slot in the current frame
+    BeginFunc *curFunc;        // BeginFunc awaiting its frame size
     bool mainDefined;
+    int firstLabelNum, nextLabelNum;
+    int firstTempNum, nextTempNum;
+    vector<char*> labels;      // made by NewLabel, in order
+    vector<Location*> temps;   // made by GenTempVar, in order
+    int numStrings;            // string constants loaded
+    CachedCode *cached;        // the part's code, if found in the cache
+    string cacheKey;           // where to store the code, if anywhere
+    stack<const char*> breakLabels; // exits of the enclosing loops
   public:
            // Here are some class constants to remind you of the offsets
            // used for globals, locals, and parameters. You will be
@@ -47,7 +61,28 @@ class CodeGenerator {
                      OffsetToFirstGlobal = 0;
     static const int VarSize = 4;
 
+         // A code generator holds the code for part of the program (see
+         // Program::Emit)
     CodeGenerator();
+
+         // A part numbers its labels and temps from 0 as it is
+         // generated, so the parts can be generated side by side. Once
+         // it is complete, this numbers them on from those of the parts
+         // that come before instead.
+    void NumberFrom(int labelNum, int tempNum);
+    int NumLabels() const  { return nextLabelNum - firstLabelNum; }
+    int NumTemps() const   { return nextTempNum - firstTempNum; }
+
+         // Takes the code for this part from the cache, instead of
+         // generating any
+    void UseCachedCode(CachedCode *code);
+
+         // Has the code generated for this part stored in the cache
+         // under key, once it has been translated
+    void StoreInCache(const string &key) { cacheKey = key; }
+
+         // Adds the code of the built-in functions
+    void GenBuiltIns();
     
          // Assigns a new unique label name and returns it. Does not
          // generate any Tac instructions (see GenLabel below if needed)
@@ -147,9 +182,19 @@ class CodeGenerator {
     void GenReturn(Location *val = NULL);
     void GenLabel(const char *label);
 
+         // A loop pushes the label just past it while its body is
+         // generated, so a break inside can jump to the innermost one
+    void PushBreakLabel(const char *label);
+    void PopBreakLabel();
+    const char *GetBreakLabel();
+
 
          // These methods generate the Tac instructions that mark the start
-         // and end of a function/method definition. 
+         // and end of a function/method definition. Each function starts
+         // allocating its locals and temps at OffsetToFirstLocal again;
+         // since locals only ever grow downward, the offset reached at
+         // GenEndFunc is the frame's high-water mark and is backpatched
+         // into the function's BeginFunc as its frame size.
     BeginFunc *GenBeginFunc();
     void GenEndFunc();
 
@@ -163,12 +208,14 @@ class CodeGenerator {
 
 
          // Emits the final "object code" for the program by
-         // translating the sequence of Tac instructions into their mips
-         // equivalent and printing them out to stdout. If the debug
+         // translating the sequences of Tac instructions of its parts,
+         // in order, into their mips equivalent and printing them out
+         // to the output of the current compilation (stdout unless it
+         // is one of a batch, see compilation.h). If the debug
          // flag tac is on (-d tac), it will not translate to MIPS,
          // but instead just print the untranslated Tac. It may be
          // useful in debugging to first make sure your Tac is correct.
-    void DoFinalCodeGen();
+    static void DoFinalCodeGen(const vector<CodeGenerator*> &parts);
 };
 
 #endif
@@ -0,0 +1,160 @@
+/* File: compilation.h
+ * -------------------
+ * A Compilation holds the state that belongs to compiling one program:
+ * its source text and scanner, the table of its interned names, the
+ * arena owning its parse tree and everything made from it (see InArena
+ * in arena.h), the global scope, its canonical types, the error count,
+ * the debug keys in effect, the streams its output and diagnostics go
+ * to, the code cache, if any, whether the assembly is commented with
+ * the Tac it comes from, and whether the parse tree comes from, or goes
+ * to, an AST file instead. The code generator and the Mips translator
+ * it creates keep their own label, temp and string counters, so nothing
+ * about a program lives in global variables, any number of compilations
+ * may run at once, one per thread, and all the memory a program takes
+ * is released when its compilation is destroyed.
+ *
+ * Rather than thread the compilation through every node method, the
+ * compilation that the calling thread is working on is available from
+ * Compilation::Current(). It is set for the duration of Compile(),
+ * and on the threads helping with it while a pass runs in parallel (see
+ * RunInParallel).
+ * Sample usage:
+ *
+ *       SourceBuffer source;
+ *       string problem;
+ *       if (!source.Map(path, &problem))
+ *           ...
+ *       Compilation c(&source, stdout, &cerr, 4);
+ *       int numErrors = c.Compile();
+ */
+
+#ifndef _H_compilation
+#define _H_compilation
+
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <vector>
+#include "arena.h"
+#include "scanner.h"
+#include "symbols.h"
+using namespace std;
+
+class AstFile;
+class CodeCache;
+class PhaseTimer;
+class Program;
+class SourceBuffer;
+class Scope;
+class ThreadPool;
+class TypeContext;
+
+// The phases of compiling a program: parsing, checking (BuildScope
+// and the checks), generating Tac (PreEmit and Emit) and translating it
+// to MIPS and writing it out (DoFinalCodeGen)
+enum Phase { ParsePhase, CheckPhase, EmitPhase, FinalPhase, NumPhases };
+
+// What -d timing reports about a compilation (see Compile). Any of the
+// compilation's threads may add to the counts.
+struct CompileStats {
+    double seconds[NumPhases] = {};
+    long peakKB[NumPhases] = {};    // the process's peak RSS by the end
+
+    atomic<long> tokens{0}, nodes{0}, scopes{0}, decls{0};
+    atomic<long> instructions{0}, spills{0}, asmBytes{0};
+};
+
+class Compilation {
+  private:
+    static thread_local Compilation *current;
+    static thread_local ostream *taskErr;  // set while running a task
+
+    int numThreads;            // for its own passes, 0 for one per processor
+    ThreadPool *pool;          // made the first time a pass is run in parallel
+    PhaseTimer *parseTimer;    // running until the parse tree is complete
+    vector<Arena*> poolArenas; // for what the pool's other threads make
+
+  public:
+    SourceBuffer *source;
+    yyscan_t scanner;          // valid while Compile() runs
+    SymbolTable symbols;       // the program's interned names
+    Arena arena;               // owns the tree and all made from it
+    Scope *globalScope;
+    TypeContext *types;        // the program's named and array types
+    atomic<int> numErrors;
+    vector<const char*> debugKeys; // starts as the creator's keys
+    FILE *out;                 // generated code and debug printing
+    ostream *err;              // error messages
+    CodeCache *cache;          // for generated code, NULL if none
+    bool tacComments;          // echo the Tac in the assembly, as comments
+    bool emitAst;              // write the tree to out instead of code
+    AstFile *astInput;         // load the tree from here, not source, if set
+    CompileStats stats;
+
+    Compilation(SourceBuffer *src, FILE *out, ostream *err, int numThreads = 1);
+    ~Compilation();
+
+         // Parses, checks and generates code for the source and returns
+         // the number of errors reported. A compilation is only run once.
+    int Compile();
+
+         // Goes on from the complete parse tree: checks it and, if no
+         // errors were found, generates its code, or with emitAst writes
+         // the tree to out as an AST file
+    void Translate(Program *program);
+
+         // Returns the compilation being run by the calling thread, or
+         // NULL if there is none
+    static Compilation *Current() { return current; }
+
+         // Marks the end of parsing for -d timing, once the parse tree
+         // is complete (checking it and generating code follow before
+         // yyparse returns)
+    void EndParse();
+
+         // Calls task(i) for each i in [0, n), spread over the
+         // compilation's threads if it has several and n is big enough
+         // to be worth it. Each task's error messages are held back and
+         // written out in order of i once all are done, so the output is
+         // the same as calling them one after the other. The tasks must
+         // not change anything outside the part of the tree they work on.
+    void RunInParallel(int n, const function<void(int)> &task);
+
+         // Returns true if RunInParallel would use several threads for
+         // n tasks
+    bool RunsInParallel(int n) const;
+
+         // Where the calling thread should report errors and allocate
+         // nodes: normally err and arena, but a task running in
+         // parallel has its own
+    ostream &ErrorStream() { return taskErr ? *taskErr : *err; }
+    Arena &NodeArena()     { return *Arena::Current(); }
+
+         // Returns true if p was allocated from one of the arenas
+    bool Owns(const void *p) const;
+
+  private:
+    Compilation(const Compilation&);        // compilations are not copied
+    Compilation& operator=(const Compilation&);
+
+    void ReportStats(double totalSeconds);
+};
+
+// Adds the time from its construction until it is stopped (or
+// destroyed) to the current compilation's time for the phase
+class PhaseTimer {
+  private:
+    Phase phase;
+    bool running;
+    chrono::steady_clock::time_point start;
+
+  public:
+    PhaseTimer(Phase p)
+      : phase(p), running(true), start(chrono::steady_clock::now()) {}
+    ~PhaseTimer() { Stop(); }
+    void Stop();
+};
+
+#endif
@@ -36,12 +36,12 @@ class Operator;
  * the class name, e.g.
  *
  *    if (missingEnd) { 
- *       ReportError::UntermString(&yylloc, str);
+ *       ReportError::UntermString(*yylloc, str);
  *    }
  *
- * For some methods, the first argument is the pointer to the location
- * structure that identifies where the problem is (usually this is the
- * location of the offending token). You can pass NULL for the argument
+ * For some methods, the first argument is the source range that
+ * identifies where the problem is (usually this is the location of the
+ * offending token). You can pass an empty SourceRange() for the argument
  * if there is no appropriate position to point out. For other methods,
  * location is accessed by messaging the node in error which is passed
  * as an argument. You cannot pass NULL for these arguments.
@@ -54,9 +54,9 @@ class ReportError {
 
   // Errors used by scanner
   static void UntermComment(); 
-  static void LongIdentifier(yyltype *loc, const char *ident);
-  static void UntermString(yyltype *loc, const char *str);
-  static void UnrecogChar(yyltype *loc, char ch);
+  static void LongIdentifier(SourceRange loc, const char *ident);
+  static void UntermString(SourceRange loc, const char *str);
+  static void UnrecogChar(SourceRange loc, char ch);
 
   
   // Errors used by semantic analyzer for declarations
@@ -102,16 +102,16 @@ class ReportError {
   static void NoMainFound();
 
   // Generic method to report a printf-style error message
-  static void Formatted(yyltype *loc, const char *format, ...);
+  static void Formatted(SourceRange loc, const char *format, ...);
 
 
-  // Returns number of error messages printed
-  static int NumErrors() { return numErrors; }
+  // Returns number of error messages printed by the current compilation
+  static int NumErrors();
   
  private:
-  static void UnderlineErrorInLine(const char *line, yyltype *pos);
-  static void OutputError(yyltype *loc, string msg);
-  static int numErrors;
+  static void UnderlineErrorInLine(const char *line, int len,
+                                   int firstColumn, int lastColumn);
+  static void OutputError(SourceRange loc, string msg);
 };
   
 // Wording to use for runtime error messages
@@ -1,10 +1,11 @@
 /* File: hashtable.h
  * -----------------
  * This is a simple table for storing values associated with a string
- * key, supporting simple operations for Enter and Lookup.  It is not
- * much more than a thin cover over the STL associative map container,
- * but hides the awkward C++ template syntax and provides a more
- * familiar interface.
+ * key, supporting simple operations for Enter and Lookup.  It is an
+ * open-addressing hash table: entries live directly in one flat array
+ * of slots and collisions are resolved by linear probing, so a lookup
+ * usually touches a single cache line and entering a key does not
+ * allocate (other than when the slot array grows).
  *
  * The keys are always strings, but the values can be of any type
  * (ok, that's actually kind of a fib, it expects the type to be
@@ -16,9 +17,11 @@
  * The same notation is used on the matching iterator for the table,
  * i.e. a Hashtable<char*> supports an Iterator<char*>.
  *
- * An iterator is provided for iterating over the entries in a table. 
+ * An iterator is provided for iterating over the entries in a table.
  * The iterator walks through the values, one by one, in alphabetical
- * order by the key. Sample iteration usage:
+ * order by the key. Since the table itself is unordered, the iterator
+ * takes a sorted snapshot of the entries when it is created. Sample
+ * iteration usage:
  *
  *       void PrintNames(Hashtable<Decl*> *table)
  *       {
@@ -33,32 +36,44 @@
 #ifndef _H_hashtable
 #define _H_hashtable
 
-#include <map>
 #include <string.h>
+#include <vector>
+#include "symbols.h"
 using namespace std;
-    
-struct ltstr {
-  bool operator()(const char* s1, const char* s2) const
-  { return strcmp(s1, s2) < 0; }
-};
 
 
-template <class Value> class Iterator; 
- 
+template <class Value> class Iterator;
+
 template<class Value> class Hashtable {
 
-  private: 
-     multimap<const char*, Value, ltstr> mmap;
- 
+  private:
+     struct Slot {
+        const char *key;          // interned copy, NULL if slot is empty
+        unsigned int hash;
+        Value value;              // lastmost entered value for key
+        vector<Value> *shadowed;  // earlier values (oldest first) or NULL
+     };
+
+     Slot *slots;
+     int capacity;                // always 0 or a power of 2
+     int numKeys;                 // distinct keys in use
+     int numEntries;              // values, including shadowed ones
+
+     static unsigned int Hash(const char *key);
+     Slot *Find(const char *key, unsigned int hash) const;
+     void Grow();
+     void RemoveSlot(Slot *slot);
+
    public:
             // ctor creates a new empty hashtable
-     Hashtable() {}
+     Hashtable() : slots(NULL), capacity(0), numKeys(0), numEntries(0) {}
+     ~Hashtable();
 
            // Returns number of entries currently in table
      int NumEntries() const;
 
            // Associates value with key. If a previous entry for
-           // key exists, the bool parameter controls whether 
+           // key exists, the bool parameter controls whether
            // new value overwrites the previous (removing it from
            // from the table entirely) or just shadows it (keeps previous
            // and adds additional entry). The lastmost entered one for an
@@ -81,6 +96,9 @@ template<class Value> class Hashtable {
           // visit each value in the table in alphabetical order.
      Iterator<Value> GetIterator();
 
+  private:
+     Hashtable(const Hashtable&);           // tables are not copied
+     Hashtable& operator=(const Hashtable&);
 };
 
 
@@ -88,16 +106,16 @@ template<class Value> class Hashtable {
  * sample usage above for how to iterate over a hashtable using an
  * iterator.
  */
-template <class Value> 
+template <class Value>
 class Iterator {
 
   friend class Hashtable<Value>;
 
   private:
-    typename multimap<const char*, Value , ltstr>::iterator cur, end;
-    Iterator(multimap<const char*, Value, ltstr>& t)
-	: cur(t.begin()), end(t.end()) {}
-	 
+    vector<Value> values;        // snapshot in alphabetical key order
+    size_t cur;
+    Iterator() : cur(0) {}
+
   public:
          // Returns current value and advances iterator to next.
          // Returns NULL when there are no more values in table
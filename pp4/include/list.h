@@ -3,24 +3,29 @@
  * ------------
  * Simple list class for storing a linear collection of elements. It
  * supports operations similar in name to the CS107 CVector -- nth, insert,
- * append, remove, etc.  This class is nothing more than a very thin
- * cover of a STL deque, with some added range-checking. Given not everyone
- * is familiar with the C++ templates, this class provides a more familiar
- * interface.
+ * append, remove, etc.  The elements are kept in one contiguous array,
+ * with range-checking on access by index. Given not everyone is familiar
+ * with the C++ templates, this class provides a more familiar interface.
  *
- * It can handle elements of any type, the typename for a List includes the
- * element type in angle brackets, e.g.  to store elements of type double,
- * you would use the type name List<double>, to store elements of type
- * Decl *, it woud be List<Decl*> and so on.
+ * It can handle elements of any type that can be copied byte for byte,
+ * the typename for a List includes the element type in angle brackets,
+ * e.g.  to store elements of type double, you would use the type name
+ * List<double>, to store elements of type Decl *, it woud be List<Decl*>
+ * and so on.
+ *
+ * Most lists in a parse tree (formals, actuals, implements, the
+ * statements of a small block) hold only a few elements, so the first
+ * few are kept inside the List itself, and only a longer list allocates
+ * an array. A loop over a whole list is best written with begin/end,
+ * which needs no range checks. A list made with new while a compilation
+ * runs belongs to its arena (see InArena in arena.h).
  *
  * Here is some sample code illustrating the usage of a List of integers
  *
  *   int Sum(List<int> *list) {
  *       int sum = 0;
- *       for (int i = 0; i < list->NumElements(); i++) {
- *          int val = list->Nth(i);
+ *       for (int val : *list)
  *          sum += val;
- *       }
  *       return sum;
  *    }
  */
@@ -28,24 +33,64 @@
 #ifndef _H_list
 #define _H_list
 
-#include <deque>
+#include <stdlib.h>
+#include <string.h>
+#include <type_traits>
+#include "arena.h"
 #include "utility.h"  // for Assert()
 using namespace std;
 
 class Node;
 
-template<class Element> class List {
+template<class Element> class List : public InArena<List<Element>> {
+    static_assert(is_trivially_copyable<Element>::value,
+                  "List elements are moved with memcpy");
 
  private:
-    deque<Element> elems;
+    static const int InlineCapacity = 4;
+
+    Element *elems;            // inlineElems, or an array on the heap
+    int numElems, capacity;
+    Element inlineElems[InlineCapacity];
+
+    void Grow(int minCapacity)
+	{ int newCapacity = 2 * capacity;
+	  if (newCapacity < minCapacity) newCapacity = minCapacity;
+	  Element *grown = (Element *)(elems == inlineElems
+	      ? malloc(newCapacity * sizeof(Element))
+	      : realloc(elems, newCapacity * sizeof(Element)));
+	  if (grown == NULL) Failure("Out of memory");
+	  if (elems == inlineElems)
+	      memcpy(grown, inlineElems, numElems * sizeof(Element));
+	  elems = grown;
+	  capacity = newCapacity; }
 
  public:
            // Create a new empty list
-    List() {}
+    List() : elems(inlineElems), numElems(0), capacity(InlineCapacity) {}
+
+    List(const List &other) : List() { *this = other; }
+
+    List &operator=(const List &other)
+	{ if (this != &other) {
+	      numElems = 0;
+	      Reserve(other.numElems);
+	      memcpy(elems, other.elems, other.numElems * sizeof(Element));
+	      numElems = other.numElems;
+	  }
+	  return *this; }
+
+    ~List()
+	{ if (elems != inlineElems) free(elems); }
 
            // Returns count of elements currently in list
     int NumElements() const
-	{ return elems.size(); }
+	{ return numElems; }
+
+          // Makes room for n elements in all, so that appending up to
+          // that many does not move the list
+    void Reserve(int n)
+	{ if (n > capacity) Grow(n); }
 
           // Returns element at index in list. Indexing is 0-based.
           // Raises an assert if index is out of range.
@@ -57,28 +102,42 @@ template<class Element> class List {
           // Raises assert if index out of range
     void InsertAt(const Element &elem, int index)
 	{ Assert(index >= 0 && index <= NumElements());
-	  elems.insert(elems.begin() + index, elem); }
+	  Element copy = elem;     // elem may be in the list
+	  if (numElems == capacity) Grow(numElems + 1);
+	  memmove(elems + index + 1, elems + index,
+	          (numElems - index) * sizeof(Element));
+	  elems[index] = copy;
+	  numElems++; }
 
           // Adds element to list end
     void Append(const Element &elem)
-	{ elems.push_back(elem); }
+	{ Element copy = elem;
+	  if (numElems == capacity) Grow(numElems + 1);
+	  elems[numElems++] = copy; }
 
          // Removes element at index, shuffling down others
          // Raises assert if index out of range
     void RemoveAt(int index)
 	{ Assert(index >= 0 && index < NumElements());
-	  elems.erase(elems.begin() + index); }
-          
+	  memmove(elems + index, elems + index + 1,
+	          (numElems - index - 1) * sizeof(Element));
+	  numElems--; }
+
+         // For iterating over the elements in order
+    Element *begin()             { return elems; }
+    Element *end()               { return elems + numElems; }
+    const Element *begin() const { return elems; }
+    const Element *end() const   { return elems + numElems; }
+
        // These are some specific methods useful for lists of ast nodes
        // They will only work on lists of elements that respond to the
        // messages, but since C++ only instantiates the template if you use
-       // you can still have Lists of ints, chars*, as long as you 
+       // you can still have Lists of ints, chars*, as long as you
        // don't try to SetParentAll on that list.
     void SetParentAll(Node *p)
-        { for (int i = 0; i < NumElements(); i++)
-             Nth(i)->SetParent(p); }
+        { for (Element e : *this)
+             e->SetParent(p); }
 
 };
 
 #endif
-
@@ -2,35 +2,57 @@
  * ----------------
  * This file just contains features relative to the location structure
  * used to record the lexical position of a token or symbol.  This file
- * establishes the cmoon definition for the yyltype structure, the global
- * variable yylloc, and a utility function to join locations you might
- * find handy at times.
+ * establishes the cmoon definition for the yyltype structure and a
+ * utility function to join locations you might find handy at times.
  */
 
 #ifndef YYLTYPE
 
+#include <stdint.h>
+
+static const uint32_t NoOffset = 0xFFFFFFFFu;
+
+/* Struct: SourceRange
+ * -------------------
+ * Where something is in the source, as offsets into the source buffer
+ * (see source.h): begin is that of its first character and end of the
+ * one just past its last. This is all a node keeps of its location; the
+ * line and columns an error gives are worked out from the offsets when
+ * it is reported (see SourceBuffer::Position). A range with no place in
+ * the source has both offsets NoOffset.
+ */
+struct SourceRange
+{
+    uint32_t begin, end;
+
+    SourceRange() : begin(NoOffset), end(NoOffset) {}
+    SourceRange(uint32_t b, uint32_t e) : begin(b), end(e) {}
+    inline SourceRange(const struct yyltype &loc);
+    bool IsValid() const { return begin != NoOffset; }
+};
+
 /* Typedef: yyltype
  * ----------------
  * Defines the struct type that is used by the scanner to store
- * position information about each lexeme scanned.
+ * position information about each lexeme scanned. The parser hands
+ * it on to the nodes it makes, which keep just the range.
  */
 typedef struct yyltype
 {
     int timestamp;                 // you can ignore this field
     int first_line, first_column;
     int last_line, last_column;      
-    char *text;                    // you can also ignore this field
+    uint32_t begin, end;           // the lexeme's SourceRange
 } yyltype;
 
-#define YYLTYPE yyltype
+inline SourceRange::SourceRange(const yyltype &loc)
+    : begin(loc.begin), end(loc.end) {}
 
+#define YYLTYPE yyltype
 
-/* Global variable: yylloc
- * ------------------------
- * The global variable holding the position information about the
- * lexeme just scanned.
- */
-extern struct yyltype yylloc;
+// yyltype is plain data, so a C++ parser may grow its stacks by copying
+// them; without this they are stuck at their initial 200 entries
+#define YYLTYPE_IS_TRIVIAL 1
 
 
 /* Function: Join
@@ -45,15 +67,32 @@ inline yyltype Join(yyltype first, yyltype last)
   combined.first_line = first.first_line;
   combined.last_column = last.last_column;
   combined.last_line = last.last_line;
+  combined.begin = first.begin;
+  combined.end = last.end;
   return combined;
 }
 
-/* Same as above, except operates on pointers as a convenience  */
-inline yyltype Join(yyltype *firstPtr, yyltype *lastPtr)
+/* Same as above, for the ranges nodes keep */
+inline SourceRange Join(SourceRange first, SourceRange last)
 {
-  return Join(*firstPtr, *lastPtr);
+  return SourceRange(first.begin, last.end);
 }
 
+/* The location bison gives a rule's left-hand side, which is that of
+ * its right-hand side joined up, or empty (with no range) for an empty
+ * right-hand side. Bison's own leaves the range unset.
+ */
+#define YYLLOC_DEFAULT(Current, Rhs, N)                                 \
+  do {                                                                  \
+    if (N) {                                                            \
+      (Current) = Join((Rhs)[1], (Rhs)[N]);                             \
+    } else {                                                            \
+      (Current).first_line = (Current).last_line = (Rhs)[0].last_line;  \
+      (Current).first_column = (Current).last_column = (Rhs)[0].last_column; \
+      (Current).begin = (Current).end = NoOffset;                       \
+    }                                                                   \
+  } while (0)
+
 
 #endif
 
@@ -18,8 +18,11 @@
 #ifndef _H_mips
 #define _H_mips
 
+#include <vector>
 #include "tac.h"
 #include "list.h"
+using std::vector;
+class AsmWriter;
 class Location;
 
 
@@ -37,7 +40,17 @@ class Mips {
 	bool isGeneralPurpose;
     } regs[NumRegs];
 
+         // The register holding each variable, or zero if none, found
+         // by its slot: the locals and temps of the function below the
+         // frame pointer, its parameters above, and the globals
+    vector<Register> localRegs, paramRegs, globalRegs;
+
     Register lastUsed;
+    bool lastUsedRead;         // whether a spill choice started from lastUsed
+    int numSpills;             // registers taken from a variable to reuse
+    AsmWriter *out;
+    bool tacComments;          // echo each Tac instruction as a comment
+    int strNum;                // number for the next string constant label
 
     typedef enum { ForRead, ForWrite } Reason;
 
@@ -45,6 +58,7 @@ class Mips {
     Register GetRegister(Location *var, Register avoid1 = zero);
     Register GetRegisterForWrite(Location *var, Register avoid1 = zero, Register avoid2 = zero);
     bool FindRegisterWithContents(Location *var, Register& reg);
+    Register &RegisterHolding(Location *var);
     Register SelectRegisterToSpill(Register avoid1, Register avoid2);
     void SpillRegister(Register reg);
     void SpillAllDirtyRegisters();
@@ -52,14 +66,26 @@ class Mips {
 
     void EmitCallInstr(Location *dst, const char *fn, bool isL);
     
-    static const char *mipsName[BinaryOp::NumOps];
+    static const char * const mipsName[BinaryOp::NumOps];
     static const char *NameForTac(BinaryOp::OpCode code);
 
  public:
     
-    Mips();
+    Mips(AsmWriter *out, int firstStringNum = 1, int lastUsed = zero,
+         bool tacComments = true);
+
+         // The register last chosen for spilling carries over from one
+         // function to the next. To translate a program in parts, a
+         // part can be started from a given one, and it only needs to
+         // be the right one if the part depends on it; if it doesn't,
+         // the part leaves it unchanged.
+    int GetLastUsed() const         { return lastUsed; }
+    bool DependsOnLastUsed() const  { return lastUsedRead; }
+
+    int NumSpills() const           { return numSpills; }
+    bool TacComments() const        { return tacComments; }
 
-    static void Emit(const char *fmt, ...);
+    void Emit(const char *fmt, ...);
     
     void EmitLoadConstant(Location *dst, int val);
     void EmitLoadStringConstant(Location *dst, const char *str);
@@ -3,6 +3,10 @@
  * You should not need to modify this file. It declare a few constants,
  * types, variables,and functions that are used and/or exported by
  * the lex-generated scanner.
+ *
+ * The scanner is reentrant: all of its state hangs off a yyscan_t
+ * handle, created by InitScanner, which the parser passes back to each
+ * yylex call.
  */
 
 #ifndef _H_scanner
@@ -10,14 +14,23 @@
 
 #include <stdio.h>
 
-#define MaxIdentLen 31    // Maximum length for identifiers
+class SourceBuffer;
+union YYSTYPE;
+struct yyltype;
 
-extern char *yytext;      // Text of lexeme just scanned
+#define MaxIdentLen 31    // Maximum length for identifiers
 
+#ifndef YY_TYPEDEF_YY_SCANNER_T   // same definition as in lex.yy.c
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void* yyscan_t;
+#endif
 
-int yylex();              // Defined in the generated lex.yy.c file
+                          // Defined in the generated lex.yy.c file
+int yylex(union YYSTYPE *lvalp, struct yyltype *llocp, yyscan_t scanner);
 
-void InitScanner();                 // Defined in scanner.l user subroutines
-const char *GetLineNumbered(int n); // ditto
+yyscan_t InitScanner(SourceBuffer *src);     // Defined in scanner.l user subroutines
+void FreeScanner(yyscan_t scanner);          // ditto
+const char *GetLineNumbered(yyscan_t scanner, int n, int *len); // ditto
+int NumTokensScanned(yyscan_t scanner);      // ditto
  
 #endif
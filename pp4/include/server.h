@@ -0,0 +1,46 @@
+/* File: server.h
+ * --------------
+ * With --server, dcc stays resident and compiles one program after
+ * another, so a test farm running thousands of small programs pays for
+ * starting the compiler once instead of once per program. Each program
+ * gets a Compilation of its own, so nothing carries over from one
+ * request to the next.
+ *
+ * Requests and replies are framed the same way: the length in bytes as
+ * a decimal number and a newline, followed by that many bytes. A request
+ * is one frame holding the source of a program. The reply is two frames:
+ * first the generated code (or -d tac listing), which is empty if the
+ * program has errors, then the error messages, which are empty if it
+ * has none. For example, a client sends
+ *
+ *       25\nvoid main() { Print(1); }
+ *
+ * and reads back "<n>\n" and n bytes of assembly, then "0\n".
+ *
+ * The requests are read from stdin and the replies written to stdout,
+ * or, when a socket path is given, any number of clients can connect to
+ * a Unix domain socket at that path (an old socket there is replaced)
+ * and each is served on a thread of its own. A connection is closed
+ * when the client closes its end or sends a badly formed frame.
+ */
+
+#ifndef _H_server
+#define _H_server
+
+#include <stdio.h>
+
+class CodeCache;
+
+     // Serves requests read from in until it runs out, writing the
+     // replies to out. Returns 0, or -1 if a request was badly formed.
+     // The programs share cache, if not NULL, and their code has Tac
+     // comments if tacComments is set.
+int Serve(FILE *in, FILE *out, CodeCache *cache = NULL,
+          bool tacComments = true);
+
+     // Listens on a Unix domain socket at path and serves each
+     // connection. Only returns if the socket can't be set up, with -1.
+int ServeSocket(const char *path, CodeCache *cache = NULL,
+                bool tacComments = true);
+
+#endif
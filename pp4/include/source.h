@@ -0,0 +1,84 @@
+/* File: source.h
+ * --------------
+ * The SourceBuffer holds the complete text of the program being
+ * compiled. A source file named on the command line is mmap'd rather
+ * than read, so its text is never copied up front; without a file name
+ * the text is read from stdin into memory instead. Either way the
+ * scanner works directly on the buffer (see InitScanner), which is why
+ * it is followed by the two NUL bytes flex expects at the end of an
+ * in-place buffer, and why it is writable: flex briefly stores a NUL
+ * after each lexeme while running its action.
+ *
+ * When the text is loaded, a table of line-start offsets is built, so
+ * the error reporter can fetch any line for context without the scanner
+ * having to copy each line as it goes past. The same table turns the
+ * offsets nodes keep (see SourceRange in location.h) back into the
+ * line and column the scanner would have given.
+ */
+
+#ifndef _H_source
+#define _H_source
+
+#include <stdio.h>
+#include <mutex>
+#include <string>
+#include <vector>
+using std::string;
+using std::vector;
+
+class SourceBuffer {
+  private:
+    char *text;
+    unsigned int length;            // not counting the trailing NULs
+    size_t mappedBytes;             // size of mapping, 0 if text was read
+    bool borrowed;                  // text belongs to someone else
+    vector<unsigned int> lineStarts; // offset of first char of each line
+    vector<bool> inComment;         // whether each line starts in a comment
+    std::mutex inCommentLock;       // for inComment, filled in on demand
+
+    void IndexLines();
+    bool StartsInComment(int line);
+
+  public:
+    static const int TabSize = 8;   // tab stops, as the scanner counts columns
+
+    SourceBuffer() : text(NULL), length(0), mappedBytes(0), borrowed(false) {}
+    ~SourceBuffer();
+
+         // Maps the named file into memory. Returns false, with the
+         // problem described in *problem, if the file can't be opened
+         // or mapped.
+    bool Map(const char *path, string *problem);
+
+         // Reads the rest of f into memory
+    void Read(FILE *f);
+
+         // Reads exactly len bytes of f into memory. Returns false if
+         // f ends first.
+    bool Read(FILE *f, unsigned int len);
+
+         // Uses the len bytes at text, which must be writable and
+         // followed by the two NULs, without copying them. They must
+         // outlast the buffer, which leaves them be.
+    void Borrow(char *text, unsigned int len);
+
+    char *Text()                 { return text; }
+    unsigned int Length() const  { return length; }
+    int NumLines() const         { return lineStarts.size(); }
+
+         // Returns the start of line num (counting from 1) and sets len
+         // to its length without the newline. Returns NULL if there is
+         // no such line.
+    const char *Line(int num, int *len) const;
+
+         // Sets line and column (counting from 1) to those the scanner
+         // gives the character at offset, a tab taking it to the next
+         // tab stop except in a string constant or // comment
+    void Position(unsigned int offset, int *line, int *column);
+
+  private:
+    SourceBuffer(const SourceBuffer&);      // buffers are not copied
+    SourceBuffer& operator=(const SourceBuffer&);
+};
+
+#endif
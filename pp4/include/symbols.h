@@ -0,0 +1,59 @@
+/* File: symbols.h
+ * ---------------
+ * The Symbols class manages the tables of interned names used by the
+ * compiler. Interning a string returns a canonical pointer for its
+ * contents: two calls with equal strings always return the very same
+ * pointer, so once every identifier, type name and label has been
+ * interned, names can be compared with == instead of strcmp.
+ *
+ * The scanner interns each identifier as it is recognized and hands
+ * the resulting handle to the parser in yylval.identifier, so all the
+ * Identifier nodes in the tree already hold interned names. Interned
+ * strings must not be modified.
+ *
+ * Each compilation has a SymbolTable of its own, so compilations
+ * running side by side never wait on one another, and the names of a
+ * program are freed along with the rest of it. Symbols::Intern uses the
+ * table of the compilation the calling thread is working on (see
+ * Compilation::Current); outside of any compilation it uses a table
+ * that lasts for the life of the process.
+ */
+
+#ifndef _H_symbols
+#define _H_symbols
+
+#include <mutex>
+#include <string_view>
+#include <unordered_set>
+#include "arena.h"
+
+class SymbolTable {
+  private:
+    static thread_local SymbolTable *current;
+
+    // The table holds views of the canonical copies, which are kept in
+    // their own arena so they stay put for the life of the table. The
+    // threads helping with a compilation may intern too, so it is
+    // locked, but no other compilation ever takes the lock.
+    std::unordered_set<std::string_view> table;
+    Arena text;
+    std::mutex lock;
+
+  public:
+    const char *Intern(const char *str, int len);
+    int NumSymbols();
+
+         // The table Symbols::Intern uses on the calling thread, NULL
+         // for the process-wide one
+    static SymbolTable *Current()             { return current; }
+    static void SetCurrent(SymbolTable *t)    { current = t; }
+};
+
+class Symbols {
+  public:
+         // Returns the canonical copy of str (or of its first len chars)
+    static const char *Intern(const char *str);
+    static const char *Intern(const char *str, int len);
+};
+
+#endif
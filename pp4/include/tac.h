@@ -22,7 +22,11 @@
 #ifndef _H_tac
 #define _H_tac
 
+#include <stdio.h>
+#include <string>
+#include "arena.h"
 #include "list.h" // for VTable
+using std::string;
 class Mips;
 
 
@@ -33,20 +37,37 @@ class Mips;
 // For example, a declaration for integer num as the first local
 // variable in a function would be assigned a Location object
 // with name "num", segment fpRelative, and offset -8.
+// A temp has a number instead of a name, and is only given a name
+// ("_tmp" and the number) when it is printed.
 
 typedef enum {fpRelative, gpRelative} Segment;
 
-class Location
+class Location : public InArena<Location>
 {
 protected:
-    const char *variableName;
+    const char *variableName;  // a declared name, NULL for a temp
     Segment segment;
     int offset;
+    int tempNum;               // for a temp, its number
 
 public:
     Location(Segment seg, int offset, const char *name);
-
-    const char *GetName()           { return variableName; }
+    Location(int offset, int tempNum); // a temp, on the stack
+
+         // The text of a location's name, kept for as long as the Name
+         // is, e.g. printf("%s", loc->GetName().Text())
+    class Name {
+        const char *name;
+        char temp[16];
+      public:
+        Name(const char *name, int tempNum);
+        const char *Text() const    { return name ? name : temp; }
+    };
+
+    Name GetName()                  { return Name(variableName, tempNum); }
+    bool IsTemp()                   { return variableName == NULL; }
+    int GetTempNum()                { return tempNum; }
+    void SetTempNum(int num)        { tempNum = num; }
     Segment GetSegment()            { return segment; }
     int GetOffset()                 { return offset; }
 };
@@ -55,16 +76,25 @@ public:
 
 // base class from which all Tac instructions derived
 // has the interface for the 2 polymorphic messages: Print & Emit
+// An instruction keeps the labels it is given rather than a copy, so
+// a code generator can renumber its labels once its code is complete.
 
-class Instruction {
-protected:
-    char printed[128];
-
+class Instruction : public InArena<Instruction> {
 public:
-    virtual ~Instruction() {}
-    virtual void Print();
+    virtual void Print(FILE *out);
     virtual void EmitSpecific(Mips *mips) = 0;
     virtual void Emit(Mips *mips);
+
+         // Writes the Tac form of the instruction into buf, as snprintf
+         // does, and returns its length. The text is only made when it
+         // is printed, or echoed into the assembly as a comment; it is
+         // empty for an instruction that is never echoed.
+    virtual int Format(char *buf, size_t size) = 0;
+
+protected:
+         // Returns the Tac form, made in buf if it fits and otherwise
+         // in longer
+    const char *Text(char *buf, size_t size, string *longer);
 };
 
 
@@ -101,6 +131,7 @@ class LoadConstant: public Instruction {
 public:
     LoadConstant(Location *dst, int val);
     void EmitSpecific(Mips *mips);
+    int Format(char *buf, size_t size);
 };
 
 class LoadStringConstant: public Instruction {
@@ -109,6 +140,7 @@ class LoadStringConstant: public Instruction {
 public:
     LoadStringConstant(Location *dst, const char *s);
     void EmitSpecific(Mips *mips);
+    int Format(char *buf, size_t size);
 };
 
 class LoadLabel: public Instruction {
@@ -117,6 +149,7 @@ class LoadLabel: public Instruction {
 public:
     LoadLabel(Location *dst, const char *label);
     void EmitSpecific(Mips *mips);
+    int Format(char *buf, size_t size);
 };
 
 class Assign: public Instruction {
@@ -124,6 +157,7 @@ class Assign: public Instruction {
 public:
     Assign(Location *dst, Location *src);
     void EmitSpecific(Mips *mips);
+    int Format(char *buf, size_t size);
 };
 
 class Load: public Instruction {
@@ -132,6 +166,7 @@ class Load: public Instruction {
 public:
     Load(Location *dst, Location *src, int offset = 0);
     void EmitSpecific(Mips *mips);
+    int Format(char *buf, size_t size);
 };
 
 class Store: public Instruction {
@@ -140,6 +175,7 @@ class Store: public Instruction {
 public:
     Store(Location *d, Location *s, int offset = 0);
     void EmitSpecific(Mips *mips);
+    int Format(char *buf, size_t size);
 };
 
 class BinaryOp: public Instruction {
@@ -155,14 +191,16 @@ protected:
 public:
     BinaryOp(OpCode c, Location *dst, Location *op1, Location *op2);
     void EmitSpecific(Mips *mips);
+    int Format(char *buf, size_t size);
 };
 
 class Label: public Instruction {
     const char *label;
 public:
     Label(const char *label);
-    void Print();
+    void Print(FILE *out);
     void EmitSpecific(Mips *mips);
+    int Format(char *buf, size_t size);
 };
 
 class Goto: public Instruction {
@@ -170,6 +208,7 @@ class Goto: public Instruction {
 public:
     Goto(const char *label);
     void EmitSpecific(Mips *mips);
+    int Format(char *buf, size_t size);
 };
 
 class IfZ: public Instruction {
@@ -178,6 +217,7 @@ class IfZ: public Instruction {
 public:
     IfZ(Location *test, const char *label);
     void EmitSpecific(Mips *mips);
+    int Format(char *buf, size_t size);
 };
 
 class BeginFunc: public Instruction {
@@ -187,12 +227,14 @@ public:
     // used to backpatch the instruction with frame size once known
     void SetFrameSize(int numBytesForAllLocalsAndTemps);
     void EmitSpecific(Mips *mips);
+    int Format(char *buf, size_t size);
 };
 
 class EndFunc: public Instruction {
 public:
     EndFunc();
     void EmitSpecific(Mips *mips);
+    int Format(char *buf, size_t size);
 };
 
 class Return: public Instruction {
@@ -200,6 +242,7 @@ class Return: public Instruction {
 public:
     Return(Location *val);
     void EmitSpecific(Mips *mips);
+    int Format(char *buf, size_t size);
 };
 
 class PushParam: public Instruction {
@@ -207,6 +250,7 @@ class PushParam: public Instruction {
 public:
     PushParam(Location *param);
     void EmitSpecific(Mips *mips);
+    int Format(char *buf, size_t size);
 };
 
 class PopParams: public Instruction {
@@ -214,6 +258,7 @@ class PopParams: public Instruction {
 public:
     PopParams(int numBytesOfParamsToRemove);
     void EmitSpecific(Mips *mips);
+    int Format(char *buf, size_t size);
 };
 
 class LCall: public Instruction {
@@ -222,6 +267,7 @@ class LCall: public Instruction {
 public:
     LCall(const char *labe, Location *result);
     void EmitSpecific(Mips *mips);
+    int Format(char *buf, size_t size);
 };
 
 class ACall: public Instruction {
@@ -229,6 +275,7 @@ class ACall: public Instruction {
 public:
     ACall(Location *meth, Location *result);
     void EmitSpecific(Mips *mips);
+    int Format(char *buf, size_t size);
 };
 
 class VTable: public Instruction {
@@ -236,56 +283,57 @@ class VTable: public Instruction {
     const char *label;
 public:
     VTable(const char *labelForTable, List<const char *> *methodLabels);
-    void Print();
+    void Print(FILE *out);
     void EmitSpecific(Mips *mips);
+    int Format(char *buf, size_t size);
 };
 
 class _Alloc: public Instruction {
 public:
-    _Alloc();
     void EmitSpecific(Mips* mips);
+    int Format(char *buf, size_t size);
 };
 
 class _ReadLine: public Instruction {
 public:
-    _ReadLine();
     void EmitSpecific(Mips* mips);
+    int Format(char *buf, size_t size);
 };
 
 class _ReadInteger: public Instruction {
 public:
-    _ReadInteger();
     void EmitSpecific(Mips* mips);
+    int Format(char *buf, size_t size);
 };
 
 class _StringEqual: public Instruction {
 public:
-    _StringEqual();
     void EmitSpecific(Mips* mips);
+    int Format(char *buf, size_t size);
 };
 
 class _PrintInt: public Instruction {
 public:
-    _PrintInt();
     void EmitSpecific(Mips* mips);
+    int Format(char *buf, size_t size);
 };
 
 class _PrintString: public Instruction {
 public:
-    _PrintString();
     void EmitSpecific(Mips* mips);
+    int Format(char *buf, size_t size);
 };
 
 class _PrintBool: public Instruction {
 public:
-    _PrintBool();
     void EmitSpecific(Mips* mips);
+    int Format(char *buf, size_t size);
 };
 
 class _Halt: public Instruction {
 public:
-    _Halt();
     void EmitSpecific(Mips* mips);
+    int Format(char *buf, size_t size);
 };
 
 #endif
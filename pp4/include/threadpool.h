@@ -0,0 +1,65 @@
+/* File: threadpool.h
+ * ------------------
+ * The ThreadPool class keeps a fixed set of worker threads around for
+ * running batches of independent tasks in parallel, e.g. compiling
+ * several programs at once (see main.cc). A batch is given as a count
+ * and a function taking the index of the task to do; Run hands the
+ * indices out one at a time to whichever thread is free, so a batch
+ * of uneven tasks still keeps every thread busy, and returns once they
+ * have all finished. The calling thread works on the batch too.
+ * Sample usage:
+ *
+ *       ThreadPool pool(4);
+ *       pool.Run(files.size(), [&](int i) { Compile(files[i]); });
+ */
+
+#ifndef _H_threadpool
+#define _H_threadpool
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+
+class ThreadPool {
+  private:
+    vector<thread> workers;
+    mutex lock;
+    condition_variable wake, done;
+    const function<void(int)> *task;  // batch being run, NULL if none
+    int numTasks;
+    atomic<int> next;                 // index of next task to hand out
+    int numBusy;                      // workers still on the batch
+    unsigned int batch;               // counts batches, to wake workers
+    bool stopping;
+
+    static thread_local int workerIndex;
+
+    void Work(int index);
+    void RunTasks();
+
+  public:
+         // Creates a pool that runs batches on numThreads threads in all,
+         // counting the caller of Run. With 0, uses one per processor.
+    ThreadPool(int numThreads = 0);
+    ~ThreadPool();
+
+    int NumThreads() const { return workers.size() + 1; }
+
+         // Returns which of the pool's threads is running the calling
+         // task, from 0 (the caller of Run) to NumThreads() - 1
+    static int WorkerIndex() { return workerIndex; }
+
+         // Calls task(i) for each i in [0, numTasks), in parallel, and
+         // returns when all of the calls have returned
+    void Run(int numTasks, const function<void(int)> &task);
+
+  private:
+    ThreadPool(const ThreadPool&);          // pools are not copied
+    ThreadPool& operator=(const ThreadPool&);
+};
+
+#endif
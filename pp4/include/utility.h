@@ -9,6 +9,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <vector>
 
 /**
  * Function: Failure()
@@ -73,14 +74,69 @@ void SetDebugForKey(const char *key, bool val);
 
 bool IsDebugOn(const char *key);
 
+/**
+ * Function: GetDebugKeys()
+ * Usage: vector<const char*> keys = GetDebugKeys();
+ * ------------------------------------------------
+ * Returns a copy of the keys that are on for the calling thread. Outside
+ * of any compilation these are the keys given on the command line.
+ */
+
+std::vector<const char*> GetDebugKeys();
+
+/**
+ * Function: SetDebugKeys()
+ * Usage: SetDebugKeys(&keys, out);
+ * --------------------------------
+ * Debug keys are kept per thread, so programs compiled at the same time
+ * each have their own. This makes the calling thread look keys up in,
+ * and SetDebugForKey change, the given vector, and sends PrintDebug
+ * messages to out. Passing NULL goes back to the keys from the command
+ * line and printing to stdout.
+ */
+
+void SetDebugKeys(std::vector<const char*> *keys, FILE *out);
+
+/**
+ * Struct: Options
+ * ---------------
+ * What the command line asks dcc to do, besides turning on debug keys.
+ */
+
+struct Options {
+  std::vector<const char*> sourceFiles; // none means read stdin
+  int numThreads;                       // 0 means one per processor
+  bool server;                          // run as a compile server
+  const char *socketPath;               // server socket, NULL for stdin
+  const char *cacheDir;                 // code cache, NULL for none
+  const char *outputPath;               // for the code, NULL for stdout
+  bool tacComments;                     // echo the Tac in the assembly
+  bool emitAst;                         // write AST files, not assembly
+  bool fromAst;                         // the files named are AST files
+
+  Options() : numThreads(0), server(false), socketPath(NULL), cacheDir(NULL),
+              outputPath(NULL), tacComments(true), emitAst(false),
+              fromAst(false) {}
+};
+
 /**
  * Function: ParseCommandLine
  * --------------------------
- * Turn on the debugging flags from the command line.  Verifies that
- * first argument is -d, and then interpret all the arguments that follow
- * as being flags to turn on.
+ * Turn on the debugging flags from the command line.  The arguments up
+ * to -d name the source files to compile (none means read the program
+ * from stdin), and may include -j followed by the number of threads to
+ * compile them on, or --server, optionally followed by the path of the
+ * socket to listen on, instead of any source files, --cache
+ * followed by the directory to keep generated code in (see
+ * codecache.h), -o followed by the file to write the code for a single
+ * program to, --no-tac-comments to leave out the comments echoing
+ * each Tac instruction in the assembly, and -emit-ast to write the
+ * parse tree to an AST file (see astfile.h) instead of generating code,
+ * or -from-ast to compile the AST files named rather than source files.
+ * These are stored in options. All the arguments after -d are
+ * interpreted as being flags to turn on.
  */
 
-void ParseCommandLine(int argc, char *argv[]);
+void ParseCommandLine(int argc, char *argv[], Options *options);
      
 #endif
@@ -0,0 +1,52 @@
+/* File: workstack.h
+ * -----------------
+ * A WorkStack holds the work a pass over the tree has still to do, so
+ * that it can walk statements nested as deeply as a program likes
+ * without recursing on the C++ stack, which machine-generated programs
+ * (thousands of nested blocks and ifs) would overflow. Each piece of
+ * work is a function. While one is being done it adds, with Then, the
+ * work that follows on from it, such as the pass over a statement
+ * nested in the one it is on; that work is done next, in the order it
+ * was added, and only then whatever had been added before. So the work
+ * comes out in the same order as if each Then had been a call, but
+ * what is still to do is kept on the heap. Sample usage:
+ *
+ *       WorkStack work;
+ *       work.Run([&] { Visit(root, &work); });
+ *
+ * where Visit does its part for a node and calls
+ * work->Then([=] { Visit(child, work); }) for each of its children.
+ */
+
+#ifndef _H_workstack
+#define _H_workstack
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+using namespace std;
+
+class WorkStack {
+  private:
+    vector<function<void()>> work;     // the next to be done last
+
+  public:
+         // Does first and all the work that follows on from it, and
+         // returns once there is none left
+    void Run(function<void()> first) {
+        work.push_back(std::move(first));
+        while (!work.empty()) {
+            function<void()> next = std::move(work.back());
+            work.pop_back();
+            size_t added = work.size();
+            next();
+            reverse(work.begin() + added, work.end());
+        }
+    }
+
+         // Adds f, to be done after the work being done now and
+         // whatever else it has added so far
+    void Then(function<void()> f) { work.push_back(std::move(f)); }
+};
+
+#endif
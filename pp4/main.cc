@@ -1,33 +1,161 @@
 /* File: main.cc
  * -------------
- * This file defines the main() routine for the program and not much else.
- * You should not need to modify this file.
+ * The command-line driver. As the options say (see ParseCommandLine),
+ * main() compiles one program, compiles a batch of them on a pool of
+ * threads (see CompileBatch), or serves compile requests (see server.h).
  */
- 
+
+#include <errno.h>
 #include <string.h>
 #include <stdio.h>
+#include <sstream>
+#include <string>
 #include "utility.h"
+#include "astfile.h"
 #include "errors.h"
-#include "parser.h"
+#include "compilation.h"
+#include "codecache.h"
+#include "server.h"
+#include "source.h"
+#include "threadpool.h"
+
+
+/* Function: CompileBatch()
+ * ------------------------
+ * Compiles each of the named files on its own, spread over a pool of
+ * numThreads threads. The code for foo.decaf is written to foo.s (which
+ * is removed again if foo.decaf has errors), or with -emit-ast its tree
+ * to foo.ast; with -from-ast, foo.ast is compiled to foo.s. A file that
+ * can't be read counts as one error, and no output is written for it.
+ * The error messages of each program are collected while they are
+ * compiled and printed afterwards, in the order the files were given and
+ * headed by the file name, so the output does not depend on which
+ * programs happened to finish first.
+ * Returns the total number of errors.
+ */
+static int CompileBatch(const Options &options, CodeCache *cache)
+{
+    const vector<const char*> &files = options.sourceFiles;
+    vector<ostringstream> errors(files.size());
+    vector<int> numErrors(files.size());
+
+    ThreadPool pool(options.numThreads);
+    pool.Run(files.size(), [&](int i) {
+        string path = files[i];
+        size_t dot = path.rfind('.');
+        if (dot != string::npos && path.find('/', dot) == string::npos)
+            path.erase(dot);
+        path += options.emitAst ? ".ast" : ".s";
+
+        SourceBuffer source;
+        AstFile ast;
+        string problem;
+        if (!(options.fromAst ? ast.Map(files[i], &problem)
+                              : source.Map(files[i], &problem))) {
+            errors[i] << "\n*** " << problem << "\n\n";
+            numErrors[i] = 1;
+            return;
+        }
+        FILE *out = fopen(path.c_str(), "w");
+        if (out == NULL) {
+            errors[i] << "\n*** Cannot write '" << path << "': "
+                      << strerror(errno) << "\n\n";
+            numErrors[i] = 1;
+            return;
+        }
+        Compilation c(options.fromAst ? ast.Source() : &source, out, &errors[i]);
+        c.cache = cache;
+        c.tacComments = options.tacComments;
+        c.emitAst = options.emitAst;
+        if (options.fromAst)
+            c.astInput = &ast;
+        numErrors[i] = c.Compile();
+        fclose(out);
+        if (numErrors[i] > 0)
+            remove(path.c_str());
+    });
+
+    int total = 0;
+    for (size_t i = 0; i < files.size(); i++) {
+        string text = errors[i].str();
+        if (!text.empty())
+            cerr << files[i] << ":" << text;
+        total += numErrors[i];
+    }
+    return total;
+}
 
 
 /* Function: main()
  * ----------------
  * Entry point to the entire program.  We parse the command line and turn
  * on any debugging flags requested by the user when invoking the program.
- * InitScanner() is used to set up the scanner.
- * InitParser() is used to set up the parser. The call to yyparse() will
- * attempt to parse a complete program from the input. 
+ * With at most one source file, the program text is mapped from the
+ * source file named on the command line, or read from stdin if there is
+ * none, and compiled to stdout, or to the file given by -o (which is
+ * removed again if the program has errors), using the threads given by
+ * -j for the passes that can run in parallel. With several, they are
+ * compiled as a batch (see CompileBatch above).
+ * Compiling a program sets up the scanner and parser and calls yyparse()
+ * to attempt to parse a complete program from the input, which goes on
+ * to check it and generate code (see compilation.cc).
+ * With --server, programs are instead compiled as requests for them
+ * arrive (see server.h). With --cache, every program compiled shares
+ * the code cache in the given directory, and with --no-tac-comments,
+ * the assembly leaves out the Tac echoed before each instruction.
+ * With -emit-ast, the parse tree is written out in place of the code,
+ * and with -from-ast, the files named are AST files to compile instead
+ * of source files (see astfile.h).
  */
 
 
 int main(int argc, char *argv[])
 {
     //freopen("./samples/bad1.decaf","r",stdin);
-    ParseCommandLine(argc, argv);
-    InitScanner();
-    InitParser();
-    yyparse();
-    return (ReportError::NumErrors() == 0? 0 : -1);
-}
+    Options options;
+    ParseCommandLine(argc, argv, &options);
+    CodeCache *cache = NULL;
+    if (options.cacheDir)
+        cache = new CodeCache(options.cacheDir);
+    if (options.server)
+        return (options.socketPath
+                ? ServeSocket(options.socketPath, cache, options.tacComments)
+                : Serve(stdin, stdout, cache, options.tacComments));
+    if (options.sourceFiles.size() > 1)
+        return (CompileBatch(options, cache) == 0? 0 : -1);
 
+    SourceBuffer source;
+    AstFile ast;
+    string problem;
+    bool loaded = true;
+    if (options.fromAst)
+        loaded = ast.Map(options.sourceFiles[0], &problem);
+    else if (!options.sourceFiles.empty())
+        loaded = source.Map(options.sourceFiles[0], &problem);
+    else
+        source.Read(stdin);
+    if (!loaded) {
+        cerr << problem << "\n";
+        return 2;
+    }
+    FILE *out = stdout;
+    if (options.outputPath && (out = fopen(options.outputPath, "w")) == NULL) {
+        cerr << "\n*** Cannot write '" << options.outputPath << "': "
+             << strerror(errno) << "\n\n";
+        return -1;
+    }
+    Compilation compilation(options.fromAst ? ast.Source() : &source, out,
+                            &cerr, options.numThreads);
+    compilation.cache = cache;
+    compilation.tacComments = options.tacComments;
+    compilation.emitAst = options.emitAst;
+    if (options.fromAst)
+        compilation.astInput = &ast;
+    int numErrors = compilation.Compile();
+    if (options.outputPath) {
+        fclose(out);
+        if (numErrors > 0)
+            remove(options.outputPath);
+    }
+    return (numErrors == 0? 0 : -1);
+}
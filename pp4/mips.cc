@@ -13,7 +13,9 @@
  */
 
 #include "mips.h"
+#include "asmwriter.h"
 #include <stdarg.h>
+#include <stdio.h>
 #include <string.h>
 
 /* Method: GetRegister
@@ -47,11 +49,12 @@ Mips::Register Mips::GetRegister(Location *var, Reason reason,
 	SpillRegister(reg);
     }
     regs[reg].var = var;
+    RegisterHolding(var) = reg;
     if (reason == ForRead) {                 // load current value
 	Assert(var->GetOffset() % 4 == 0); // all variables are 4 bytes
 	const char *offsetFromWhere = var->GetSegment() == fpRelative? regs[fp].name : regs[gp].name;
 	Emit("lw %s, %d(%s)\t# load %s from %s%+d into %s", regs[reg].name,
-	     var->GetOffset(), offsetFromWhere, var->GetName(),
+	     var->GetOffset(), offsetFromWhere, var->GetName().Text(),
 	     offsetFromWhere, var->GetOffset(), regs[reg].name);
 	regs[reg].isDirty = false;
     }
@@ -76,27 +79,49 @@ Mips::Register Mips::GetRegisterForWrite(Location *var, Register avoid1,
 } 
 
 
-// Helper to check if two variable locations are one and the same
-// (same name, segment, and offset)
-static bool LocationsAreSame(Location *var1, Location *var2)
+/* Method: RegisterHolding
+ * -----------------------
+ * Returns the entry for var in the table of which register holds
+ * each variable. Two variable locations are one and the same if they
+ * have the same segment and offset (every variable in a function has a
+ * slot of its own, and "this" is made anew for each use), so the slot
+ * is all that is needed to find the entry.
+ */
+Mips::Register &Mips::RegisterHolding(Location *var)
 {
-   return (var1 == var2 ||
-	     (var1 && var2
-		&& !strcmp(var1->GetName(), var2->GetName())
-		&& var1->GetSegment()  == var2->GetSegment()
-		&& var1->GetOffset() == var2->GetOffset()));
+  int offset = var->GetOffset();
+  vector<Register> *table;
+  int slot;
+  if (var->GetSegment() == gpRelative) {
+    table = &globalRegs;
+    slot = offset / 4;
+  } else if (offset < 0) {
+    table = &localRegs;
+    slot = -offset / 4;
+  } else {
+    table = &paramRegs;
+    slot = offset / 4;
+  }
+  if (slot >= (int)table->size())
+    table->resize(2 * slot + 1, zero);
+  return (*table)[slot];
 }
 
 
 /* Method: FindRegisterWithContents
  * --------------------------------
- * Searches the descriptors for one with contents var. Assigns
- * register by reference, and returns true/false on whether match found.
+ * Finds the register holding var, or with NULL, searches the
+ * descriptors for an empty one. Assigns register by reference, and
+ * returns true/false on whether match found.
  */
 bool Mips::FindRegisterWithContents(Location *var, Register& reg)
 {
+  if (var != NULL) {
+    reg = RegisterHolding(var);
+    return reg != zero;
+  }
   for (reg = zero; reg < NumRegs; reg = Register(reg+1))
-    if (regs[reg].isGeneralPurpose && LocationsAreSame(var, regs[reg].var))
+    if (regs[reg].isGeneralPurpose && regs[reg].var == NULL)
 	return true;
   return false;
 }
@@ -116,12 +141,14 @@ bool Mips::FindRegisterWithContents(Location *var, Register& reg)
  */
 Mips::Register Mips::SelectRegisterToSpill(Register avoid1, Register avoid2)
 {
+  numSpills++;
             // first hunt for a non-dirty one, since no work to spill
   for (Register i = zero; i < NumRegs; i = (Register)(i+1)) {
     if (i != avoid1 && i != avoid2 && regs[i].isGeneralPurpose &&
 	  !regs[i].isDirty)
 	return i;
   }
+  lastUsedRead = true;
   do {      // otherwise just pick the next usuable register
     lastUsed = (Register)((lastUsed + 1) % NumRegs);
   } while (lastUsed == avoid1 || lastUsed == avoid2 ||
@@ -144,9 +171,11 @@ void Mips::SpillRegister(Register reg)
     const char *offsetFromWhere = var->GetSegment() == fpRelative? regs[fp].name : regs[gp].name;
     Assert(var->GetOffset() % 4 == 0); // all variables are 4 bytes in size
     Emit("sw %s, %d(%s)\t# spill %s from %s to %s%+d", regs[reg].name,
-	   var->GetOffset(), offsetFromWhere, var->GetName(), regs[reg].name,
+	   var->GetOffset(), offsetFromWhere, var->GetName().Text(), regs[reg].name,
 	   offsetFromWhere,var->GetOffset());
   }
+  if (var)
+    RegisterHolding(var) = zero;
   regs[reg].var = NULL;
 }       
 
@@ -183,8 +212,10 @@ void Mips::SpillForEndFunction()
     if (regs[i].isGeneralPurpose && regs[i].var) {
 	if (regs[i].var->GetSegment() == gpRelative)
 	  SpillRegister(i);
-	else  // all stack variables can just be tossed at end func
+	else {  // all stack variables can just be tossed at end func
+	  RegisterHolding(regs[i].var) = zero;
 	  regs[i].var = NULL;
+	}
     }
   }
 }
@@ -194,20 +225,40 @@ void Mips::SpillForEndFunction()
  * ------------
  * General purpose helper used to emit assembly instructions in
  * a reasonable tidy manner.  Takes printf-style formatting strings
- * and variable arguments.
+ * and variable arguments. The line is formatted straight into the
+ * output buffer, leaving room in front for the indentation, which
+ * depends on what the line turns out to be; a line too long for the
+ * room first given (a long string constant, say) is formatted again
+ * with enough.
  */
 void Mips::Emit(const char *fmt, ...)
 {
+  static const int IndentRoom = 3; // "\t  " at most
   va_list args;
-  char buf[1024];
-  
-  va_start(args, fmt);
-  vsprintf(buf, fmt, args);
-  va_end(args);
-  if (buf[strlen(buf) - 1] != ':') printf("\t"); // don't tab in labels
-  if (buf[0] != '#') printf("  ");   // outdent comments a little
-  printf("%s", buf);
-  if (buf[strlen(buf)-1] != '\n') printf("\n"); // end with a newline
+  size_t room = 128;
+  char *line;
+  int len;
+  for (;;) {
+    line = out->Reserve(IndentRoom + room);
+    va_start(args, fmt);
+    len = vsnprintf(line + IndentRoom, room, fmt, args);
+    va_end(args);
+    Assert(len >= 0);
+    if ((size_t)len < room)
+      break;
+    room = len + 1;
+  }
+  char *text = line + IndentRoom;
+  const char *indent = (len > 0 && text[len - 1] == ':') ? "" : "\t"; // don't tab in labels
+  if (text[0] != '#')
+    indent = (*indent ? "\t  " : "  ");  // outdent comments a little
+  int indentLen = strlen(indent);
+  memcpy(text - indentLen, indent, indentLen);
+  if (indentLen < IndentRoom)
+    memmove(line, text - indentLen, indentLen + len);
+  len += indentLen;
+  if (line[len - 1] != '\n') line[len++] = '\n'; // end with a newline
+  out->Commit(len);
 }
 
 
@@ -234,9 +285,8 @@ void Mips::EmitLoadConstant(Location *dst, int val)
  */
 void Mips::EmitLoadStringConstant(Location *dst, const char *str)
 {
-  static int strNum = 1;
-  char label[16];
-  sprintf(label, "_string%d", strNum++);
+  char label[24];
+  snprintf(label, sizeof(label), "_string%d", strNum++);
   Emit(".data\t\t\t# create string constant marked with label");
   Emit("%s: .asciiz %s", label, str);
   Emit(".text");
@@ -361,7 +411,7 @@ void Mips::EmitIfZ(Location *test, const char *label)
   Register testReg = GetRegister(test);
   SpillAllDirtyRegisters();
   Emit("beqz %s, %s\t# branch if %s is zero ", regs[testReg].name, label,
-	 test->GetName());
+	 test->GetName().Text());
 }
 
 
@@ -499,8 +549,8 @@ void Mips::EmitVTable(const char *label, List<const char*> *methodLabels)
   Emit(".data");
   Emit(".align 2");
   Emit("%s:\t\t# label for class %s vtable", label, label);
-  for (int i = 0; i < methodLabels->NumElements(); i++)
-    Emit(".word %s\n", methodLabels->Nth(i));
+  for (const char *methodLabel : *methodLabels)
+    Emit(".word %s\n", methodLabel);
   Emit(".text");
 }
 
@@ -536,19 +586,14 @@ const char *Mips::NameForTac(BinaryOp::OpCode code)
 
 /* Constructor
  * ----------
- * Constructor sets up the mips names and register descriptors to
- * the initial starting state.
+ * Constructor sets up the register descriptors to the initial starting
+ * state. All of the assembly is written to out. String constants are
+ * labeled from firstStringNum on, the next register to spill is chosen
+ * starting after lastUsed, and each Tac instruction is echoed as a
+ * comment before its code only if tacComments is set.
  */
-Mips::Mips() {
-  mipsName[BinaryOp::Add] = "add";
-  mipsName[BinaryOp::Sub] = "sub";
-  mipsName[BinaryOp::Mul] = "mul";
-  mipsName[BinaryOp::Div] = "div";
-  mipsName[BinaryOp::Mod] = "rem";
-  mipsName[BinaryOp::Eq] = "seq";
-  mipsName[BinaryOp::Less] = "slt";
-  mipsName[BinaryOp::And] = "and";
-  mipsName[BinaryOp::Or] = "or";
+Mips::Mips(AsmWriter *o, int firstStringNum, int l, bool tac)
+    : out(o), tacComments(tac) {
   regs[zero] = (RegContents){false, NULL, "$zero", false};
   regs[at] = (RegContents){false, NULL, "$at", false};
   regs[v0] = (RegContents){false, NULL, "$v0", false};
@@ -581,8 +626,12 @@ Mips::Mips() {
   regs[s5] = (RegContents){false, NULL, "$s5", true};
   regs[s6] = (RegContents){false, NULL, "$s6", true};
   regs[s7] = (RegContents){false, NULL, "$s7", true};
-  lastUsed = zero;
+  lastUsed = Register(l);
+  lastUsedRead = false;
+  numSpills = 0;
+  strNum = firstStringNum;
 }
-const char *Mips::mipsName[BinaryOp::NumOps];
+const char * const Mips::mipsName[BinaryOp::NumOps] =
+    {"add", "sub", "mul", "div", "rem", "seq", "slt", "and", "or"};
 
 
@@ -8,11 +8,26 @@
 #include "scanner.h" // for yylex
 #include "parser.h"
 #include "errors.h"
+#include "compilation.h"
 
-void yyerror(const char *msg); // standard error-handling routine
+              // standard error-handling routine
+void yyerror(yyltype *loc, yyscan_t scanner, const char *msg);
+
+              // the stacks grow on the heap as needed; bison's default
+              // limit of 10000 entries runs out at a couple of thousand
+              // nested statements
+#define YYMAXDEPTH 10000000
 
 %}
 
+/* The parser is pure (keeps yylval, yylloc and its stacks local to each
+ * yyparse call) and asks the reentrant scanner for tokens through the
+ * handle it is given, so programs may be parsed on several threads.
+ */
+%define api.pure full
+%locations
+%param { yyscan_t scanner }
+
  
 /* yylval 
  * ------
@@ -22,7 +37,7 @@ void yyerror(const char *msg); // standard error-handling routine
     bool boolConstant;
     char *stringConstant;
     double doubleConstant;
-    char identifier[MaxIdentLen+1]; // +1 for terminating null
+    const char *identifier;      // interned, see symbols.h
     Decl *decl;
     List<Decl*> *declList;
     Type *type;
@@ -70,7 +85,7 @@ void yyerror(const char *msg); // standard error-handling routine
 %type <varList>   Formals FormalList VarDecls
 %type <exprList>  Actuals ExprList
 %type <stmt>      Stmt StmtBlock OptElse
-%type <stmtList>  StmtList
+%type <stmtList>  StmtList Stmts
 
   
 /* Precedence and associativity
@@ -99,10 +114,8 @@ Program   :    DeclList            {
                                       @1; 
                                       Program *program = new Program($1);
                                       // if no errors, advance to next phase
-                                      if (ReportError::NumErrors() == 0) 
-                                          program->Check();
                                       if (ReportError::NumErrors() == 0)
-                                          program->Emit();
+                                          Compilation::Current()->Translate(program);
                                     }
           ;
 
@@ -194,10 +207,14 @@ VarDecls  :    VarDecls VarDecl     { ($$=$1)->Append($2); }
           |    /* empty */          { $$ = new List<VarDecl*>; }
           ;
 
-StmtList  :    Stmt StmtList        { $$ = $2; $$->InsertAt($1, 0); }
+StmtList  :    Stmts                { $$ = $1; }
           |    /* empty */          { $$ = new List<Stmt*>; }
           ;
 
+Stmts     :    Stmts Stmt           { ($$=$1)->Append($2); }
+          |    Stmt                 { ($$ = new List<Stmt*>)->Append($1); }
+          ;
+
 Stmt      :    OptExpr ';'          { $$ = $1; }
           |    StmtBlock
           |    T_If '(' Expr ')' Stmt OptElse 
@@ -291,16 +308,16 @@ OptElse   :    T_Else Stmt          { $$ = $2; }
  * This function will be called before any calls to yyparse().  It is designed
  * to give you an opportunity to do anything that must be done to initialize
  * the parser (set global variables, configure starting state, etc.). One
- * thing it already does for you is assign the value of the global variable
- * yydebug that controls whether yacc prints debugging information about
- * parser actions (shift/reduce) and contents of state stack during parser.
- * If set to false, no information is printed. Setting it to true will give
- * you a running trail that might be helpful when debugging your parser.
- * Please be sure the variable is set to false when submitting your final
+ * thing to know is the global variable yydebug, which controls whether
+ * yacc prints debugging information about parser actions (shift/reduce)
+ * and contents of state stack during parser. It starts out false, in
+ * which case no information is printed. Setting it to true will give you
+ * a running trail that might be helpful when debugging your parser. It is
+ * shared by all parsers, so it is not assigned here while other programs
+ * may be compiling. Please be sure it is false when submitting your final
  * version.
  */
 void InitParser()
 {
    PrintDebug("parser", "Initializing parser");
-   yydebug = false;
 }
@@ -0,0 +1,123 @@
+/* File: server.cc
+ * ---------------
+ * Implementation of the compile server.
+ */
+
+#include "server.h"
+#include "compilation.h"
+#include "source.h"
+#include "utility.h"
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <sstream>
+#include <thread>
+
+static const unsigned int MaxFrameBytes = 0x7FFFFFFF;
+
+/* Function: ReadFrameLength
+ * -------------------------
+ * Reads the length line of a frame. Returns false at the end of the
+ * input, or if the line isn't a decimal number, in which case it says
+ * so on stderr.
+ */
+static bool ReadFrameLength(FILE *in, unsigned int *len) {
+    int ch = getc(in);
+    if (ch == EOF)
+        return false;
+    unsigned long n = 0;
+    bool digits = false;
+    for (; ch >= '0' && ch <= '9' && n <= MaxFrameBytes; ch = getc(in)) {
+        n = n*10 + (ch - '0');
+        digits = true;
+    }
+    if (!digits || ch != '\n' || n > MaxFrameBytes) {
+        fprintf(stderr, "dcc server: badly formed request\n");
+        return false;
+    }
+    *len = n;
+    return true;
+}
+
+static void WriteFrame(FILE *out, const char *bytes, size_t len) {
+    fprintf(out, "%lu\n", (unsigned long)len);
+    fwrite(bytes, 1, len, out);
+}
+
+int Serve(FILE *in, FILE *out, CodeCache *cache, bool tacComments) {
+    unsigned int len;
+    while (ReadFrameLength(in, &len)) {
+        SourceBuffer source;
+        if (!source.Read(in, len)) {
+            fprintf(stderr, "dcc server: request ends early\n");
+            return -1;
+        }
+
+        char *code = NULL;
+        size_t codeLen = 0;
+        FILE *codeOut = open_memstream(&code, &codeLen);
+        if (codeOut == NULL)
+            Failure("Cannot open output stream: %s", strerror(errno));
+        ostringstream errors;
+        {
+            Compilation compilation(&source, codeOut, &errors);
+            compilation.cache = cache;
+            compilation.tacComments = tacComments;
+            compilation.Compile();
+        }
+        fclose(codeOut);
+
+        string errorText = errors.str();
+        WriteFrame(out, code, codeLen);
+        WriteFrame(out, errorText.data(), errorText.size());
+        free(code);
+        if (fflush(out) != 0)
+            return -1;  // client is gone
+    }
+    return feof(in) ? 0 : -1;
+}
+
+static void ServeConnection(int fd, CodeCache *cache, bool tacComments) {
+    FILE *in = fdopen(fd, "r");
+    FILE *out = fdopen(dup(fd), "w");
+    if (in != NULL && out != NULL)
+        Serve(in, out, cache, tacComments);
+    if (in != NULL) fclose(in); else close(fd);
+    if (out != NULL) fclose(out);
+}
+
+int ServeSocket(const char *path, CodeCache *cache, bool tacComments) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "dcc server: socket path '%s' is too long\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    struct stat st;
+    if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(path);  // left behind by an earlier server
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0 || bind(listener, (struct sockaddr *)&addr, sizeof(addr)) < 0
+        || listen(listener, SOMAXCONN) < 0) {
+        fprintf(stderr, "dcc server: cannot listen on '%s': %s\n", path,
+                strerror(errno));
+        return -1;
+    }
+    signal(SIGPIPE, SIG_IGN);  // a client hanging up only ends its connection
+
+    while (true) {
+        int fd = accept(listener, NULL, NULL);
+        if (fd >= 0)
+            thread(ServeConnection, fd, cache, tacComments).detach();
+        else if (errno != EINTR && errno != ECONNABORTED)
+            Failure("Cannot accept connection: %s", strerror(errno));
+    }
+}
@@ -0,0 +1,220 @@
+/* File: source.cc
+ * ---------------
+ * Implementation of the SourceBuffer class.
+ */
+
+#include "source.h"
+#include "utility.h"
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const int NumPadding = 2; // flex wants two NULs after the text
+
+// Describes why path can't be read, from errno, and closes fd if it
+// is open. Returns false, for Map to return.
+static bool CannotRead(const char *path, int fd, string *problem) {
+    *problem = string("Cannot read source file '") + path + "': " +
+               strerror(errno);
+    if (fd >= 0)
+        close(fd);
+    return false;
+}
+
+SourceBuffer::~SourceBuffer() {
+    if (borrowed)
+        return;
+    if (mappedBytes)
+        munmap(text, mappedBytes);
+    else
+        free(text);
+}
+
+/* Method: Map
+ * -----------
+ * Reserves enough zero-filled anonymous memory for the file plus its
+ * padding, then maps the file over the start of it. The tail of the
+ * file's last page reads as zeros, and so does any page beyond it, so
+ * the padding is there whatever the file size. The mapping is private:
+ * the NULs flex writes never reach the file.
+ */
+bool SourceBuffer::Map(const char *path, string *problem) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0)
+        return CannotRead(path, fd, problem);
+    if ((unsigned long long)st.st_size >= 0xFFFFFFFFu - NumPadding) {
+        close(fd);
+        *problem = string("Source file '") + path + "' is too large";
+        return false;
+    }
+
+    size_t fileBytes = st.st_size, bytes = fileBytes + NumPadding;
+    void *mem = mmap(NULL, bytes, PROT_READ|PROT_WRITE,
+                     MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED)
+        return CannotRead(path, fd, problem);
+    if (fileBytes > 0 &&
+        mmap(mem, fileBytes, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_FIXED,
+             fd, 0) == MAP_FAILED) {
+        bool result = CannotRead(path, fd, problem);
+        munmap(mem, bytes);
+        return result;
+    }
+    close(fd);
+
+    text = (char *)mem;
+    length = fileBytes;
+    mappedBytes = bytes;
+    IndexLines();
+    return true;
+}
+
+void SourceBuffer::Read(FILE *f) {
+    size_t capacity = 64*1024, used = 0, n;
+    char *buf = (char *)malloc(capacity);
+    while (buf != NULL &&
+           (n = fread(buf + used, 1, capacity - used - NumPadding, f)) > 0) {
+        used += n;
+        if (capacity - used <= NumPadding)
+            buf = (char *)realloc(buf, capacity *= 2);
+    }
+    if (buf == NULL)
+        Failure("Out of memory reading source");
+    if (used >= 0xFFFFFFFFu - NumPadding)
+        Failure("Source is too large");
+
+    memset(buf + used, 0, NumPadding);
+    text = buf;
+    length = used;
+    IndexLines();
+}
+
+bool SourceBuffer::Read(FILE *f, unsigned int len) {
+    if (len >= 0xFFFFFFFFu - NumPadding)
+        Failure("Source is too large");
+    char *buf = (char *)malloc(len + NumPadding);
+    if (buf == NULL)
+        Failure("Out of memory reading source");
+    if (fread(buf, 1, len, f) != len) {
+        free(buf);
+        return false;
+    }
+
+    memset(buf + len, 0, NumPadding);
+    text = buf;
+    length = len;
+    IndexLines();
+    return true;
+}
+
+void SourceBuffer::Borrow(char *t, unsigned int len) {
+    text = t;
+    length = len;
+    borrowed = true;
+    IndexLines();
+}
+
+void SourceBuffer::IndexLines() {
+    inComment.clear();
+    lineStarts.clear();
+    lineStarts.push_back(0);
+    const char *end = text + length;
+    for (const char *p = text; (p = (const char *)memchr(p, '\n', end - p)); )
+        if (++p < end) // nothing follows the final newline
+            lineStarts.push_back(p - text);
+}
+
+const char *SourceBuffer::Line(int num, int *len) const {
+    if (num <= 0 || num > NumLines())
+        return NULL;
+
+    unsigned int start = lineStarts[num-1];
+    unsigned int end = num < NumLines() ? lineStarts[num] - 1 : length;
+    if (end > start && text[end-1] == '\n') // last line, ended by newline
+        end--;
+    *len = end - start;
+    return text + start;
+}
+
+/* Columns
+ * -------
+ * The scanner moves a tab to the next tab stop only when the tab is a
+ * lexeme of its own, so Position follows just enough of the lexical
+ * structure to tell tabs in string constants and // comments apart.
+ * Only a block comment carries on past the end of a line, so a line
+ * can be started on knowing just whether it begins inside one; that
+ * is worked out from the start of the text, as far as the lines asked
+ * about, and kept. Errors can be reported by several threads at once,
+ * hence the lock.
+ */
+enum ScanContext { InCode, InString, InLineComment, InComment };
+
+// Follows the text from p up to end, starting in context, moving column
+// as the scanner would and returning the context at end
+static ScanContext Follow(const char *p, const char *end,
+                          ScanContext context, int *column) {
+    for (; p < end; p++) {
+        if (*p == '\n') {
+            if (context != InComment)
+                context = InCode;
+            *column = 1;
+            continue;
+        }
+        (*column)++;
+        switch (context) {
+          case InCode:
+            if (*p == '"')
+                context = InString;
+            else if (p[0] == '/' && p[1] == '/')
+                context = InLineComment;
+            else if (p[0] == '/' && p[1] == '*') {
+                context = InComment;
+                (*column)++, p++;
+            }
+            break;
+          case InComment:
+            if (p[0] == '*' && p[1] == '/') {
+                context = InCode;
+                (*column)++, p++;
+            }
+            break;
+          case InString:
+            if (*p == '"')
+                context = InCode;
+            break;
+          case InLineComment:
+            break;
+        }
+        if (*p == '\t' && (context == InCode || context == InComment))
+            *column += SourceBuffer::TabSize - *column % SourceBuffer::TabSize + 1;
+    }
+    return context;
+}
+
+bool SourceBuffer::StartsInComment(int line) {
+    std::lock_guard<std::mutex> hold(inCommentLock);
+    if (inComment.empty())
+        inComment.push_back(false);
+    while ((int)inComment.size() < line) {
+        int n = inComment.size(), column = 1;
+        ScanContext context = inComment.back() ? InComment : InCode;
+        context = Follow(text + lineStarts[n-1], text + lineStarts[n],
+                         context, &column);
+        inComment.push_back(context == InComment);
+    }
+    return inComment[line-1];
+}
+
+void SourceBuffer::Position(unsigned int offset, int *line, int *column) {
+    *line = std::upper_bound(lineStarts.begin(), lineStarts.end(), offset) -
+            lineStarts.begin();
+    *column = 1;
+    ScanContext context = StartsInComment(*line) ? InComment : InCode;
+    Follow(text + lineStarts[*line-1], text + offset, context, column);
+}
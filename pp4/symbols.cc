@@ -0,0 +1,44 @@
+/* File: symbols.cc
+ * ----------------
+ * Implementation of the interned symbol tables.
+ */
+
+#include "symbols.h"
+#include <string.h>
+using namespace std;
+
+thread_local SymbolTable *SymbolTable::current = NULL;
+
+// Constructed on first use so interning from static initializers is
+// safe
+static SymbolTable& ProcessTable() {
+    static SymbolTable *table = new SymbolTable;
+    return *table;
+}
+
+const char *SymbolTable::Intern(const char *str, int len) {
+    lock_guard<mutex> guard(lock);
+    unordered_set<string_view>::iterator found = table.find(string_view(str, len));
+    if (found != table.end())
+        return found->data();
+
+    char *copy = (char *)text.Allocate(len + 1);
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    table.insert(string_view(copy, len));
+    return copy;
+}
+
+int SymbolTable::NumSymbols() {
+    lock_guard<mutex> guard(lock);
+    return table.size();
+}
+
+const char *Symbols::Intern(const char *str) {
+    return Intern(str, strlen(str));
+}
+
+const char *Symbols::Intern(const char *str, int len) {
+    SymbolTable *t = SymbolTable::Current();
+    return (t != NULL ? *t : ProcessTable()).Intern(str, len);
+}
@@ -9,86 +9,137 @@
 #include <string.h>
 
 Location::Location(Segment s, int o, const char *name) :
-        variableName(strdup(name)), segment(s), offset(o){}
+        variableName(name), segment(s), offset(o),
+        tempNum(-1) {}
 
+Location::Location(int o, int num) :
+        variableName(NULL), segment(fpRelative), offset(o), tempNum(num) {}
 
-void Instruction::Print() {
-    printf("\t%s ;\n", printed);
+// a temp's name is made for each line of assembly that mentions it, so
+// it is written out directly rather than with snprintf
+Location::Name::Name(const char *n, int tempNum) : name(n) {
+    if (name != NULL)
+        return;
+    char digits[12], *d = digits + sizeof(digits);
+    unsigned num = tempNum;
+    do {
+        *--d = '0' + num % 10;
+    } while ((num /= 10) != 0);
+    memcpy(temp, "_tmp", 4);
+    memcpy(temp + 4, d, digits + sizeof(digits) - d);
+    temp[4 + (digits + sizeof(digits) - d)] = '\0';
+}
+
+
+/* Method: Text
+ * ------------
+ * Nearly every instruction's text fits in a small buffer on the
+ * stack; one naming a long identifier or string is made again in a
+ * string big enough.
+ */
+const char *Instruction::Text(char *buf, size_t size, string *longer) {
+    int len = Format(buf, size);
+    if ((size_t)len < size)
+        return buf;
+    longer->resize(len);
+    Format(&(*longer)[0], len + 1);
+    return longer->c_str();
+}
+
+void Instruction::Print(FILE *out) {
+    char buf[128];
+    string longer;
+    fprintf(out, "\t%s ;\n", Text(buf, sizeof(buf), &longer));
 }
 
 void Instruction::Emit(Mips *mips) {
-    if (*printed)
-        mips->Emit("# %s", printed);   // emit TAC as comment into assembly
+    if (mips->TacComments()) { // emit TAC as comment into assembly
+        char buf[128];
+        string longer;
+        const char *text = Text(buf, sizeof(buf), &longer);
+        if (*text)
+            mips->Emit("# %s", text);
+    }
     EmitSpecific(mips);
 }
 
 LoadConstant::LoadConstant(Location *d, int v)
         : dst(d), val(v) {
     Assert(dst != NULL);
-    sprintf(printed, "%s = %d", dst->GetName(), val);
 }
 void LoadConstant::EmitSpecific(Mips *mips) {
     mips->EmitLoadConstant(dst, val);
 }
+int LoadConstant::Format(char *buf, size_t size) {
+    return snprintf(buf, size, "%s = %d", dst->GetName().Text(), val);
+}
 
 
 LoadStringConstant::LoadStringConstant(Location *d, const char *s)
         : dst(d) {
     Assert(dst != NULL && s != NULL);
     const char *quote = (*s == '"') ? "" : "\"";
-    str = new char[strlen(s) + 2*strlen(quote) + 1];
+    str = (char *)Arena::Current()->Allocate(strlen(s) + 2*strlen(quote) + 1);
     sprintf(str, "%s%s%s", quote, s, quote);
-    quote = (strlen(str) > 50) ? "...\"" : "";
-    sprintf(printed, "%s = %.50s%s", dst->GetName(), str, quote);
 }
 void LoadStringConstant::EmitSpecific(Mips *mips) {
     mips->EmitLoadStringConstant(dst, str);
 }
+int LoadStringConstant::Format(char *buf, size_t size) {
+    const char *quote = (strlen(str) > 50) ? "...\"" : "";
+    return snprintf(buf, size, "%s = %.50s%s", dst->GetName().Text(), str, quote);
+}
 
 
 LoadLabel::LoadLabel(Location *d, const char *l)
-        : dst(d), label(strdup(l)) {
+        : dst(d), label(l) {
     Assert(dst != NULL && label != NULL);
-    sprintf(printed, "%s = %s", dst->GetName(), label);
 }
 void LoadLabel::EmitSpecific(Mips *mips) {
     mips->EmitLoadLabel(dst, label);
 }
+int LoadLabel::Format(char *buf, size_t size) {
+    return snprintf(buf, size, "%s = %s", dst->GetName().Text(), label);
+}
 
 
 Assign::Assign(Location *d, Location *s)
         : dst(d), src(s) {
     Assert(dst != NULL && src != NULL);
-    sprintf(printed, "%s = %s", dst->GetName(), src->GetName());
 }
 void Assign::EmitSpecific(Mips *mips) {
     mips->EmitCopy(dst, src);
 }
+int Assign::Format(char *buf, size_t size) {
+    return snprintf(buf, size, "%s = %s", dst->GetName().Text(), src->GetName().Text());
+}
 
 
 Load::Load(Location *d, Location *s, int off)
         : dst(d), src(s), offset(off) {
     Assert(dst != NULL && src != NULL);
-    if (offset)
-        sprintf(printed, "%s = *(%s + %d)", dst->GetName(), src->GetName(), offset);
-    else
-        sprintf(printed, "%s = *(%s)", dst->GetName(), src->GetName());
 }
 void Load::EmitSpecific(Mips *mips) {
     mips->EmitLoad(dst, src, offset);
 }
+int Load::Format(char *buf, size_t size) {
+    if (offset)
+        return snprintf(buf, size, "%s = *(%s + %d)", dst->GetName().Text(), src->GetName().Text(), offset);
+    return snprintf(buf, size, "%s = *(%s)", dst->GetName().Text(), src->GetName().Text());
+}
 
 Store::Store(Location *d, Location *s, int off)
         : dst(d), src(s), offset(off) {
     Assert(dst != NULL && src != NULL);
-    if (offset)
-        sprintf(printed, "*(%s + %d) = %s", dst->GetName(), offset, src->GetName());
-    else
-        sprintf(printed, "*(%s) = %s", dst->GetName(), src->GetName());
 }
 void Store::EmitSpecific(Mips *mips) {
     mips->EmitStore(dst, src, offset);
 }
+int Store::Format(char *buf, size_t size) {
+    if (offset)
+        return snprintf(buf, size, "*(%s + %d) = %s", dst->GetName().Text(), offset, src->GetName().Text());
+    return snprintf(buf, size, "*(%s) = %s", dst->GetName().Text(), src->GetName().Text());
+}
 
 const char * const BinaryOp::opName[BinaryOp::NumOps] = {"+", "-", "*", "/", "%", "==", "<", "&&", "||"};
 
@@ -104,127 +155,150 @@ BinaryOp::BinaryOp(OpCode c, Location *d, Location *o1, Location *o2)
         : code(c), dst(d), op1(o1), op2(o2) {
     Assert(dst != NULL && op1 != NULL && op2 != NULL);
     Assert(code >= 0 && code < NumOps);
-    sprintf(printed, "%s = %s %s %s", dst->GetName(), op1->GetName(), opName[code], op2->GetName());
 }
 void BinaryOp::EmitSpecific(Mips *mips) {
     mips->EmitBinaryOp(code, dst, op1, op2);
 }
+int BinaryOp::Format(char *buf, size_t size) {
+    return snprintf(buf, size, "%s = %s %s %s", dst->GetName().Text(), op1->GetName().Text(), opName[code], op2->GetName().Text());
+}
 
 
-Label::Label(const char *l) : label(strdup(l)) {
+Label::Label(const char *l) : label(l) {
     Assert(label != NULL);
-    *printed = '\0';
 }
-void Label::Print() {
-    printf("%s:\n", label);
+void Label::Print(FILE *out) {
+    fprintf(out, "%s:\n", label);
 }
 void Label::EmitSpecific(Mips *mips) {
     mips->EmitLabel(label);
 }
+int Label::Format(char *buf, size_t size) {
+    if (size > 0)
+        *buf = '\0';   // a label is not echoed
+    return 0;
+}
 
 
-Goto::Goto(const char *l) : label(strdup(l)) {
+Goto::Goto(const char *l) : label(l) {
     Assert(label != NULL);
-    sprintf(printed, "Goto %s", label);
 }
 void Goto::EmitSpecific(Mips *mips) {
     mips->EmitGoto(label);
 }
+int Goto::Format(char *buf, size_t size) {
+    return snprintf(buf, size, "Goto %s", label);
+}
 
 IfZ::IfZ(Location *te, const char *l)
-        : test(te), label(strdup(l)) {
+        : test(te), label(l) {
     Assert(test != NULL && label != NULL);
-    sprintf(printed, "IfZ %s Goto %s", test->GetName(), label);
 }
 void IfZ::EmitSpecific(Mips *mips) {
     mips->EmitIfZ(test, label);
 }
+int IfZ::Format(char *buf, size_t size) {
+    return snprintf(buf, size, "IfZ %s Goto %s", test->GetName().Text(), label);
+}
 
 
 BeginFunc::BeginFunc() {
-    sprintf(printed,"BeginFunc (unassigned)");
     frameSize = -555; // used as sentinel to recognized unassigned value
 }
 void BeginFunc::SetFrameSize(int numBytesForAllLocalsAndTemps) {
     frameSize = numBytesForAllLocalsAndTemps;
-    sprintf(printed,"BeginFunc %d", frameSize);
 }
 void BeginFunc::EmitSpecific(Mips *mips) {
     mips->EmitBeginFunction(frameSize);
 }
-
-EndFunc::EndFunc() : Instruction() {
-    sprintf(printed, "EndFunc");
+int BeginFunc::Format(char *buf, size_t size) {
+    if (frameSize == -555)
+        return snprintf(buf, size, "BeginFunc (unassigned)");
+    return snprintf(buf, size, "BeginFunc %d", frameSize);
 }
+
+EndFunc::EndFunc() : Instruction() {}
 void EndFunc::EmitSpecific(Mips *mips) {
     mips->EmitEndFunction();
 }
+int EndFunc::Format(char *buf, size_t size) {
+    return snprintf(buf, size, "EndFunc");
+}
 
 
-Return::Return(Location *v) : val(v) {
-    sprintf(printed, "Return %s", val? val->GetName() : "");
-}
+Return::Return(Location *v) : val(v) {}
 void Return::EmitSpecific(Mips *mips) {
     mips->EmitReturn(val);
 }
+int Return::Format(char *buf, size_t size) {
+    return snprintf(buf, size, "Return %s", val? val->GetName().Text() : "");
+}
 
 
 PushParam::PushParam(Location *p)
         :  param(p) {
     Assert(param != NULL);
-    sprintf(printed, "PushParam %s", param->GetName());
 }
 void PushParam::EmitSpecific(Mips *mips) {
     mips->EmitParam(param);
 }
+int PushParam::Format(char *buf, size_t size) {
+    return snprintf(buf, size, "PushParam %s", param->GetName().Text());
+}
 
 PopParams::PopParams(int nb)
-        :  numBytes(nb) {
-    sprintf(printed, "PopParams %d", numBytes);
-}
+        :  numBytes(nb) {}
 void PopParams::EmitSpecific(Mips *mips) {
     mips->EmitPopParams(numBytes);
 }
+int PopParams::Format(char *buf, size_t size) {
+    return snprintf(buf, size, "PopParams %d", numBytes);
+}
 
 
 
 LCall::LCall(const char *l, Location *d)
-        :  label(strdup(l)), dst(d) {
-    sprintf(printed, "%s%sLCall %s", dst? dst->GetName(): "", dst?" = ":"", label);
-}
+        :  label(l), dst(d) {}
 void LCall::EmitSpecific(Mips *mips) {
     mips->EmitLCall(dst, label);
 }
+int LCall::Format(char *buf, size_t size) {
+    return snprintf(buf, size, "%s%sLCall %s", dst? dst->GetName().Text(): "", dst?" = ":"", label);
+}
 
 ACall::ACall(Location *ma, Location *d)
         : dst(d), methodAddr(ma) {
     Assert(methodAddr != NULL);
-    sprintf(printed, "%s%sACall %s", dst? dst->GetName(): "", dst?" = ":"",
-            methodAddr->GetName());
 }
 void ACall::EmitSpecific(Mips *mips) {
     mips->EmitACall(dst, methodAddr);
 }
+int ACall::Format(char *buf, size_t size) {
+    return snprintf(buf, size, "%s%sACall %s", dst? dst->GetName().Text(): "", dst?" = ":"",
+                    methodAddr->GetName().Text());
+}
 
 
 VTable::VTable(const char *l, List<const char *> *m)
-        : methodLabels(m), label(strdup(l)) {
+        : methodLabels(m), label(l) {
     Assert(methodLabels != NULL && label != NULL);
-    sprintf(printed, "VTable for class %s", l);
 }
 
-void VTable::Print() {
-    printf("VTable %s =\n", label);
-    for (int i = 0; i < methodLabels->NumElements(); i++)
-        printf("\t%s,\n", methodLabels->Nth(i));
-    printf("; \n");
+void VTable::Print(FILE *out) {
+    fprintf(out, "VTable %s =\n", label);
+    for (const char *label : *methodLabels)
+        fprintf(out, "\t%s,\n", label);
+    fprintf(out, "; \n");
 }
 void VTable::EmitSpecific(Mips *mips) {
     mips->EmitVTable(label, methodLabels);
 }
+int VTable::Format(char *buf, size_t size) {
+    return snprintf(buf, size, "VTable for class %s", label);
+}
 
-_PrintInt::_PrintInt() {
-    sprintf(printed, "PrintInt (BuiltIn)");
+int _PrintInt::Format(char *buf, size_t size) {
+    return snprintf(buf, size, "PrintInt (BuiltIn)");
 }
 void _PrintInt::EmitSpecific(Mips* mips) {
     mips->EmitLabel("_PrintInt");
@@ -235,8 +309,8 @@ void _PrintInt::EmitSpecific(Mips* mips) {
     mips->EmitEndFunction();
 }
 
-_PrintString::_PrintString() {
-    sprintf(printed, "PrintString (BuiltIn)");
+int _PrintString::Format(char *buf, size_t size) {
+    return snprintf(buf, size, "PrintString (BuiltIn)");
 }
 void _PrintString::EmitSpecific(Mips* mips) {
     mips->EmitLabel("_PrintString");
@@ -247,8 +321,8 @@ void _PrintString::EmitSpecific(Mips* mips) {
     mips->EmitEndFunction();
 }
 
-_PrintBool::_PrintBool() {
-    sprintf(printed, "PrintBool (BuiltIn)");
+int _PrintBool::Format(char *buf, size_t size) {
+    return snprintf(buf, size, "PrintBool (BuiltIn)");
 }
 void _PrintBool::EmitSpecific(Mips* mips) {
     mips->EmitLabel("_PrintBool");
@@ -269,8 +343,8 @@ void _PrintBool::EmitSpecific(Mips* mips) {
     mips->EmitEndFunction();
 }
 
-_Halt::_Halt() {
-    sprintf(printed, "Halt (BuiltIn)");
+int _Halt::Format(char *buf, size_t size) {
+    return snprintf(buf, size, "Halt (BuiltIn)");
 }
 void _Halt::EmitSpecific(Mips* mips) {
     mips->EmitLabel("_Halt");
@@ -280,8 +354,8 @@ void _Halt::EmitSpecific(Mips* mips) {
     mips->EmitEndFunction();
 }
 
-_Alloc::_Alloc() {
-    sprintf(printed, "Alloc (BuiltIn)");
+int _Alloc::Format(char *buf, size_t size) {
+    return snprintf(buf, size, "Alloc (BuiltIn)");
 }
 void _Alloc::EmitSpecific(Mips* mips) {
     const char* good_size = "_Alloc_syscall";
@@ -307,8 +381,8 @@ void _Alloc::EmitSpecific(Mips* mips) {
     mips->EmitEndFunction();
 }
 
-_ReadLine::_ReadLine() {
-    sprintf(printed, "ReadLine (BuiltIn)");
+int _ReadLine::Format(char *buf, size_t size) {
+    return snprintf(buf, size, "ReadLine (BuiltIn)");
 }
 void _ReadLine::EmitSpecific(Mips* mips) {
     const char* done = "_ReadLine_done";
@@ -334,8 +408,8 @@ void _ReadLine::EmitSpecific(Mips* mips) {
     mips->EmitEndFunction();
 }
 
-_ReadInteger::_ReadInteger() {
-    sprintf(printed, "ReadInteger (BuiltIn)");
+int _ReadInteger::Format(char *buf, size_t size) {
+    return snprintf(buf, size, "ReadInteger (BuiltIn)");
 }
 void _ReadInteger::EmitSpecific(Mips* mips) {
     mips->EmitLabel("_ReadInteger");
@@ -345,8 +419,8 @@ void _ReadInteger::EmitSpecific(Mips* mips) {
     mips->EmitEndFunction();
 }
 
-_StringEqual::_StringEqual() {
-    sprintf(printed, "StringEqual (BuiltIn)");
+int _StringEqual::Format(char *buf, size_t size) {
+    return snprintf(buf, size, "StringEqual (BuiltIn)");
 }
 void _StringEqual::EmitSpecific(Mips* mips) {
     const char* done = "_StringEqual_done";
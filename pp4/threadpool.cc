@@ -0,0 +1,82 @@
+/* File: threadpool.cc
+ * -------------------
+ * Implementation of the ThreadPool class.
+ */
+
+#include "threadpool.h"
+#include "utility.h"
+
+thread_local int ThreadPool::workerIndex = 0;
+
+ThreadPool::ThreadPool(int numThreads)
+    : task(NULL), numTasks(0), next(0), numBusy(0), batch(0), stopping(false)
+{
+  if (numThreads <= 0)
+    numThreads = max(1u, thread::hardware_concurrency());
+  for (int i = 1; i < numThreads; i++)
+    workers.push_back(thread(&ThreadPool::Work, this, i));
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    lock_guard<mutex> guard(lock);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (size_t i = 0; i < workers.size(); i++)
+    workers[i].join();
+}
+
+/* Method: Run
+ * -----------
+ * Publishes the batch and wakes the workers, then takes tasks along
+ * with them. The task function is only borrowed, so Run waits until
+ * every worker has let go of the batch before returning.
+ */
+void ThreadPool::Run(int n, const function<void(int)> &t)
+{
+  {
+    lock_guard<mutex> guard(lock);
+    Assert(task == NULL); // batches don't nest
+    task = &t;
+    numTasks = n;
+    next = 0;
+    numBusy = workers.size();
+    batch++;
+  }
+  wake.notify_all();
+  int outerIndex = workerIndex; // the caller may be working for another pool
+  workerIndex = 0;
+  RunTasks();
+  workerIndex = outerIndex;
+
+  unique_lock<mutex> guard(lock);
+  done.wait(guard, [this] { return numBusy == 0; });
+  task = NULL;
+}
+
+void ThreadPool::RunTasks()
+{
+  for (int i; (i = next++) < numTasks; )
+    (*task)(i);
+}
+
+void ThreadPool::Work(int index)
+{
+  workerIndex = index;
+  unsigned int seen = 0;
+  while (true) {
+    {
+      unique_lock<mutex> guard(lock);
+      wake.wait(guard, [&] { return stopping || batch != seen; });
+      if (stopping)
+        return;
+      seen = batch;
+    }
+    RunTasks();
+    lock_guard<mutex> guard(lock);
+    if (--numBusy == 0)
+      done.notify_one();
+  }
+}
@@ -10,7 +10,11 @@
 #include <vector>
 using std::vector;
 
-static vector<const char*> debugKeys;
+// Keys set from the command line. Each thread works with these until
+// it installs the keys of a compilation with SetDebugKeys.
+static vector<const char*> commandLineKeys;
+static thread_local vector<const char*> *debugKeys = &commandLineKeys;
+static thread_local FILE *debugOut = NULL;   // stdout
 static const int BufferSize = 2048;
 
 void Failure(const char *format, ...) {
@@ -26,8 +30,8 @@ void Failure(const char *format, ...) {
 }
 
 int IndexOf(const char *key) {
-  for (unsigned int i = 0; i < debugKeys.size(); i++)
-    if (!strcmp(debugKeys[i], key)) 
+  for (unsigned int i = 0; i < debugKeys->size(); i++)
+    if (!strcmp((*debugKeys)[i], key)) 
       return i;
 
   return -1;
@@ -40,9 +44,9 @@ bool IsDebugOn(const char *key) {
 void SetDebugForKey(const char *key, bool value) {
   int k = IndexOf(key);
   if (!value && k != -1)
-    debugKeys.erase(debugKeys.begin() + k);
+    debugKeys->erase(debugKeys->begin() + k);
   else if (value && k == -1)
-    debugKeys.push_back(key);
+    debugKeys->push_back(key);
 }
 
 void PrintDebug(const char *key, const char *format, ...) {
@@ -55,22 +59,68 @@ void PrintDebug(const char *key, const char *format, ...) {
   va_start(args, format);
   vsprintf(buf, format, args);
   va_end(args);
-  printf("+++ (%s): %s%s", key, buf, buf[strlen(buf)-1] != '\n'? "\n" : "");
+  fprintf(debugOut ? debugOut : stdout, "+++ (%s): %s%s", key, buf,
+          buf[strlen(buf)-1] != '\n'? "\n" : "");
 }
 
-void ParseCommandLine(int argc, char *argv[]) {
-  if (argc == 1)
-    return;
-  
-  if (strcmp(argv[1], "-d") != 0) { // first arg is not -d
-    printf("Incorrect Use:   ");
-    for (int i = 1; i < argc; i++) printf("%s ", argv[i]);
-    printf("\n");
-    printf("Correct Usage:   -d <debug-key-1> <debug-key-2> ... \n");
-    exit(2);
+vector<const char*> GetDebugKeys() {
+  return *debugKeys;
+}
+
+void SetDebugKeys(vector<const char*> *keys, FILE *out) {
+  debugKeys = keys ? keys : &commandLineKeys;
+  debugOut = keys ? out : NULL;
+}
+
+static void Usage(int argc, char *argv[]) {
+  printf("Incorrect Use:   ");
+  for (int i = 1; i < argc; i++) printf("%s ", argv[i]);
+  printf("\n");
+  printf("Correct Usage:   [-j <threads>] [--cache <dir>] [--no-tac-comments] [-emit-ast | -from-ast] [--server [<socket>] | [-o <output-file>] <source-file> ...] -d <debug-key-1> <debug-key-2> ... \n");
+  exit(2);
+}
+
+void ParseCommandLine(int argc, char *argv[], Options *options) {
+  int first = 1;
+  for (; first < argc && strcmp(argv[first], "-d") != 0; first++) {
+    if (strcmp(argv[first], "-j") == 0) {
+      if (first + 1 == argc || (options->numThreads = atoi(argv[first + 1])) <= 0)
+        Usage(argc, argv);
+      first++;
+    } else if (strcmp(argv[first], "--cache") == 0) {
+      if (first + 1 == argc)
+        Usage(argc, argv);
+      options->cacheDir = argv[++first];
+    } else if (strcmp(argv[first], "-o") == 0) {
+      if (first + 1 == argc)
+        Usage(argc, argv);
+      options->outputPath = argv[++first];
+    } else if (strcmp(argv[first], "--no-tac-comments") == 0) {
+      options->tacComments = false;
+    } else if (strcmp(argv[first], "-emit-ast") == 0) {
+      options->emitAst = true;
+    } else if (strcmp(argv[first], "-from-ast") == 0) {
+      options->fromAst = true;
+    } else if (strcmp(argv[first], "--server") == 0) {
+      options->server = true;
+      if (first + 1 < argc && argv[first + 1][0] != '-')
+        options->socketPath = argv[++first];
+    } else if (argv[first][0] == '-') {
+      Usage(argc, argv);
+    } else {
+      options->sourceFiles.push_back(argv[first]);
+    }
   }
+  if (options->server && !options->sourceFiles.empty())
+    Usage(argc, argv);
+  if (options->outputPath && (options->server || options->sourceFiles.size() > 1))
+    Usage(argc, argv);
+  if ((options->emitAst || options->fromAst) &&
+      (options->server || (options->emitAst && options->fromAst)))
+    Usage(argc, argv);
+  if (options->fromAst && options->sourceFiles.empty())
+    Usage(argc, argv);
 
-  for (int i = 2; i < argc; i++)
+  for (int i = first + 1; i < argc; i++)
     SetDebugForKey(argv[i], true);
 }
-